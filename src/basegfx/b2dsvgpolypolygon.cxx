@@ -78,80 +78,121 @@ namespace basegfx
                 return bPredicate;
             }
 
+            // Powers of ten which a double holds exactly
+            const double aExactPowersOfTen[] =
+            {
+                1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+            };
+
+            // Reads [+-]digits[.digits][(e|E)[+-]digits] from io_rPos,
+            // accumulating the digits as they are passed. A mantissa of at
+            // most 2^53 and a power of ten of at most 22 are both exact, so a
+            // single multiply or divide gives the correctly rounded result;
+            // longer numbers or bigger exponents are handed to the general
+            // converter, which reads them straight from the string too
             bool lcl_getDoubleChar(double& 			o_fRetval,
                                    sal_Int32& 			io_rPos, 
                                    const ::rtl::OUString& 	rStr)
             {
-                sal_Unicode aChar( rStr[io_rPos] );
-                ::rtl::OUStringBuffer sNumberString;
+                const sal_Unicode* pBegin = rStr.getStr() + io_rPos;
+                const sal_Unicode* pEnd = rStr.getStr() + rStr.getLength();
+                const sal_Unicode* p = pBegin;
 
                 // sign
-                if('+' == aChar || '-' == aChar)
-                {
-                    sNumberString.append(rStr[io_rPos]);
-                    aChar = rStr[++io_rPos];
-                }
+                bool bNegative = false;
+                if(p != pEnd && ('+' == *p || '-' == *p))
+                    bNegative = '-' == *p++;
+
+                sal_uInt64 nMantissa = 0;
+                int nDigits = 0;
+                int nExponent = 0;
+                bool bFits = true;
 
                 // numbers before point
-                while('0' <= aChar && '9' >= aChar)
+                for( ; p != pEnd && '0' <= *p && '9' >= *p; ++p)
                 {
-                    sNumberString.append(rStr[io_rPos]);
-                    io_rPos++;
-                    aChar = io_rPos < rStr.getLength() ? rStr[io_rPos] : 0;
+                    if(nDigits < 19)
+                    {
+                        nMantissa = nMantissa * 10 + (*p - '0');
+                        if(nMantissa)
+                            ++nDigits;
+                    }
+                    else
+                        bFits = false;
                 }
 
                 // point
-                if('.' == aChar)
-                {
-                    sNumberString.append(rStr[io_rPos]);
-                    io_rPos++;
-                    aChar = io_rPos < rStr.getLength() ? rStr[io_rPos] : 0;
-                }
+                if(p != pEnd && '.' == *p)
+                    ++p;
 
                 // numbers after point
-                while ('0' <= aChar && '9' >= aChar)
+                for( ; p != pEnd && '0' <= *p && '9' >= *p; ++p)
                 {
-                    sNumberString.append(rStr[io_rPos]);
-                    io_rPos++;
-                    aChar = io_rPos < rStr.getLength() ? rStr[io_rPos] : 0;
+                    if(nDigits < 19)
+                    {
+                        nMantissa = nMantissa * 10 + (*p - '0');
+                        if(nMantissa)
+                            ++nDigits;
+                        --nExponent;
+                    }
+                    else
+                        bFits = false;
                 }
 
                 // 'e'
-                if('e' == aChar || 'E' == aChar)
+                if(p != pEnd && ('e' == *p || 'E' == *p))
                 {
-                    sNumberString.append(rStr[io_rPos]);
-                    io_rPos++;
-                    aChar = io_rPos < rStr.getLength() ? rStr[io_rPos] : 0;
+                    ++p;
 
                     // sign for 'e'
-                    if('+' == aChar || '-' == aChar)
+                    bool bExpNegative = false;
+                    if(p != pEnd && ('+' == *p || '-' == *p))
+                        bExpNegative = '-' == *p++;
+
+                    // number for 'e', anything past the cap is out of range
+                    // whichever way it's converted
+                    int nExpValue = 0;
+                    for( ; p != pEnd && '0' <= *p && '9' >= *p; ++p)
                     {
-                        sNumberString.append(rStr[io_rPos]);
-                        io_rPos++;
-                        aChar = io_rPos < rStr.getLength() ? rStr[io_rPos] : 0;
+                        if(nExpValue < 100000)
+                            nExpValue = nExpValue * 10 + (*p - '0');
                     }
+                    nExponent += bExpNegative ? -nExpValue : nExpValue;
+                }
 
-                    // number for 'e'
-                    while('0' <= aChar && '9' >= aChar)
-                    {
-                        sNumberString.append(rStr[io_rPos]);
-                        io_rPos++;
-                        aChar = io_rPos < rStr.getLength() ? rStr[io_rPos] : 0;
-                    }
+                if(p == pBegin)
+                    return false;
+
+                io_rPos += static_cast< sal_Int32 >(p - pBegin);
+
+                if(bFits && !nMantissa)
+                {
+                    // zero stays zero, whatever the exponent
+                    o_fRetval = bNegative ? -0.0 : 0.0;
+                    return true;
                 }
 
-                if(sNumberString.getLength())
+                if(bFits && nMantissa <= (sal_uInt64(1) << 53) && nExponent >= -22 && nExponent <= 22)
                 {
-                    rtl_math_ConversionStatus eStatus;
-                    o_fRetval = ::rtl::math::stringToDouble( sNumberString.makeStringAndClear(),
-                                                                '.',
-                                                                ',',
-                                                                &eStatus,
-                                                                NULL );
-                    return ( eStatus == rtl_math_ConversionStatus_Ok );
+                    double fValue = static_cast< double >(nMantissa);
+                    if(nExponent < 0)
+                        fValue /= aExactPowersOfTen[-nExponent];
+                    else
+                        fValue *= aExactPowersOfTen[nExponent];
+                    o_fRetval = bNegative ? -fValue : fValue;
+                    return true;
                 }
 
-                return false;
+                rtl_math_ConversionStatus eStatus;
+                o_fRetval = rtl_math_uStringToDouble( pBegin,
+                                                      p,
+                                                      '.',
+                                                      ',',
+                                                      &eStatus,
+                                                      NULL );
+                return ( eStatus == rtl_math_ConversionStatus_Ok );
             }
 
             bool lcl_importDoubleAndSpaces( double& 				o_fRetval, 
@@ -172,24 +213,22 @@ namespace basegfx
                                            const ::rtl::OUString& 	rStr, 
                                            const sal_Int32 		nLen)
             {
-                sal_Unicode aChar( rStr[io_rPos] );
-                ::rtl::OUStringBuffer sNumberString;
+                const sal_Unicode* pBegin = rStr.getStr() + io_rPos;
+                const sal_Unicode* pEnd = rStr.getStr() + nLen;
+                const sal_Unicode* p = pBegin;
 
-                if(sal_Unicode('+') == aChar || sal_Unicode('-') == aChar)
-                {
-                    sNumberString.append(rStr[io_rPos]);
-                    aChar = rStr[++io_rPos];
-                }
+                bool bNegative = false;
+                if(p != pEnd && (sal_Unicode('+') == *p || sal_Unicode('-') == *p))
+                    bNegative = sal_Unicode('-') == *p++;
 
-                while(sal_Unicode('0') <= aChar && sal_Unicode('9') >= aChar)
-                {
-                    sNumberString.append(rStr[io_rPos]);
-                    aChar = rStr[++io_rPos];
-                }
+                sal_uInt32 nValue = 0;
+                for( ; p != pEnd && sal_Unicode('0') <= *p && sal_Unicode('9') >= *p; ++p)
+                    nValue = nValue * 10 + (*p - sal_Unicode('0'));
 
-                if(sNumberString.getLength())
+                if(p != pBegin)
                 {
-                    o_nRetval = sNumberString.makeStringAndClear().toInt32();
+                    io_rPos += static_cast< sal_Int32 >(p - pBegin);
+                    o_nRetval = static_cast< sal_Int32 >(bNegative ? 0 - nValue : nValue);
                     lcl_skipSpacesAndCommas(io_rPos, rStr, nLen);
 
                     return true;
@@ -29,7 +29,14 @@
 #include <com/sun/star/io/XSeekable.hpp>
 
 #include <com/sun/star/xml/sax/XDocumentHandler.hpp>
+#include <com/sun/star/xml/sax/XParser.hpp>
+#include <com/sun/star/xml/sax/InputSource.hpp>
+#include <com/sun/star/xml/sax/SAXException.hpp>
 #include <com/sun/star/xml/dom/XDocumentBuilder.hpp>
+#include <cppuhelper/implbase1.hxx>
+#include <rtl/ustrbuf.hxx>
+#include <rtl/math.hxx>
+#include <rtl/instance.hxx>
 #include <comphelper/string.hxx>
 #include <i18npool/paper.hxx>
 #include <basegfx/polygon/b2dpolygon.hxx>
@@ -43,7 +50,10 @@
 
 #include "filters.hxx"
 #include "shapefilter.hxx"
+#include "shapelibrary.hxx"
 #include "gz_inputstream.hxx"
+#include "mem_inputstream.hxx"
+#include "readahead_inputstream.hxx"
 
 #include <vector>
 #include <map>
@@ -51,6 +61,7 @@
 #include <functional>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/functional/hash.hpp>
 
 #include <math.h>
 #include <stdio.h>
@@ -74,19 +85,22 @@ private:
     uno::Reference< lang::XMultiServiceFactory > mxMSF;
 
     uno::Reference < xml::sax::XDocumentHandler > mxDocHandler;
-    uno::Reference < xml::dom::XElement > mxDocElem;
     rtl::OUString msInstallDir;
+    bool mbResultsWritten;
 
-    float mnTop;
-    float mnLeft;
+    double mnTop;
+    double mnLeft;
+    //paper size in mm, 0 if dia gave a paper we don't know
+    double mfPageWidth;
+    double mfPageHeight;
 
     shapes maShapes;
     objectmap mapId;
 
-    typedef std::map<rtl::OUString, shapeimporter> templates;
-    templates maTemplates;
+    bool mbTemplatesChecked;
 
     autostyles maDashes;
+    styleindex maDashIndex;
     autostyles maArrows;
     TextStyleManager maTextStyles;
     GraphicStyleManager maGraphicStyles;
@@ -98,9 +112,14 @@ public:
     DiaImporter(uno::Reference< uno::XComponentContext > xCtx,
         uno::Reference< lang::XMultiServiceFactory > xMSF,
         uno::Reference < xml::sax::XDocumentHandler > xDocHandler,
-        uno::Reference < xml::dom::XElement > xDocElem,
-        const rtl::OUString &rInstallDir);
-    bool convert();
+        const rtl::OUString &rInstallDir, bool bBuiltinFontMetrics);
+    //Convert from a fully built DOM of the .dia file
+    bool convert(const uno::Reference<xml::dom::XElement> &rxDocElem);
+    //Convert directly from the .dia stream, only building a DOM
+    //fragment for one diagramdata or object element at a time
+    bool convert(const uno::Reference<xml::sax::XParser> &rxParser,
+        const uno::Reference<io::XInputStream> &rxInputStream);
+    bool hasWrittenResults() const { return mbResultsWritten; }
     void handleDiagramDataPaperAttribute(const uno::Reference<xml::dom::XElement> &rxElem, PropertyMap &rAttrs);
     void handleDiagramDataPaperComposite(const uno::Reference<xml::dom::XElement> &rxElem);
     void handleDiagramDataPaper(const uno::Reference<xml::dom::XElement> &rxElem);
@@ -108,6 +127,7 @@ public:
     void handleDiagramDataBackGround(const uno::Reference<xml::dom::XElement> &rxElem);
     void handleDiagramDataAttribute(const uno::Reference<xml::dom::XElement> &rxElem);
     void handleDiagramData(const uno::Reference<xml::dom::XElement> &rxElem);
+    void addDash(const rtl::OUString &rName, const PropertyMap &rStrokeDash);
     void addStrokeDash(PropertyMap &rStyleAttrs, sal_Int32 nLineStyle, float nDashLength);
     void addAutomaticGraphicStyle(PropertyMap &rAttrs, const PropertyMap &rStyleAttrs)
         { maGraphicStyles.addAutomaticGraphicStyle(rAttrs, rStyleAttrs); }
@@ -115,9 +135,13 @@ public:
         { maTextStyles.addAutomaticTextStyle(rAttrs, rStyleAttrs); }
     PropertyMap handleStandardObject(const uno::Reference<xml::dom::XElement> &rxElem);
     void handleObject(const uno::Reference<xml::dom::XElement> &rxElem, shapes &rShapes);
+    void addShape(const diaobject &rObj, const PropertyMap &rProps, shapes &rShapes);
     void handleGroup(const uno::Reference<xml::dom::XElement> &rxElem, shapes &rShapes);
     void handleLayer(const uno::Reference<xml::dom::XElement> &rxElem);
     bool handleDiagram(const uno::Reference<xml::dom::XElement> &rxElem);
+    void beginDiagram();
+    void endDiagram();
+    shapes& getShapes() { return maShapes; }
 
     shapeimporter findCustomImporter(const rtl::OUString &rName);
     GraphicStyleManager& getGraphicStyleManager() { return maGraphicStyles; }
@@ -125,24 +149,21 @@ public:
     const GraphicStyleManager& getGraphicStyleManager() const { return maGraphicStyles; }
     const TextStyleManager& getTextStyleManager() const { return maTextStyles; }
 
-    void recursiveScan(const rtl::OUString &rDir);
-    void importShape(const rtl::OUString &rShapeFile);
-
     //Dia positions are relative to the page margins
     //while draw's are relative to the paper
-    float adjustX(float nX) const
+    double adjustX(double nX) const
     {
         return nX + mnLeft;
     }
-    float adjustY(float nY) const
+    double adjustY(double nY) const
     {
         return nY + mnTop;
     }
-    float unadjustX(float nX) const
+    double unadjustX(double nX) const
     {
         return nX - mnLeft;
     }
-    float unadjustY(float nY) const
+    double unadjustY(double nY) const
     {
         return nY - mnTop;
     }
@@ -151,6 +172,7 @@ public:
     //give up and create a single sheet big enough to contain everything
     void adjustPageSize(PropertyMap &rPageProps);
 
+    void layoutText();
     void resizeNarrowShapes();
     void adjustConnectionPoints();
     void writeShapes();
@@ -162,112 +184,156 @@ public:
 DiaImporter::DiaImporter(uno::Reference< uno::XComponentContext > xCtx,
         uno::Reference< lang::XMultiServiceFactory > xMSF,
         uno::Reference < xml::sax::XDocumentHandler > xDocHandler,
-        uno::Reference < xml::dom::XElement > xDocElem,
-        const rtl::OUString &rInstallDir)
+        const rtl::OUString &rInstallDir, bool bBuiltinFontMetrics)
         : mxCtx(xCtx)
         , mxMSF(xMSF)
         , mxDocHandler(xDocHandler)
-        , mxDocElem(xDocElem)
         , msInstallDir(rInstallDir)
+        , mbResultsWritten(false)
+        , mbTemplatesChecked(false)
         , mnTop(0)
         , mnLeft(0)
+        , mfPageWidth(0)
+        , mfPageHeight(0)
 {
-    maTextStyles.makeReferenceDevice(mxCtx);
+    maTextStyles.setFontMetrics(bBuiltinFontMetrics ?
+        createBuiltinFontMetrics() : createDeviceFontMetrics(mxCtx));
 }
 
-void TextStyleManager::makeReferenceDevice(uno::Reference< uno::XComponentContext > xCtx)
+uno::Reference< xml::sax::XAttributeList > makeXAttribute(const PropertyMap &rAttrs)
 {
-    uno::Reference< frame::XComponentLoader > xComponentLoader(
-        xCtx->getServiceManager()->createInstanceWithContext(USTR("com.sun.star.frame.Desktop"),
-            xCtx), uno::UNO_QUERY_THROW);
-
-    uno::Sequence < beans::PropertyValue > aArgs(1);
-    aArgs[0].Name = USTR("Hidden");
-    aArgs[0].Value <<= sal_True;
+    SaxAttrListPool *pPool = SaxAttrListPool::current();
+    if (!pPool)
+        return new SaxAttrList(rAttrs);
+    pdfi::PropertyAttrList *pList = pPool->get();
+    pList->reset(rAttrs);
+    return pList;
+}
 
-    uno::Reference< lang::XComponent > xComponent(xComponentLoader->loadComponentFromURL(
-        rtl::OUString(RTL_CONSTASCII_USTRINGPARAM("private:factory/sdraw")),
-        rtl::OUString(RTL_CONSTASCII_USTRINGPARAM("_blank")), 0, aArgs));
+uno::Reference< xml::sax::XAttributeList > makeXAttribute(const PropertyMap * const *ppLayers, size_t nLayers)
+{
+    SaxAttrListPool *pPool = SaxAttrListPool::current();
+    if (!pPool)
+    {
+        PropertyMap aMerged;
+        pdfi::PropertyAttrList::merge(ppLayers, nLayers, aMerged);
+        return new SaxAttrList(aMerged);
+    }
+    pdfi::PropertyAttrList *pList = pPool->get();
+    pList->reset(ppLayers, nLayers);
+    return pList;
+}
 
-    uno::Reference< frame::XModel > xModel(xComponent, uno::UNO_QUERY_THROW);
-    uno::Reference< frame::XController> xController = xModel->getCurrentController();
-    uno::Reference< frame::XFrame > xFrame( xController->getFrame() );
+uno::Reference< xml::sax::XAttributeList > makeXAttributeAndClear(PropertyMap &rAttrs)
+{
+    SaxAttrListPool *pPool = SaxAttrListPool::current();
+    if (!pPool)
+    {
+        uno::Reference< xml::sax::XAttributeList > xList(new SaxAttrList(rAttrs));
+        rAttrs.clear();
+        return xList;
+    }
+    pdfi::PropertyAttrList *pList = pPool->get();
+    pList->take(rAttrs);
+    return pList;
+}
 
-    uno::Reference< awt::XWindow > xWindow( xFrame->getContainerWindow() );
-    mxReferenceDevice = uno::Reference< awt::XDevice >(xWindow, uno::UNO_QUERY_THROW);
+uno::Reference< xml::sax::XAttributeList > makeEmptyXAttribute()
+{
+    SaxAttrListPool *pPool = SaxAttrListPool::current();
+    if (!pPool)
+        return new SaxAttrList();
+    return pPool->getEmpty();
 }
 
-SaxAttrList *makeXAttribute(const PropertyMap &rAttrs)
+//Reads dia's "x,y x,y ..." point lists in a single pass
+void parsePoints(const rtl::OUString &rPoints, std::vector< basegfx::B2DPoint > &rRet)
 {
-    SaxAttrList *pSaxAttrList = new SaxAttrList(rAttrs);
-    return pSaxAttrList;
+    const sal_Unicode *pStr = rPoints.getStr();
+    const sal_Unicode *pEnd = pStr + rPoints.getLength();
+    double fCoords[2];
+    int nCoord = 0;
+
+    rRet.reserve(rPoints.getLength() / 8);
+    while (pStr < pEnd)
+    {
+        if (*pStr == ',' || *pStr == ' ' || *pStr == '\t' || *pStr == '\n' || *pStr == '\r')
+        {
+            ++pStr;
+            continue;
+        }
+
+        rtl_math_ConversionStatus eStatus;
+        const sal_Unicode *pParsedEnd = pStr;
+        fCoords[nCoord] = rtl::math::stringToDouble(pStr, pEnd, '.', 0, &eStatus, &pParsedEnd);
+        if (pParsedEnd == pStr)
+        {
+            fprintf(stderr, "Failed to read points from %s\n",
+                rtl::OUStringToOString(rPoints, RTL_TEXTENCODING_UTF8).getStr());
+            break;
+        }
+        pStr = pParsedEnd;
+
+        if (++nCoord == 2)
+        {
+            rRet.push_back(basegfx::B2DPoint(fCoords[0], fCoords[1]));
+            nCoord = 0;
+        }
+    }
 }
 
-SaxAttrList *makeXAttributeAndClear(PropertyMap &rAttrs)
+void appendPoint(rtl::OUStringBuffer &rBuf, const basegfx::B2DPoint &rPoint, double fMul)
 {
-    SaxAttrList *pSaxAttrList = makeXAttribute(rAttrs);
-    rAttrs.clear();
-    return pSaxAttrList;
+    appendNumber(rBuf, rPoint.getX() * fMul);
+    rBuf.append(sal_Unicode(','));
+    appendNumber(rBuf, rPoint.getY() * fMul);
 }
 
 //Draw isn't really accurate enough unless we bump the points and viewports up
 //by at least 10
-void bumpPoints(PropertyMap& rProps, sal_Int32 nMul = 10)
+void bumpPoints(PropertyMap& rProps, const std::vector< basegfx::B2DPoint > &rPoints, sal_Int32 nMul = 10)
 {
-    rtl::OUString sPoints = rProps[USTR("draw:points")];
-    rtl::OUString sNewPoints;
-
-    sal_Int32 nIndex = 0;
-    do
+    rtl::OUStringBuffer aBuf(static_cast<sal_Int32>(rPoints.size() * 16));
+    std::vector< basegfx::B2DPoint >::const_iterator aEnd = rPoints.end();
+    for (std::vector< basegfx::B2DPoint >::const_iterator aI = rPoints.begin(); aI != aEnd; ++aI)
     {
-        rtl::OUString x = sPoints.getToken(0, ',', nIndex);
-        rtl::OUString y = sPoints.getToken(0, ' ', nIndex);
-        if (sNewPoints.getLength())
-            sNewPoints = sNewPoints + USTR(" ");
-        sNewPoints = sNewPoints +
-            rtl::OUString::number(x.toFloat()*nMul) + USTR(",") + rtl::OUString::number(y.toFloat()*nMul);
+        if (aI != rPoints.begin())
+            aBuf.append(sal_Unicode(' '));
+        appendPoint(aBuf, *aI, nMul);
     }
-    while ( nIndex >= 0 );
-
-    rProps[USTR("draw:points")] = sNewPoints;
+    rProps["draw:points"] = aBuf.makeStringAndClear();
 }
 
-void createViewportFromRect(PropertyMap& rProps)
+void createViewportFromRect(PropertyMap& rProps, const basegfx::B2DRange &rRect)
 {
-    rtl::OUString x = rtl::OUString::number(::comphelper::string::searchAndReplaceAllAsciiWithAscii(rProps[USTR("svg:x")], "cm", "").toFloat()*10);
-    rtl::OUString y = rtl::OUString::number(::comphelper::string::searchAndReplaceAllAsciiWithAscii(rProps[USTR("svg:y")], "cm", "").toFloat()*10);
-    rtl::OUString width = rtl::OUString::number(::comphelper::string::searchAndReplaceAllAsciiWithAscii(rProps[USTR("svg:width")], "cm", "").toFloat()*10);
-    rtl::OUString height = rtl::OUString::number(::comphelper::string::searchAndReplaceAllAsciiWithAscii(rProps[USTR("svg:height")], "cm", "").toFloat()*10);
-
-    rProps[USTR("svg:viewBox")] = x + USTR(" ") + y + USTR(" ") + width + USTR(" ") + height;
-
-    bumpPoints(rProps);
+    rProps["svg:viewBox"] = formatViewBox(rRect.getMinX()*10, rRect.getMinY()*10,
+        rRect.getWidth()*10, rRect.getHeight()*10);
 }
 
 namespace
 {
+    void reportUnknownElement(const rtl::OUString &rTagName)
+    {
+        fprintf(stderr, "Unknown tag %s\n", rtl::OUStringToOString(rTagName, RTL_TEXTENCODING_UTF8).getStr());
+    }
+
     void reportUnknownElement(const uno::Reference<xml::dom::XElement> &rxElem)
     {
-        fprintf(stderr, "Unknown tag %s\n", rtl::OUStringToOString(rxElem->getTagName(), RTL_TEXTENCODING_UTF8).getStr());
+        reportUnknownElement(rxElem->getTagName());
     }
 
     void createPoints(PropertyMap &rAttrs, const rtl::OUString &rPoints, const DiaImporter &rImporter)
     {
-        sal_Int32 nPairCount = 1;
-        sal_Int32 nIndex = 0;
-        do
+        std::vector< basegfx::B2DPoint > aPoints;
+        parsePoints(rPoints, aPoints);
+        for (size_t i = 0; i < aPoints.size(); ++i)
         {
-            float nX = rPoints.getToken(0, ',', nIndex).toFloat();
-            nX = rImporter.adjustX(nX);
-            float nY = rPoints.getToken(0, ' ', nIndex).toFloat();
-            nY = rImporter.adjustY(nY);
-            rAttrs[USTR("svg:x")+rtl::OUString::number(nPairCount)] =
-                rtl::OUString::number(nX)+USTR("cm");
-            rAttrs[USTR("svg:y")+rtl::OUString::number(nPairCount)] =
-                rtl::OUString::number(nY)+USTR("cm");
-            ++nPairCount;
+            rtl::OUString sPairCount = rtl::OUString::number(static_cast<sal_Int32>(i + 1));
+            rAttrs[USTR("svg:x")+sPairCount] =
+                formatNumber(rImporter.adjustX(aPoints[i].getX()), "cm");
+            rAttrs[USTR("svg:y")+sPairCount] =
+                formatNumber(rImporter.adjustY(aPoints[i].getY()), "cm");
         }
-        while ( nIndex >= 0 );
     }
 
     rtl::OUString GetArrowName(sal_Int32 nArrow)
@@ -379,70 +445,89 @@ namespace
         return sArrow;
     }
 
-    class EqualStyle :
-        public std::unary_function<const autostyle &, bool>
+    //Independent of the order of the entries, so equal PropertyMaps hash
+    //equally whatever the layout of their buckets
+    size_t hashAutoStyle(const PropertyMap &rStyle)
     {
-    private:
-        const PropertyMap &mrStyle;
-    public:
-        EqualStyle(const PropertyMap &rStyle) : mrStyle(rStyle) {};
-        bool operator()(const autostyle &rStyle)
-            {return mrStyle == rStyle.second;}
-    };
+        size_t nHash = rStyle.size();
+        PropertyMap::const_iterator aEnd = rStyle.end();
+        for (PropertyMap::const_iterator aI = rStyle.begin(); aI != aEnd; ++aI)
+        {
+            size_t nEntry = 0;
+            boost::hash_combine(nEntry, aI->first.hashCode());
+            boost::hash_combine(nEntry, aI->second.hashCode());
+            nHash += nEntry;
+        }
+        return nHash;
+    }
 
-    class EqualParaTextStyle :
-        public std::unary_function<const extendedautostyle &, bool>
+    size_t hashAutoStyle(const ParaTextStyle &rStyle)
     {
-    private:
-        const ParaTextStyle &mrStyle;
-    public:
-        EqualParaTextStyle(const ParaTextStyle &rStyle) : mrStyle(rStyle) {};
-        bool operator()(const extendedautostyle &rStyle)
+        size_t nHash = hashAutoStyle(rStyle.maTextAttrs);
+        boost::hash_combine(nHash, hashAutoStyle(rStyle.maParaAttrs));
+        return nHash;
+    }
+
+    //Position of rStyle in rStyles, or rStyles.size() if it's not there. Only
+    //the styles with the same hash need to be compared
+    template<typename T> size_t findAutoStyle(const std::vector< std::pair<rtl::OUString, T> > &rStyles,
+        const styleindex &rIndex, size_t nHash, const T &rStyle)
+    {
+        std::pair<styleindex::const_iterator, styleindex::const_iterator> aRange = rIndex.equal_range(nHash);
+        for (styleindex::const_iterator aI = aRange.first; aI != aRange.second; ++aI)
         {
-            return mrStyle.maTextAttrs == rStyle.second.maTextAttrs &&
-                   mrStyle.maParaAttrs == rStyle.second.maParaAttrs;
+            if (rStyles[aI->second].second == rStyle)
+                return aI->second;
         }
-    };
+        return rStyles.size();
+    }
+
+    template<typename T> void appendAutoStyle(std::vector< std::pair<rtl::OUString, T> > &rStyles,
+        styleindex &rIndex, size_t nHash, const rtl::OUString &rName, const T &rStyle)
+    {
+        rIndex.insert(styleindex::value_type(nHash, rStyles.size()));
+        rStyles.push_back(std::pair<rtl::OUString, T>(rName, rStyle));
+    }
 
     PropertyMap makeDash(float nLen)
     {
         PropertyMap aAttrs;
-        aAttrs[USTR("draw:style")] = USTR("rect");
-        aAttrs[USTR("draw:dots1")] = USTR("1");
-        aAttrs[USTR("draw:dots1-length")]  = rtl::OUString::number(nLen) + USTR("cm");
-        aAttrs[USTR("draw:distance")] = rtl::OUString::number(nLen) + USTR("cm");
+        aAttrs["draw:style"] = USTR("rect");
+        aAttrs["draw:dots1"] = USTR("1");
+        aAttrs["draw:dots1-length"]  = formatNumber(nLen, "cm");
+        aAttrs["draw:distance"] = formatNumber(nLen, "cm");
         return aAttrs;
     }
 
     PropertyMap makeDashDot(float nLen)
     {
         PropertyMap aAttrs;
-        aAttrs[USTR("draw:style")] = USTR("rect");
-        aAttrs[USTR("draw:dots1")] = USTR("1");
-        aAttrs[USTR("draw:dots1-length")] = rtl::OUString::number(nLen) + USTR("cm");
-        aAttrs[USTR("draw:dots2")] = USTR("1");
-        aAttrs[USTR("draw:distance")] = rtl::OUString::number(nLen*0.45) + USTR("cm");
+        aAttrs["draw:style"] = USTR("rect");
+        aAttrs["draw:dots1"] = USTR("1");
+        aAttrs["draw:dots1-length"] = formatNumber(nLen, "cm");
+        aAttrs["draw:dots2"] = USTR("1");
+        aAttrs["draw:distance"] = formatNumber(nLen*0.45, "cm");
         return aAttrs;
     }
 
     PropertyMap makeDashDotDot(float nLen)
     {
         PropertyMap aAttrs;
-        aAttrs[USTR("draw:style")] = USTR("rect");
-        aAttrs[USTR("draw:dots1")] = USTR("1");
-        aAttrs[USTR("draw:dots1-length")] = rtl::OUString::number(nLen) + USTR("cm");
-        aAttrs[USTR("draw:dots2")] = USTR("2");
-        aAttrs[USTR("draw:distance")] =  rtl::OUString::number(nLen*0.225) + USTR("cm");
+        aAttrs["draw:style"] = USTR("rect");
+        aAttrs["draw:dots1"] = USTR("1");
+        aAttrs["draw:dots1-length"] = formatNumber(nLen, "cm");
+        aAttrs["draw:dots2"] = USTR("2");
+        aAttrs["draw:distance"] =  formatNumber(nLen*0.225, "cm");
         return aAttrs;
     }
 
     PropertyMap makeDot(float nLen)
     {
         PropertyMap aAttrs;
-        aAttrs[USTR("draw:style")] = USTR("rect");
-        aAttrs[USTR("draw:dots1")] = USTR("1");
-        aAttrs[USTR("draw:dots1-length")] = rtl::OUString::number(nLen/10.0) + USTR("cm");
-        aAttrs[USTR("draw:distance")] = rtl::OUString::number(nLen*0.1) + USTR("cm");
+        aAttrs["draw:style"] = USTR("rect");
+        aAttrs["draw:dots1"] = USTR("1");
+        aAttrs["draw:dots1-length"] = formatNumber(nLen/10.0, "cm");
+        aAttrs["draw:distance"] = formatNumber(nLen*0.1, "cm");
         return aAttrs;
     }
 
@@ -456,8 +541,8 @@ namespace
             case 1:
             default:
                 //sPoints = USTR("160.75,173.233 150.75,153.233 140.75,173.233");
-                aAttrs[USTR("svg:viewBox")] = USTR("0 0 20 30");
-                aAttrs[USTR("svg:d")] = USTR("m10 0-10 30h20z");
+                aAttrs["svg:viewBox"] = USTR("0 0 20 30");
+                aAttrs["svg:d"] = USTR("m10 0-10 30h20z");
                 return aAttrs;
             case 2: //can't render hollow 
             case 3:
@@ -472,61 +557,61 @@ namespace
                 return makeArrow(1);
             case 7:
                 //can't render
-                //aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 200");
-                //aAttrs[USTR("svg:d")] = USTR("M150.75,153.233 L150.75,143.233, M140.75,143.233 L160.75,163.233 M140.75,153.233 L160.75,153.233Z");
+                //aAttrs["svg:viewBox"] = USTR("0 0 200 200");
+                //aAttrs["svg:d"] = USTR("M150.75,153.233 L150.75,143.233, M140.75,143.233 L160.75,163.233 M140.75,153.233 L160.75,153.233Z");
                 return makeArrow(1);
             case 8:
             case 9: //can't render hollow
-                aAttrs[USTR("svg:viewBox")] = USTR("0 0 1131 1131");
-                aAttrs[USTR("svg:d")] = USTR("m462 1118-102-29-102-51-93-72-72-93-51-102-29-102-13-105 13-102 29-106 51-102 72-89 93-72 102-50 102-34 106-9 101 9 106 34 98 50 93 72 72 89 51 102 29 106 13 102-13 105-29 102-51 102-72 93-93 72-98 51-106 29-101 13z");
+                aAttrs["svg:viewBox"] = USTR("0 0 1131 1131");
+                aAttrs["svg:d"] = USTR("m462 1118-102-29-102-51-93-72-72-93-51-102-29-102-13-105 13-102 29-106 51-102 72-89 93-72 102-50 102-34 106-9 101 9 106 34 98 50 93 72 72 89 51 102 29 106 13 102-13 105-29 102-51 102-72 93-93 72-98 51-106 29-101 13z");
                 return aAttrs;
             case 10: //can't render hollow
             case 11:
-                aAttrs[USTR("svg:viewBox")] = USTR("0 0 1131 1918");
-                aAttrs[USTR("svg:d")] = USTR("m737 1131h394l-564-1131-567 1131h398l-398 787h1131z");
+                aAttrs["svg:viewBox"] = USTR("0 0 1131 1918");
+                aAttrs["svg:d"] = USTR("m737 1131h394l-564-1131-567 1131h398l-398 787h1131z");
                 return aAttrs;
             case 12: //can't render hollow
                 sPoints = USTR("160.75,173.233 150.75,153.233 140.75,173.233");
                 break;
             case 13:
-                aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 100");
-                aAttrs[USTR("svg:d")] = USTR("M100,0 C125,0 150,25 150,50 C150,75 125,100 100,100 C75,100 50,75 50,50 C50,25 75,0 100,0z M0,50 L200,50");
+                aAttrs["svg:viewBox"] = USTR("0 0 200 100");
+                aAttrs["svg:d"] = USTR("M100,0 C125,0 150,25 150,50 C150,75 125,100 100,100 C75,100 50,75 50,50 C50,25 75,0 100,0z M0,50 L200,50");
                 return aAttrs;
             case 14:
-                aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 100");
-                aAttrs[USTR("svg:d")] = USTR("M100,0 C125,0 150,25 150,50 C150,75 125,100 100,100 C75,100 50,75 50,50 C50,25 75,0 100,0 M0,50 L200,50");
+                aAttrs["svg:viewBox"] = USTR("0 0 200 100");
+                aAttrs["svg:d"] = USTR("M100,0 C125,0 150,25 150,50 C150,75 125,100 100,100 C75,100 50,75 50,50 C50,25 75,0 100,0 M0,50 L200,50");
                 return aAttrs;
             case 15:
-                aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 100");
-                aAttrs[USTR("svg:d")] = USTR("M100,0 C125,0 150,25 150,50 C150,75 125,100 100,100 C75,100 50,75 50,50 C50,25 75,0 100,0 M0,50 L200,50");
+                aAttrs["svg:viewBox"] = USTR("0 0 200 100");
+                aAttrs["svg:d"] = USTR("M100,0 C125,0 150,25 150,50 C150,75 125,100 100,100 C75,100 50,75 50,50 C50,25 75,0 100,0 M0,50 L200,50");
                 return aAttrs;
             case 16:
-                aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 100");
-                aAttrs[USTR("svg:d")] = USTR("M50,0 L150,0 L150,100 L50,100z M0,50 L200,50");
+                aAttrs["svg:viewBox"] = USTR("0 0 200 100");
+                aAttrs["svg:d"] = USTR("M50,0 L150,0 L150,100 L50,100z M0,50 L200,50");
                 return aAttrs;
             case 17:
-                aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 100");
-                aAttrs[USTR("svg:d")] = USTR("M50,0 L150,0 L150,100 L50,100z M0,50 L200,50");
+                aAttrs["svg:viewBox"] = USTR("0 0 200 100");
+                aAttrs["svg:d"] = USTR("M50,0 L150,0 L150,100 L50,100z M0,50 L200,50");
                 return aAttrs;
             case 18:
                 //can't render
-                //aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 200");
-                //aAttrs[USTR("svg:d")] = USTR("M100,100 L100,200 M0,100 L200,100 M20,20 L180,180");
+                //aAttrs["svg:viewBox"] = USTR("0 0 200 200");
+                //aAttrs["svg:d"] = USTR("M100,100 L100,200 M0,100 L200,100 M20,20 L180,180");
                 return makeArrow(1);
             case 19:
                 //can't render
-                //aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 200");
-                //aAttrs[USTR("svg:d")] = USTR("M20,20 C20,90 180,110 180,180 M100,100 L100,200 M0,100 L200,100");
+                //aAttrs["svg:viewBox"] = USTR("0 0 200 200");
+                //aAttrs["svg:d"] = USTR("M20,20 C20,90 180,110 180,180 M100,100 L100,200 M0,100 L200,100");
                 return makeArrow(1);
             case 20:
                 //can't render
-                //aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 200");
-                //aAttrs[USTR("svg:d")] = USTR("M100,200 L200,0 M100,200 L0,0 M100,20 L100,0");
+                //aAttrs["svg:viewBox"] = USTR("0 0 200 200");
+                //aAttrs["svg:d"] = USTR("M100,200 L200,0 M100,200 L0,0 M100,20 L100,0");
                 return makeArrow(1);
             case 21:
                 //can't render
-                //aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 200");
-                //aAttrs[USTR("svg:d")] = USTR("M0,100 L200,100 M100,0 L100,200");
+                //aAttrs["svg:viewBox"] = USTR("0 0 200 200");
+                //aAttrs["svg:d"] = USTR("M0,100 L200,100 M100,0 L100,200");
                 return makeArrow(1);
             case 22:
             case 23: //can't render hollow
@@ -534,52 +619,52 @@ namespace
                 break;
             case 24:
                 //can't render
-                //aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 200");
-                //aAttrs[USTR("svg:d")] = USTR("M200,100 A 100,100 0 0 0 3.1739e-06,100 M100,200 L100,0");
+                //aAttrs["svg:viewBox"] = USTR("0 0 200 200");
+                //aAttrs["svg:d"] = USTR("M200,100 A 100,100 0 0 0 3.1739e-06,100 M100,200 L100,0");
                 return makeArrow(1);
             case 25:
                 //can't render
-                //aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 200");
-                //aAttrs[USTR("svg:d")] = USTR("M200,100 L100,200 L0,100");
+                //aAttrs["svg:viewBox"] = USTR("0 0 200 200");
+                //aAttrs["svg:d"] = USTR("M200,100 L100,200 L0,100");
                 return makeArrow(1);
             case 26:
                 //can't render
-                //aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 100");
-                //aAttrs[USTR("svg:d")] = USTR("M3.1739e-06,100 A100,100 0 10 0 200,100");
+                //aAttrs["svg:viewBox"] = USTR("0 0 200 100");
+                //aAttrs["svg:d"] = USTR("M3.1739e-06,100 A100,100 0 10 0 200,100");
                 return makeArrow(1);
             case 27:
-                aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 400");
-                aAttrs[USTR("svg:d")] = USTR("M 200,100 C 200,155.22847 155.22847,200 100,200 44.771525,200 0,155.22847 0,100 0,44.771525 44.771525,0 100,0 155.22847,0 200,44.771525 200,100 z M 200,400 100,200 0,400 z");
+                aAttrs["svg:viewBox"] = USTR("0 0 200 400");
+                aAttrs["svg:d"] = USTR("M 200,100 C 200,155.22847 155.22847,200 100,200 44.771525,200 0,155.22847 0,100 0,44.771525 44.771525,0 100,0 155.22847,0 200,44.771525 200,100 z M 200,400 100,200 0,400 z");
                 return aAttrs;
             case 28:
                 //can't render
-                //aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 400");
-                //aAttrs[USTR("svg:d")] = USTR("M100,200 L200,0 M100,200 L0,0 M200,200 L 0,200 M100,200 L100,0");
+                //aAttrs["svg:viewBox"] = USTR("0 0 200 400");
+                //aAttrs["svg:d"] = USTR("M100,200 L200,0 M100,200 L0,0 M200,200 L 0,200 M100,200 L100,0");
                 return makeArrow(1);
             case 29:
                 //can't render
-                //aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 400");
-                //aAttrs[USTR("svg:d")] = USTR("M 100 250 C 150,250 200,275.832 200,300 C 200,325.832 150,350 100,350 C 50,350 0,325.832 0,300 C 0,275.832 50,250 100,250 M100,200 L200,0 M100,200 L0,0 M100,400 L10,0");
+                //aAttrs["svg:viewBox"] = USTR("0 0 200 400");
+                //aAttrs["svg:d"] = USTR("M 100 250 C 150,250 200,275.832 200,300 C 200,325.832 150,350 100,350 C 50,350 0,325.832 0,300 C 0,275.832 50,250 100,250 M100,200 L200,0 M100,200 L0,0 M100,400 L10,0");
                 return makeArrow(1);
             case 30:
                 //can't render
-                //aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 400");
-                //aAttrs[USTR("svg:d")] = USTR("M 100 250 C 150,250 200,278.32 200,300 C 200,325.832 150,350 100,350 C 50,350 0,325.832 0,300 C 0,275.832 50,250 100,250 M0,100 L200,100 M100,400 L100,0");
+                //aAttrs["svg:viewBox"] = USTR("0 0 200 400");
+                //aAttrs["svg:d"] = USTR("M 100 250 C 150,250 200,278.32 200,300 C 200,325.832 150,350 100,350 C 50,350 0,325.832 0,300 C 0,275.832 50,250 100,250 M0,100 L200,100 M100,400 L100,0");
                 return makeArrow(1);
             case 31:
                 //can't render
-                //aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 200");
-                //aAttrs[USTR("svg:d")] = USTR("M0,200 L200,200 M0,100 L200,100 M100,200 L100,0");
+                //aAttrs["svg:viewBox"] = USTR("0 0 200 200");
+                //aAttrs["svg:d"] = USTR("M0,200 L200,200 M0,100 L200,100 M100,200 L100,0");
                 return makeArrow(1);
             case 32:
                 //can't render
-                //aAttrs[USTR("svg:viewBox")] = USTR("0 0 200 300");
-                //aAttrs[USTR("svg:d")] = USTR("M0,300 L200,100 M100,200 L100,0");
+                //aAttrs["svg:viewBox"] = USTR("0 0 200 300");
+                //aAttrs["svg:d"] = USTR("M0,300 L200,100 M100,200 L100,0");
                 return makeArrow(1);
             case 33:
                 //can't render
-                //aAttrs[USTR("svg:viewBox")] = USTR("0 0 1 300");
-                //aAttrs[USTR("svg:d")] = USTR("M0,0 L0,80 M0,134.165 L0,214.165 M0,267.499 L0,347.499");
+                //aAttrs["svg:viewBox"] = USTR("0 0 1 300");
+                //aAttrs["svg:d"] = USTR("M0,0 L0,80 M0,134.165 L0,214.165 M0,267.499 L0,347.499");
                 return makeArrow(1);
         }
         createViewportAndPolygonFromPoints(sPoints, aAttrs);
@@ -624,40 +709,45 @@ namespace
         return sRet;
     }
 
-    void makeCurvedPathFromPoints(PropertyMap& rProps, bool bClose)
+    //Each C takes the next three points as two control points and an end point
+    void makeCurvedPathFromPoints(PropertyMap& rProps, const std::vector< basegfx::B2DPoint > &rPoints,
+        bool bClose, sal_Int32 nMul = 10)
     {
-        rtl::OUString sPoints = rProps[USTR("draw:points")];
-        sal_Int32 nIndex = 0;
-        rtl::OUString sStart = sPoints.getToken(0, ' ', nIndex);
-        rtl::OUString sPath = USTR("M") + sStart;
-        while ( nIndex >= 0 )
+        if (rPoints.empty())
+            return;
+        rtl::OUStringBuffer aPath(static_cast<sal_Int32>(rPoints.size() * 18));
+        aPath.append(sal_Unicode('M'));
+        appendPoint(aPath, rPoints.front(), nMul);
+        for (size_t i = 1; i < rPoints.size(); ++i)
         {
-            sPath = sPath + USTR(" ");
-            sPath = sPath + USTR("C") + sPoints.getToken(0, ' ', nIndex);
-            sPath = sPath + USTR(" ") + sPoints.getToken(0, ' ', nIndex);
-            sPath = sPath + USTR(" ") + sPoints.getToken(0, ' ', nIndex);
+            aPath.appendAscii((i % 3 == 1) ? " C" : " ");
+            appendPoint(aPath, rPoints[i], nMul);
         }
         if (bClose)
-            sPath = sPath + USTR(" ") + sStart + USTR("Z");
-        rProps[USTR("svg:d")] = sPath;
+        {
+            aPath.append(sal_Unicode(' '));
+            appendPoint(aPath, rPoints.front(), nMul);
+            aPath.append(sal_Unicode('Z'));
+        }
+        rProps["svg:d"] = aPath.makeStringAndClear();
     }
 
-    void makePathFromPoints(PropertyMap& rProps, bool bClose)
+    void makePathFromPoints(PropertyMap& rProps, const std::vector< basegfx::B2DPoint > &rPoints,
+        bool bClose, sal_Int32 nMul = 10)
     {
-        rtl::OUString sPoints = rProps[USTR("draw:points")];
-        sal_Int32 nIndex = 0;
-        rtl::OUString sStart = sPoints.getToken(0, ' ', nIndex);
-        rtl::OUString sPath = USTR("M") + sStart;
-        while ( nIndex >= 0 )
+        if (rPoints.empty())
+            return;
+        rtl::OUStringBuffer aPath(static_cast<sal_Int32>(rPoints.size() * 16));
+        aPath.append(sal_Unicode('M'));
+        appendPoint(aPath, rPoints.front(), nMul);
+        for (size_t i = 1; i < rPoints.size(); ++i)
         {
-            sPath = sPath + USTR(" ");
-            sPath = sPath + USTR("L") + sPoints.getToken(0, ' ', nIndex);
-            sPath = sPath + USTR(" ") + sPoints.getToken(0, ' ', nIndex);
-            sPath = sPath + USTR(" ") + sPoints.getToken(0, ' ', nIndex);
+            aPath.appendAscii((i == 1) ? " L" : " ");
+            appendPoint(aPath, rPoints[i], nMul);
         }
         if (bClose)
-            sPath = sPath + USTR(" ") + sStart + USTR("Z");
-        rProps[USTR("svg:d")] = sPath;
+            aPath.appendAscii(" Z");
+        rProps["svg:d"] = aPath.makeStringAndClear();
     }
 
     rtl::OUString deHashString(const rtl::OUString &rStr)
@@ -673,58 +763,190 @@ namespace
         }
         return rtl::OUString();
     }
+
+    //The names of the dia:attribute elements we understand, looked up once
+    //per attribute and then dispatched with a switch
+    enum DiaAttribute
+    {
+        ATTR_UNKNOWN,
+        //paper
+        ATTR_NAME, ATTR_TMARGIN, ATTR_BMARGIN, ATTR_LMARGIN, ATTR_RMARGIN,
+        ATTR_IS_PORTRAIT, ATTR_SCALING, ATTR_FITTO, ATTR_FITWIDTH, ATTR_FITHEIGHT,
+        //objects
+        ATTR_OBJ_POS, ATTR_OBJ_BB, ATTR_ELEM_CORNER, ATTR_ELEM_WIDTH, ATTR_ELEM_HEIGHT,
+        ATTR_BORDER_WIDTH, ATTR_LINE_WIDTH, ATTR_BORDER_COLOR, ATTR_LINE_COLOR,
+        ATTR_INNER_COLOR, ATTR_FILL_COLOR, ATTR_SHOW_BACKGROUND, ATTR_LINE_STYLE,
+        ATTR_DASHLENGTH, ATTR_CORNER_RADIUS, ATTR_ASPECT, ATTR_POLY_POINTS,
+        ATTR_ORTH_POINTS, ATTR_BEZ_POINTS, ATTR_ORTH_ORIENT, ATTR_KEEP_ASPECT,
+        ATTR_CONN_ENDPOINTS, ATTR_DRAW_BORDER, ATTR_SUBSCALE, ATTR_FLIP_HORIZONTAL,
+        ATTR_FLIP_VERTICAL, ATTR_TEXT, ATTR_PADDING, ATTR_START_ARROW,
+        ATTR_START_ARROW_WIDTH, ATTR_START_ARROW_LENGTH, ATTR_END_ARROW,
+        ATTR_END_ARROW_WIDTH, ATTR_END_ARROW_LENGTH, ATTR_VALIGN, ATTR_META,
+        ATTR_NUMCP, ATTR_CORNER_TYPES,
+        //specific objects
+        ATTR_FILE, ATTR_AUTOROUTING, ATTR_CURVE_DISTANCE, ATTR_SHEAR_ANGLE, ATTR_TYPE,
+        //text
+        ATTR_STRING, ATTR_COLOR, ATTR_FONT, ATTR_HEIGHT, ATTR_POS, ATTR_ALIGNMENT
+    };
+
+    struct AttributeName
+    {
+        const char *mpName;
+        DiaAttribute meAttribute;
+    };
+
+    const AttributeName aAttributeNames[] =
+    {
+        { "name", ATTR_NAME },
+        { "tmargin", ATTR_TMARGIN },
+        { "bmargin", ATTR_BMARGIN },
+        { "lmargin", ATTR_LMARGIN },
+        { "rmargin", ATTR_RMARGIN },
+        { "is_portrait", ATTR_IS_PORTRAIT },
+        { "scaling", ATTR_SCALING },
+        { "fitto", ATTR_FITTO },
+        { "fitwidth", ATTR_FITWIDTH },
+        { "fitheight", ATTR_FITHEIGHT },
+        { "obj_pos", ATTR_OBJ_POS },
+        { "obj_bb", ATTR_OBJ_BB },
+        { "elem_corner", ATTR_ELEM_CORNER },
+        { "elem_width", ATTR_ELEM_WIDTH },
+        { "elem_height", ATTR_ELEM_HEIGHT },
+        { "border_width", ATTR_BORDER_WIDTH },
+        { "line_width", ATTR_LINE_WIDTH },
+        { "border_color", ATTR_BORDER_COLOR },
+        { "line_color", ATTR_LINE_COLOR },
+        { "line_colour", ATTR_LINE_COLOR },
+        { "inner_color", ATTR_INNER_COLOR },
+        { "fill_color", ATTR_FILL_COLOR },
+        { "fill_colour", ATTR_FILL_COLOR },
+        { "show_background", ATTR_SHOW_BACKGROUND },
+        { "line_style", ATTR_LINE_STYLE },
+        { "dashlength", ATTR_DASHLENGTH },
+        { "corner_radius", ATTR_CORNER_RADIUS },
+        { "aspect", ATTR_ASPECT },
+        { "poly_points", ATTR_POLY_POINTS },
+        { "orth_points", ATTR_ORTH_POINTS },
+        { "bez_points", ATTR_BEZ_POINTS },
+        { "orth_orient", ATTR_ORTH_ORIENT },
+        { "keep_aspect", ATTR_KEEP_ASPECT },
+        { "conn_endpoints", ATTR_CONN_ENDPOINTS },
+        { "draw_border", ATTR_DRAW_BORDER },
+        { "subscale", ATTR_SUBSCALE },
+        { "flip_horizontal", ATTR_FLIP_HORIZONTAL },
+        { "flip_vertical", ATTR_FLIP_VERTICAL },
+        { "text", ATTR_TEXT },
+        { "padding", ATTR_PADDING },
+        { "start_arrow", ATTR_START_ARROW },
+        { "start_arrow_width", ATTR_START_ARROW_WIDTH },
+        { "start_arrow_length", ATTR_START_ARROW_LENGTH },
+        { "end_arrow", ATTR_END_ARROW },
+        { "end_arrow_width", ATTR_END_ARROW_WIDTH },
+        { "end_arrow_length", ATTR_END_ARROW_LENGTH },
+        { "valign", ATTR_VALIGN },
+        { "meta", ATTR_META },
+        { "numcp", ATTR_NUMCP },
+        { "corner_types", ATTR_CORNER_TYPES },
+        { "file", ATTR_FILE },
+        { "autorouting", ATTR_AUTOROUTING },
+        { "curve_distance", ATTR_CURVE_DISTANCE },
+        { "shear_angle", ATTR_SHEAR_ANGLE },
+        { "type", ATTR_TYPE },
+        { "string", ATTR_STRING },
+        { "color", ATTR_COLOR },
+        { "font", ATTR_FONT },
+        { "height", ATTR_HEIGHT },
+        { "pos", ATTR_POS },
+        { "alignment", ATTR_ALIGNMENT }
+    };
+
+    class AttributeTable
+    {
+    private:
+        typedef boost::unordered_map< rtl::OUString, DiaAttribute, rtl::OUStringHash > attributemap;
+        attributemap maAttributes;
+    public:
+        AttributeTable()
+        {
+            for (size_t i = 0; i < sizeof(aAttributeNames) / sizeof(aAttributeNames[0]); ++i)
+            {
+                maAttributes[rtl::OUString::createFromAscii(aAttributeNames[i].mpName)] =
+                    aAttributeNames[i].meAttribute;
+            }
+        }
+        DiaAttribute lookup(const rtl::OUString &rName) const
+        {
+            attributemap::const_iterator aI = maAttributes.find(rName);
+            return aI != maAttributes.end() ? aI->second : ATTR_UNKNOWN;
+        }
+    };
+
+    struct theAttributeTable : public rtl::Static<AttributeTable, theAttributeTable> {};
+
+    //Find which attribute a dia:attribute element is, false if it has no name
+    bool lookupAttribute(const uno::Reference<xml::dom::XElement> &rxElem, rtl::OUString &rName, DiaAttribute &reAttr)
+    {
+        const uno::Reference<xml::dom::XNamedNodeMap> xAttributes = rxElem->getAttributes();
+        uno::Reference<xml::dom::XNode> xNode(xAttributes->getNamedItem(USTR("name")));
+        if (!xNode.is())
+            return false;
+        rName = xNode->getNodeValue();
+        reAttr = theAttributeTable::get().lookup(rName);
+        return true;
+    }
 }
 
 void DiaImporter::handleDiagramDataPaperAttribute(const uno::Reference<xml::dom::XElement> &rxElem, PropertyMap &rAttrs)
 {
-    const uno::Reference<xml::dom::XNamedNodeMap> xAttributes = rxElem->getAttributes();
-    uno::Reference<xml::dom::XNode> xNode(xAttributes->getNamedItem(USTR("name")));
-    if(xNode.is())
+    rtl::OUString sName;
+    DiaAttribute eAttr;
+    if (!lookupAttribute(rxElem, sName, eAttr))
+        return;
+
+    rtl::OUString sVal = valueOfSimpleAttribute(rxElem);
+    switch (eAttr)
     {
-        rtl::OUString sName(xNode->getNodeValue());
-        rtl::OUString sVal = valueOfSimpleAttribute(rxElem);
-        if (sName == USTR("name"))
+        case ATTR_NAME:
         {
             rtl::OUString sPaper = deHashString(sVal);
             Paper ePaper = PaperInfo::fromPSName(rtl::OUStringToOString(sPaper, RTL_TEXTENCODING_UTF8));
             if (ePaper != PAPER_USER)
             {
                 PaperInfo aPaper(ePaper);
-                rAttrs[USTR("fo:page-width")] = rtl::OUString::number(aPaper.getWidth()/100.0)+USTR("mm");
-                rAttrs[USTR("fo:page-height")] = rtl::OUString::number(aPaper.getHeight()/100.0)+USTR("mm");
+                mfPageWidth = aPaper.getWidth()/100.0;
+                mfPageHeight = aPaper.getHeight()/100.0;
             }
             else
                 fprintf(stderr, "Unknown paper type of %s\n", rtl::OUStringToOString(sVal, RTL_TEXTENCODING_UTF8).getStr());
+            break;
         }
-        else if (sName == USTR("tmargin"))
-        {
-            rAttrs[USTR("fo:margin-top")] = sVal+USTR("cm");
-            mnTop = sVal.toFloat();
-        }
-        else if (sName == USTR("bmargin"))
-            rAttrs[USTR("fo:margin-bottom")] = sVal+USTR("cm");
-        else if (sName == USTR("lmargin"))
-        {
-            rAttrs[USTR("fo:margin-left")] = sVal+USTR("cm");
-            mnLeft = sVal.toFloat();
-        }
-        else if (sName == USTR("rmargin"))
-            rAttrs[USTR("fo:margin-right")] = sVal+USTR("cm");
-        else if (sName == USTR("is_portrait"))
-        {
-            rAttrs[USTR("style:print-orientation")] = 
+        case ATTR_TMARGIN:
+            mnTop = sVal.toDouble();
+            rAttrs["fo:margin-top"] = formatNumber(mnTop, "cm");
+            break;
+        case ATTR_BMARGIN:
+            rAttrs["fo:margin-bottom"] = formatNumber(sVal.toDouble(), "cm");
+            break;
+        case ATTR_LMARGIN:
+            mnLeft = sVal.toDouble();
+            rAttrs["fo:margin-left"] = formatNumber(mnLeft, "cm");
+            break;
+        case ATTR_RMARGIN:
+            rAttrs["fo:margin-right"] = formatNumber(sVal.toDouble(), "cm");
+            break;
+        case ATTR_IS_PORTRAIT:
+            rAttrs["style:print-orientation"] = 
                 sVal != USTR("true") ?  USTR("landscape") : USTR("portrait");
-        }
-        else if (sName == USTR("scaling")) /*don't think this make sense from an OOo perspective*/
-             /*IgnoreThis*/;
-        else if (sName == USTR("fitto")) /*don't think this make sense from an OOo perspective*/
-             /*IgnoreThis*/;
-        else if (sName == USTR("fitwidth")) /*don't think this make sense from an OOo perspective*/
-             /*IgnoreThis*/;
-        else if (sName == USTR("fitheight")) /*don't think this make sense from an OOo perspective*/
-             /*IgnoreThis*/;
-        else
+            break;
+        case ATTR_SCALING: /*don't think these make sense from an OOo perspective*/
+        case ATTR_FITTO:
+        case ATTR_FITWIDTH:
+        case ATTR_FITHEIGHT:
+             /*IgnoreThis*/
+            break;
+        default:
             fprintf(stderr, "Unknown Paper Attribute %s\n", rtl::OUStringToOString(sName, RTL_TEXTENCODING_UTF8).getStr());
+            break;
     }
 }
 
@@ -747,13 +969,9 @@ void DiaImporter::handleDiagramDataPaperComposite(const uno::Reference<xml::dom:
     }
 
     //Swap dimensions for Landscape
-    PropertyMap::const_iterator aI = aAttrs.find(USTR("style:print-orientation"));
+    PropertyMap::const_iterator aI = aAttrs.find("style:print-orientation");
     if (aI != aAttrs.end() && aI->second == USTR("landscape"))
-    {
-        rtl::OUString sWidth = aAttrs[USTR("fo:page-width")];
-        aAttrs[USTR("fo:page-width")] = aAttrs[USTR("fo:page-height")];
-        aAttrs[USTR("fo:page-height")] = sWidth;
-    }
+        std::swap(mfPageWidth, mfPageHeight);
 
     page_layout_properties.reset(new autostyle(USTR("style:page-layout-properties"), aAttrs));
 }
@@ -786,9 +1004,9 @@ void DiaImporter::handleDiagramDataBackGroundColor(const uno::Reference<xml::dom
     {
         PropertyMap aAttrs;
 
-        aAttrs[USTR("draw:background-size")] = USTR("border");
-        aAttrs[USTR("draw:fill")] = USTR("solid");
-        aAttrs[USTR("draw:fill-color")] = xNode->getNodeValue();
+        aAttrs["draw:background-size"] = USTR("border");
+        aAttrs["draw:fill"] = USTR("solid");
+        aAttrs["draw:fill-color"] = xNode->getNodeValue();
 
         drawing_page_properties.reset(new autostyle(USTR("style:drawing-page-properties"), aAttrs ));
     }
@@ -852,9 +1070,14 @@ void DiaImporter::handleDiagramData(const uno::Reference<xml::dom::XElement> &rx
     }
 }
 
+void DiaImporter::addDash(const rtl::OUString &rName, const PropertyMap &rStrokeDash)
+{
+    appendAutoStyle(maDashes, maDashIndex, hashAutoStyle(rStrokeDash), rName, rStrokeDash);
+}
+
 void DiaImporter::addStrokeDash(PropertyMap &rStyleAttrs, sal_Int32 nLineStyle, float nDashLength)
 {
-    rStyleAttrs[USTR("draw:stroke")] = USTR("dash");
+    rStyleAttrs["draw:stroke"] = USTR("dash");
 
     PropertyMap aStrokeDash;
     switch (nLineStyle)
@@ -876,36 +1099,39 @@ void DiaImporter::addStrokeDash(PropertyMap &rStyleAttrs, sal_Int32 nLineStyle,
             break;
     }
 
-    autostyles::const_iterator aI = std::find_if(maDashes.begin(), maDashes.end(), EqualStyle(aStrokeDash));
+    size_t nHash = hashAutoStyle(aStrokeDash);
+    size_t nIndex = findAutoStyle(maDashes, maDashIndex, nHash, aStrokeDash);
 
     rtl::OUString sName;
 
-    if (aI != maDashes.end())
-        sName = aI->first;
+    if (nIndex != maDashes.size())
+        sName = maDashes[nIndex].first;
     else
     {
         sName = USTR("DIA_20_Line_20_") + rtl::OUString::number(static_cast<sal_Int64>(maDashes.size()+1-4));
-        maDashes.push_back(autostyle(sName, aStrokeDash));
+        appendAutoStyle(maDashes, maDashIndex, nHash, sName, aStrokeDash);
     }
 
-    rStyleAttrs[USTR("draw:stroke-dash")] = sName;
+    rStyleAttrs["draw:stroke-dash"] = sName;
 }
 
 void GraphicStyleManager::addAutomaticGraphicStyle(PropertyMap &rAttrs, const PropertyMap &rStyleAttrs)
 {
     rtl::OUString sName;
 
-    autostyles::const_iterator aI = std::find_if(maGraphicStyles.begin(), maGraphicStyles.end(), EqualStyle(rStyleAttrs));
+    size_t nHash = hashAutoStyle(rStyleAttrs);
+    size_t nIndex = findAutoStyle(maGraphicStyles, maStyleIndex, nHash, rStyleAttrs);
 
-    if (aI != maGraphicStyles.end())
-        sName = aI->first;
+    if (nIndex != maGraphicStyles.size())
+        sName = maGraphicStyles[nIndex].first;
     else
     {
         sName = USTR("gr") + rtl::OUString::number(static_cast<sal_Int64>(maGraphicStyles.size()+1));
-        maGraphicStyles.push_back(autostyle(sName, rStyleAttrs));
+        maNameIndex[sName] = maGraphicStyles.size();
+        appendAutoStyle(maGraphicStyles, maStyleIndex, nHash, sName, rStyleAttrs);
     }
 
-    rAttrs[USTR("draw:style-name")] = sName;
+    rAttrs["draw:style-name"] = sName;
 }
 
 void TextStyleManager::addAutomaticTextStyle(PropertyMap &rAttrs, ParaTextStyle &rStyleAttrs)
@@ -914,76 +1140,50 @@ void TextStyleManager::addAutomaticTextStyle(PropertyMap &rAttrs, ParaTextStyle
 
     fixFontSizes(rStyleAttrs.maTextAttrs);
 
-    extendedautostyles::const_iterator aI = std::find_if(maTextStyles.begin(), maTextStyles.end(),
-        EqualParaTextStyle(rStyleAttrs));
+    size_t nHash = hashAutoStyle(rStyleAttrs);
+    size_t nIndex = findAutoStyle(maTextStyles, maStyleIndex, nHash, rStyleAttrs);
 
-    if (aI != maTextStyles.end())
-        sName = aI->first;
+    if (nIndex != maTextStyles.size())
+        sName = maTextStyles[nIndex].first;
     else
     {
         sName = USTR("P") + rtl::OUString::number(static_cast<sal_Int64>(maTextStyles.size()+1));
-        maTextStyles.push_back(extendedautostyle(sName, rStyleAttrs));
+        maNameIndex[sName] = maTextStyles.size();
+        appendAutoStyle(maTextStyles, maStyleIndex, nHash, sName, rStyleAttrs);
     }
 
-    rAttrs[USTR("text:style-name")] = sName;
-}
-
-namespace
-{
-    class IsAutoStyleName :
-        public std::unary_function<const autostyle &, bool>
-    {
-    private:
-        const rtl::OUString &mrName;
-    public:
-        IsAutoStyleName(const rtl::OUString &rName) : mrName(rName) {};
-        bool operator()(const autostyle &rStyle)
-            {return mrName == rStyle.first;}
-    };
-
-    class IsExtendedAutoStyleName :
-        public std::unary_function<const extendedautostyle &, bool>
-    {
-    private:
-        const rtl::OUString &mrName;
-    public:
-        IsExtendedAutoStyleName(const rtl::OUString &rName) : mrName(rName) {};
-        bool operator()(const extendedautostyle &rStyle)
-            {return mrName == rStyle.first;}
-    };
-
+    rAttrs["text:style-name"] = sName;
 }
 
 const PropertyMap *GraphicStyleManager::getStyleByName(const rtl::OUString &rName) const
 {
-    autostyles::const_iterator aI = std::find_if(maGraphicStyles.begin(), maGraphicStyles.end(), IsAutoStyleName(rName));
-    PropertyMap *pRet = NULL;
-    if (aI != maGraphicStyles.end())
-        return &(aI->second);
-    return pRet;
+    stylenameindex::const_iterator aI = maNameIndex.find(rName);
+    if (aI != maNameIndex.end())
+        return &(maGraphicStyles[aI->second].second);
+    return NULL;
 }
 
 const PropertyMap *TextStyleManager::getStyleByName(const rtl::OUString &rName) const
 {
-    extendedautostyles::const_iterator aI = std::find_if(maTextStyles.begin(), maTextStyles.end(), IsExtendedAutoStyleName(rName));
-    PropertyMap *pRet = NULL;
-    if (aI != maTextStyles.end())
-        return &(aI->second.maTextAttrs);
-    return pRet;
+    stylenameindex::const_iterator aI = maNameIndex.find(rName);
+    if (aI != maNameIndex.end())
+        return &(maTextStyles[aI->second].second.maTextAttrs);
+    return NULL;
 }
 
 void GraphicStyleManager::addTextBoxStyle()
 {
     PropertyMap aStyleAttrs;
 
-    aStyleAttrs[USTR("draw:stroke")]=USTR("none");
-    aStyleAttrs[USTR("draw:fill")]=USTR("none");
-    aStyleAttrs[USTR("draw:textarea-horizontal-align")] = USTR("center");
-    aStyleAttrs[USTR("draw:textarea-vertical-align")] = USTR("middle");
-    aStyleAttrs[USTR("draw:auto-grow-width")]=USTR("true");
-    aStyleAttrs[USTR("fo:min-height")]=USTR("0.5cm");
+    aStyleAttrs["draw:stroke"]=USTR("none");
+    aStyleAttrs["draw:fill"]=USTR("none");
+    aStyleAttrs["draw:textarea-horizontal-align"] = USTR("center");
+    aStyleAttrs["draw:textarea-vertical-align"] = USTR("middle");
+    aStyleAttrs["draw:auto-grow-width"]=USTR("true");
+    aStyleAttrs["fo:min-height"]=USTR("0.5cm");
 
-    maGraphicStyles.push_back(autostyle(USTR("grtext"), aStyleAttrs));
+    maNameIndex[USTR("grtext")] = maGraphicStyles.size();
+    appendAutoStyle(maGraphicStyles, maStyleIndex, hashAutoStyle(aStyleAttrs), USTR("grtext"), aStyleAttrs);
 }
 
 void GraphicStyleManager::write(uno::Reference < xml::sax::XDocumentHandler > xDocHandler)
@@ -992,10 +1192,10 @@ void GraphicStyleManager::write(uno::Reference < xml::sax::XDocumentHandler > xD
     for (autostyles::const_iterator aI = maGraphicStyles.begin(); aI != aEnd; ++aI)
     {
         PropertyMap aAttrs;
-        aAttrs[USTR( "style:name")] = aI->first;
-        aAttrs[USTR( "style:family")] = USTR("graphic");
+        aAttrs["style:name"] = aI->first;
+        aAttrs["style:family"] = USTR("graphic");
         xDocHandler->startElement(USTR("style:style"), makeXAttributeAndClear(aAttrs));
-        xDocHandler->startElement(USTR("style:graphic-properties"), new SaxAttrList(aI->second));
+        xDocHandler->startElement(USTR("style:graphic-properties"), makeXAttribute(aI->second));
         xDocHandler->endElement(USTR("style:graphic-properties"));
         xDocHandler->endElement(USTR("style:style"));
     }
@@ -1007,12 +1207,12 @@ void TextStyleManager::write(uno::Reference < xml::sax::XDocumentHandler > xDocH
     for (extendedautostyles::const_iterator aI = maTextStyles.begin(); aI != aEnd; ++aI)
     {
         PropertyMap aAttrs;
-        aAttrs[USTR( "style:name")] = aI->first;
-        aAttrs[USTR( "style:family")] = USTR("paragraph");
+        aAttrs["style:name"] = aI->first;
+        aAttrs["style:family"] = USTR("paragraph");
         xDocHandler->startElement(USTR("style:style"), makeXAttributeAndClear(aAttrs));
-        xDocHandler->startElement(USTR("style:text-properties"), new SaxAttrList(aI->second.maTextAttrs));
+        xDocHandler->startElement(USTR("style:text-properties"), makeXAttribute(aI->second.maTextAttrs));
         xDocHandler->endElement(USTR("style:text-properties"));
-        xDocHandler->startElement(USTR("style:paragraph-properties"), new SaxAttrList(aI->second.maParaAttrs));
+        xDocHandler->startElement(USTR("style:paragraph-properties"), makeXAttribute(aI->second.maParaAttrs));
         xDocHandler->endElement(USTR("style:paragraph-properties"));
         xDocHandler->endElement(USTR("style:style"));
     }
@@ -1022,44 +1222,37 @@ awt::FontDescriptor TextStyleManager::getFontDescriptor(const PropertyMap &rStyl
 {
     awt::FontDescriptor aFD;
     PropertyMap::const_iterator aI;
-    aI = rStyleAttrs.find(USTR("fo:font-family"));
+    aI = rStyleAttrs.find("fo:font-family");
     if (aI != rStyleAttrs.end())
         aFD.Name = aI->second;
-    aI = rStyleAttrs.find(USTR("fo:font-size"));
+    aI = rStyleAttrs.find("fo:font-size");
     if (aI != rStyleAttrs.end())
     {
         rtl::OUString ptsize = ::comphelper::string::searchAndReplaceAllAsciiWithAscii(aI->second, "pt", "");
         aFD.Height = ptsize.toFloat();
     }
-    aI = rStyleAttrs.find(USTR("fo:font-style"));
+    aI = rStyleAttrs.find("fo:font-style");
     if (aI != rStyleAttrs.end() && aI->second == USTR("italic"))
         aFD.Slant = awt::FontSlant_ITALIC;
-    aI = rStyleAttrs.find(USTR("fo:font-weight"));
+    aI = rStyleAttrs.find("fo:font-weight");
     if (aI != rStyleAttrs.end() && aI->second == USTR("bold"))
         aFD.Weight = 700;
     return aFD;
 }
 
-uno::Reference< awt::XFont > TextStyleManager::getMatchingFont(const PropertyMap &rStyleAttrs) const
+FontMetric TextStyleManager::getFontMetric(const PropertyMap &rStyleAttrs) const
 {
-    awt::FontDescriptor aFD = getFontDescriptor(rStyleAttrs);
-    return mxReferenceDevice->getFont(aFD);
+    return mpFontMetrics->getFontMetric(getFontDescriptor(rStyleAttrs));
 }
 
-double TextStyleManager::getStringWidth(const rtl::OUString &rStyleName, const rtl::OUString &rString) const
+void TextStyleManager::getStringWidths(const PropertyMap &rStyleAttrs,
+    const std::vector< rtl::OUString > &rStrings, std::vector< double > &rWidths) const
 {
-    sal_Int32 nWidth = 0;
-
-    if (rStyleName.getLength())
-    {
-        if (const PropertyMap *pStyle = getStyleByName(rStyleName))
-        {
-            uno::Reference< awt::XFont > xFont = getMatchingFont(*pStyle);
-            nWidth = xFont->getStringWidth(rString);
-        }
-    }
+    awt::FontDescriptor aFD = getFontDescriptor(rStyleAttrs);
 
-    return nWidth / 72.0 * 2.54;
+    rWidths.resize(rStrings.size());
+    for (size_t i = 0; i < rStrings.size(); ++i)
+        rWidths[i] = mpFontMetrics->getStringWidth(aFD, rStrings[i]) / 72.0 * 2.54;
 }
 
 void TextStyleManager::fixFontSizes(PropertyMap &rStyleAttrs)
@@ -1073,13 +1266,12 @@ void TextStyleManager::fixFontSizes(PropertyMap &rStyleAttrs)
 
     awt::FontDescriptor aFD = getFontDescriptor(rStyleAttrs);
 
-    uno::Reference< awt::XFont > xFont(mxReferenceDevice->getFont(aFD));
-    awt::SimpleFontMetric aMetric = xFont->getFontMetric();
+    FontMetric aMetric = mpFontMetrics->getFontMetric(aFD);
 
-    float nTotal = aMetric.Ascent + aMetric.Descent + aMetric.Leading;
+    float nTotal = aMetric.mfAscent + aMetric.mfDescent + aMetric.mfLeading;
     float fAdjust = aFD.Height/nTotal;
 
-    rStyleAttrs[USTR("fo:font-size")] = rtl::OUString::number(aFD.Height * fAdjust) + USTR("pt");
+    rStyleAttrs["fo:font-size"] = formatNumber(aFD.Height * fAdjust, "pt");
 }
 
 diaobject DiaImporter::getobjectbyid(const rtl::OUString &rId) const
@@ -1091,6 +1283,43 @@ diaobject DiaImporter::getobjectbyid(const rtl::OUString &rId) const
     return ret;
 }
 
+class DiaObject;
+
+//Gathers the lines of text of every object so that each distinct line of
+//each text style is measured once, all in one go, before anything needs
+//the results
+class TextLayouter
+{
+private:
+    typedef boost::unordered_map< rtl::OUString, size_t, rtl::OUStringHash > lineindex;
+    struct StyleLines
+    {
+        lineindex maIndex;
+        std::vector< rtl::OUString > maLines;
+        std::vector< double > maWidths;
+        FontMetric maMetric;
+        bool mbFound;
+        StyleLines() : mbFound(false) {}
+    };
+    typedef boost::unordered_map< rtl::OUString, StyleLines, rtl::OUStringHash > stylelines;
+    stylelines maStyles;
+    std::vector< std::pair< DiaObject*, rtl::OUString > > maObjects;
+    static const StyleLines maEmpty;
+
+    const StyleLines &getStyleLines(const rtl::OUString &rStyleName) const;
+public:
+    void addLines(DiaObject &rObject, const rtl::OUString &rStyleName,
+        const std::vector< rtl::OUString > &rLines);
+    //Measure everything added and hand each object its results
+    void measure(const TextStyleManager &rTextStyleManager);
+
+    bool hasStyle(const rtl::OUString &rStyleName) const
+        { return getStyleLines(rStyleName).mbFound; }
+    const FontMetric &getFontMetric(const rtl::OUString &rStyleName) const
+        { return getStyleLines(rStyleName).maMetric; }
+    double getStringWidth(const rtl::OUString &rStyleName, const rtl::OUString &rLine) const;
+};
+
 class DiaObject
 {
 private:
@@ -1109,10 +1338,39 @@ protected:
     bool mbFlipHori;
     sal_Int32 mnLineStyle;
     float mnDashLength;
-    float mnX, mnY, mnWidth, mnHeight;
-    float mnObjPosX, mnObjPosY;
-    float mnPadding;
-    float mnTextX, mnTextY;
+    double mnObjPosX, mnObjPosY;
+    double mnTextX, mnTextY;
+    //poly_points, orth_points or bez_points, in dia's coordinates
+    std::vector< basegfx::B2DPoint > maPoints;
+
+    //The object's frame, stroke and padding in cm. Kept as numbers through
+    //import, layout and resizing, and only formatted as svg:x, svg:y,
+    //svg:width and svg:height by formatGeometry when the object is written
+    struct Geometry
+    {
+        double mfX, mfY, mfWidth, mfHeight;
+        double mfStrokeWidth;
+        double mfPadding;
+        bool mbHasPosition, mbHasWidth, mbHasHeight;
+        Geometry()
+            : mfX(0), mfY(0), mfWidth(0), mfHeight(0), mfStrokeWidth(0.1), mfPadding(0)
+            , mbHasPosition(false), mbHasWidth(false), mbHasHeight(false) {}
+        void setFrame(const basegfx::B2DRange &rFrame);
+        void format(PropertyMap &rProps) const;
+    };
+    Geometry maGeometry;
+
+    //msString split into lines, and its extents in cm once measured
+    struct TextLayout
+    {
+        std::vector< rtl::OUString > maLines;
+        bool mbMeasured;
+        double mfWidth;
+        double mfLineHeight;
+        double mfAscent;
+        TextLayout() : mbMeasured(false), mfWidth(0), mfLineHeight(0), mfAscent(0) {}
+    };
+    TextLayout maLayout;
 
     PropertyMap handleStandardObject(const uno::Reference<xml::dom::XElement> &rxElem, DiaImporter &rImporter);
     virtual void setdefaultpadding(const uno::Reference<xml::dom::XElement> &rxElem);
@@ -1126,14 +1384,17 @@ public:
     DiaObject()
         : mnTextAlign(0), mbShowBorder(true), mbShowBackground(true), mbAutoWidth(false)
         , mbFlipVert(false), mbFlipHori(false), mnLineStyle(0), mnDashLength(1.0)
-        , mnX(0.0), mnY(0.0), mnWidth(0.0), mnHeight(0.0), mnObjPosX(0.0), mnObjPosY(0.0)
-        , mnPadding(0.0), mnTextX(0.0), mnTextY(0.0) {}
+        , mnObjPosX(0.0), mnObjPosY(0.0), mnTextX(0.0), mnTextY(0.0) {}
     virtual PropertyMap import(const uno::Reference<xml::dom::XElement> &rxElem, DiaImporter &rImporter);
     virtual rtl::OUString outputtype() const = 0;
-    virtual void handleObjectAttribute(const uno::Reference<xml::dom::XElement> &rxElem,
+    virtual void handleObjectAttribute(DiaAttribute eAttr, const rtl::OUString &rName,
+        const uno::Reference<xml::dom::XElement> &rxElem,
         DiaImporter &rImporter, PropertyMap &rAttrs, PropertyMap &rStyleAttrs);
     virtual void write(uno::Reference<xml::sax::XDocumentHandler> &rDocHandler, const PropertyMap &rProps, const DiaImporter &rImporter) const;
+    virtual void collectText(TextLayouter &rLayouter);
+    void applyTextLayout(const TextLayouter &rLayouter, const rtl::OUString &rStyleName);
     virtual void resizeIfNarrow(PropertyMap &rProps, const DiaImporter &rImporter);
+    virtual void formatGeometry(PropertyMap &rProps) { maGeometry.format(rProps); }
     basegfx::B2DRectangle getBoundingBox() const;
     virtual int getConnectionDirection(sal_Int32 nConnection) const;
     virtual void snapConnectionPoint(sal_Int32 nConnection, basegfx::B2DPoint &rPoint, const DiaImporter &rImporter) const;
@@ -1141,9 +1402,31 @@ public:
     virtual ~DiaObject() {}
 };
 
+void DiaObject::Geometry::setFrame(const basegfx::B2DRange &rFrame)
+{
+    mfX = rFrame.getMinX();
+    mfY = rFrame.getMinY();
+    mfWidth = rFrame.getWidth();
+    mfHeight = rFrame.getHeight();
+    mbHasPosition = mbHasWidth = mbHasHeight = true;
+}
+
+void DiaObject::Geometry::format(PropertyMap &rProps) const
+{
+    if (mbHasPosition)
+    {
+        rProps["svg:x"] = formatNumber(mfX, "cm");
+        rProps["svg:y"] = formatNumber(mfY, "cm");
+    }
+    if (mbHasWidth)
+        rProps["svg:width"] = formatNumber(mfWidth, "cm");
+    if (mbHasHeight)
+        rProps["svg:height"] = formatNumber(mfHeight, "cm");
+}
+
 basegfx::B2DRectangle DiaObject::getBoundingBox() const
 {
-    return basegfx::B2DRectangle(mnX, mnY, mnX+mnWidth, mnY+mnHeight);
+    return basegfx::B2DRectangle(maGeometry.mfX, maGeometry.mfY, maGeometry.mfX+maGeometry.mfWidth, maGeometry.mfY+maGeometry.mfHeight);
 }
 
 PropertyMap DiaObject::import(const uno::Reference<xml::dom::XElement> &rxElem, DiaImporter &rImporter)
@@ -1153,7 +1436,90 @@ PropertyMap DiaObject::import(const uno::Reference<xml::dom::XElement> &rxElem,
 
 void DiaObject::writeText(uno::Reference<xml::sax::XDocumentHandler> &rDocHandler) const
 {
-    ::writeText(rDocHandler, maTextProps, msString);
+    ::writeText(rDocHandler, maTextProps, maLayout.maLines);
+}
+
+void DiaObject::collectText(TextLayouter &rLayouter)
+{
+    maLayout.maLines.clear();
+    sal_Int32 nIndex=0;
+    do
+    {
+        maLayout.maLines.push_back(msString.getToken(0, '\n', nIndex));
+    }
+    while ( nIndex >= 0 );
+
+    PropertyMap::const_iterator aI = maTextProps.find("text:style-name");
+    if (aI != maTextProps.end() && aI->second.getLength())
+        rLayouter.addLines(*this, aI->second, maLayout.maLines);
+}
+
+void DiaObject::applyTextLayout(const TextLayouter &rLayouter, const rtl::OUString &rStyleName)
+{
+    maLayout.mfWidth = 0.0;
+    std::vector< rtl::OUString >::const_iterator aEnd = maLayout.maLines.end();
+    for (std::vector< rtl::OUString >::const_iterator aI = maLayout.maLines.begin(); aI != aEnd; ++aI)
+    {
+        double fSpanWidth = rLayouter.getStringWidth(rStyleName, *aI);
+        if (fSpanWidth > maLayout.mfWidth)
+            maLayout.mfWidth = fSpanWidth;
+    }
+
+    maLayout.mbMeasured = rLayouter.hasStyle(rStyleName);
+    const FontMetric &rMetric = rLayouter.getFontMetric(rStyleName);
+    maLayout.mfLineHeight = (rMetric.mfAscent + rMetric.mfLeading + rMetric.mfDescent) / 72.0 * 2.54;
+    maLayout.mfAscent = (rMetric.mfAscent + rMetric.mfLeading) / 72.0 * 2.54;
+}
+
+const TextLayouter::StyleLines TextLayouter::maEmpty;
+
+void TextLayouter::addLines(DiaObject &rObject, const rtl::OUString &rStyleName,
+    const std::vector< rtl::OUString > &rLines)
+{
+    StyleLines &rStyleLines = maStyles[rStyleName];
+    std::vector< rtl::OUString >::const_iterator aEnd = rLines.end();
+    for (std::vector< rtl::OUString >::const_iterator aI = rLines.begin(); aI != aEnd; ++aI)
+    {
+        if (rStyleLines.maIndex.insert(lineindex::value_type(*aI, rStyleLines.maLines.size())).second)
+            rStyleLines.maLines.push_back(*aI);
+    }
+    maObjects.push_back(std::make_pair(&rObject, rStyleName));
+}
+
+void TextLayouter::measure(const TextStyleManager &rTextStyleManager)
+{
+    stylelines::iterator aEnd = maStyles.end();
+    for (stylelines::iterator aI = maStyles.begin(); aI != aEnd; ++aI)
+    {
+        StyleLines &rStyleLines = aI->second;
+        if (const PropertyMap *pStyle = rTextStyleManager.getStyleByName(aI->first))
+        {
+            rStyleLines.mbFound = true;
+            rStyleLines.maMetric = rTextStyleManager.getFontMetric(*pStyle);
+            rTextStyleManager.getStringWidths(*pStyle, rStyleLines.maLines, rStyleLines.maWidths);
+        }
+        else
+            rStyleLines.maWidths.assign(rStyleLines.maLines.size(), 0.0);
+    }
+
+    std::vector< std::pair< DiaObject*, rtl::OUString > >::const_iterator aObjEnd = maObjects.end();
+    for (std::vector< std::pair< DiaObject*, rtl::OUString > >::const_iterator aI = maObjects.begin(); aI != aObjEnd; ++aI)
+        aI->first->applyTextLayout(*this, aI->second);
+}
+
+const TextLayouter::StyleLines &TextLayouter::getStyleLines(const rtl::OUString &rStyleName) const
+{
+    stylelines::const_iterator aI = maStyles.find(rStyleName);
+    return aI != maStyles.end() ? aI->second : maEmpty;
+}
+
+double TextLayouter::getStringWidth(const rtl::OUString &rStyleName, const rtl::OUString &rLine) const
+{
+    const StyleLines &rStyleLines = getStyleLines(rStyleName);
+    lineindex::const_iterator aI = rStyleLines.maIndex.find(rLine);
+    if (aI == rStyleLines.maIndex.end() || aI->second >= rStyleLines.maWidths.size())
+        return 0.0;
+    return rStyleLines.maWidths[aI->second];
 }
 
 void DiaObject::writeConnectionPoints(uno::Reference < xml::sax::XDocumentHandler >& rxDocHandler) const
@@ -1170,9 +1536,9 @@ void DiaObject::writeConnectionPoints(uno::Reference < xml::sax::XDocumentHandle
         std::vector< ConnectionPoint >::const_iterator aEnd = maConnectionPoints.end();
         for (std::vector< ConnectionPoint >::const_iterator aI = maConnectionPoints.begin(); aI != aEnd; ++aI)
         {
-            aProps[USTR("svg:x")] = rtl::OUString::number(aI->mx) + USTR("cm");
-            aProps[USTR("svg:y")] = rtl::OUString::number(aI->my) + USTR("cm");
-            aProps[USTR("draw:id")] = rtl::OUString::number(id++);
+            aProps["svg:x"] = formatNumber(aI->mx, "cm");
+            aProps["svg:y"] = formatNumber(aI->my, "cm");
+            aProps["draw:id"] = rtl::OUString::number(id++);
 
 #ifdef DEBUG
             PropertyMap::const_iterator aEnd = aProps.end();
@@ -1204,7 +1570,7 @@ void DiaObject::write(uno::Reference<xml::sax::XDocumentHandler> &rDocHandler, c
     }
 #endif
 
-    rDocHandler->startElement(outputtype(), new SaxAttrList(rProps));
+    rDocHandler->startElement(outputtype(), makeXAttribute(rProps));
 
     writeConnectionPoints(rDocHandler);
 
@@ -1214,62 +1580,23 @@ void DiaObject::write(uno::Reference<xml::sax::XDocumentHandler> &rDocHandler, c
     rDocHandler->endElement(outputtype());
 }
 
-void DiaObject::resizeIfNarrow(PropertyMap &rProps, const DiaImporter &rImporter)
+void DiaObject::resizeIfNarrow(PropertyMap &, const DiaImporter &)
 {
-    PropertyMap::const_iterator aI;
-
-    float fStrokeWidth = 0.1;
-    float fWidth = 0;
-
-    aI = rProps.find(USTR("svg:width"));
-    if (aI != rProps.end())
-        fWidth = ::comphelper::string::searchAndReplaceAllAsciiWithAscii(aI->second, "cm", "").toFloat();
-
-    fWidth = mnWidth;
-
-    rtl::OUString sDrawStyleName;
-    aI = rProps.find(USTR("draw:style-name"));
-    if (aI != rProps.end())
-        sDrawStyleName = aI->second;
-
-    if (sDrawStyleName.getLength())
-    {
-        const GraphicStyleManager &rGraphicStyleManager = rImporter.getGraphicStyleManager();
-        if (const PropertyMap *pStyle = rGraphicStyleManager.getStyleByName(sDrawStyleName))
-        {
-            aI = pStyle->find(USTR("svg:stroke-width"));
-            if (aI != pStyle->end())
-                fStrokeWidth = ::comphelper::string::searchAndReplaceAllAsciiWithAscii(aI->second, "cm", "").toFloat();
-        }
-    }
-
     rtl::OUString sTextStyleName;
-    aI = maTextProps.find(USTR("text:style-name"));
+    PropertyMap::const_iterator aI = maTextProps.find("text:style-name");
     if (aI != maTextProps.end())
         sTextStyleName = aI->second;
     if (sTextStyleName.getLength())
     {
-        const TextStyleManager &rTextStyleManager = rImporter.getTextStyleManager();
-        float fTextWidth = 0.0;
-
-        sal_Int32 nIndex=0;
-        do
-        {
-            rtl::OUString sSpan = msString.getToken(0, '\n', nIndex);
-            float fSpanWidth = rTextStyleManager.getStringWidth(sTextStyleName, sSpan);
-            if (fSpanWidth > fTextWidth)
-             fTextWidth = fSpanWidth;
-        }
-        while ( nIndex >= 0 );
+        double fTextWidth = maLayout.mfWidth;
 
-        float fCalcWidth = mnPadding * 2 + fStrokeWidth * 2 + fTextWidth;
-        if (fCalcWidth > fWidth)
+        double fCalcWidth = maGeometry.mfPadding * 2 + maGeometry.mfStrokeWidth * 2 + fTextWidth;
+        if (fCalcWidth > maGeometry.mfWidth)
         {
-            float fDiff = (fCalcWidth - fWidth) / 2;
-            rProps[USTR("svg:width")] = rtl::OUString::number(fCalcWidth)+USTR("cm");
-            mnWidth = fCalcWidth;
-            mnX-=fDiff;
-            rProps[USTR("svg:x")] = rtl::OUString::number(mnX)+USTR("cm");
+            double fDiff = (fCalcWidth - maGeometry.mfWidth) / 2;
+            maGeometry.mfWidth = fCalcWidth;
+            maGeometry.mfX-=fDiff;
+            maGeometry.mbHasWidth = maGeometry.mbHasPosition = true;
         }
     }
 }
@@ -1296,11 +1623,11 @@ void DiaObject::handleObjectConnection(const uno::Reference<xml::dom::XElement>
             switch (nHandle)
             {
                 case 0:
-                    rAttrs[USTR("draw:start-shape")]=sValue;
+                    rAttrs["draw:start-shape"]=sValue;
                     break;
                 case 1:
                 default: //e.g. bezier curves
-                    rAttrs[USTR("draw:end-shape")]=sValue;
+                    rAttrs["draw:end-shape"]=sValue;
                     break;
             }
         }
@@ -1309,10 +1636,10 @@ void DiaObject::handleObjectConnection(const uno::Reference<xml::dom::XElement>
             switch (nHandle)
             {
                 case 0:
-                    rAttrs[USTR("draw:start-glue-point")]=rtl::OUString::number(sValue.toInt32()+4);
+                    rAttrs["draw:start-glue-point"]=rtl::OUString::number(sValue.toInt32()+4);
                     break;
                 case 1:
-                    rAttrs[USTR("draw:end-glue-point")]=rtl::OUString::number(sValue.toInt32()+4);
+                    rAttrs["draw:end-glue-point"]=rtl::OUString::number(sValue.toInt32()+4);
                     break;
             }
         }
@@ -1352,11 +1679,11 @@ void DiaObject::setdefaultpadding(const uno::Reference<xml::dom::XElement> &rxEl
         switch (xNode->getNodeValue().toInt32())
         {
             case 0:
-                mnPadding = 0.353553;
+                maGeometry.mfPadding = 0.353553;
                 break;
             case 1:
             default:
-                mnPadding = 0.10;
+                maGeometry.mfPadding = 0.10;
                 break;
         }
     }
@@ -1371,7 +1698,7 @@ PropertyMap DiaObject::handleStandardObject(const uno::Reference<xml::dom::XElem
     uno::Reference<xml::dom::XNode> xNode(xAttributes->getNamedItem(USTR("id")));
 
     if(xNode.is())
-        aAttrs[USTR("draw:id")] = xNode->getNodeValue();
+        aAttrs["draw:id"] = xNode->getNodeValue();
     else
         fprintf(stderr, "missing id!\n");
 
@@ -1385,7 +1712,12 @@ PropertyMap DiaObject::handleStandardObject(const uno::Reference<xml::dom::XElem
         {
             uno::Reference<xml::dom::XElement> xElem(xChildren->item(i), uno::UNO_QUERY_THROW);
             if (xElem->getTagName() == USTR("attribute"))
-                handleObjectAttribute(xElem, rImporter, aAttrs, aStyleAttrs);
+            {
+                rtl::OUString sName;
+                DiaAttribute eAttr;
+                if (lookupAttribute(xElem, sName, eAttr))
+                    handleObjectAttribute(eAttr, sName, xElem, rImporter, aAttrs, aStyleAttrs);
+            }
             else if (xElem->getTagName() == USTR("connections"))
                 handleObjectConnections(xElem, rImporter, aAttrs);
             else
@@ -1398,84 +1730,80 @@ PropertyMap DiaObject::handleStandardObject(const uno::Reference<xml::dom::XElem
     {
         sal_Int32 nFlipHori = mbFlipHori ? -1 : 1;
         sal_Int32 nFlipVert = mbFlipVert ? -1 : 1;
-        float nXTrans1 = mbFlipHori ? -mnX : 0;
-        float nXTrans2 = mbFlipHori ? mnX+mnWidth : 0;
-        float nYTrans1 = mbFlipVert ? -mnY : 0;
-        float nYTrans2 = mbFlipVert ? mnY+mnHeight : 0;
-        aAttrs[USTR("draw:transform")] =
-            USTR("translate (") +
-            rtl::OUString::number(nXTrans1) + USTR("cm") +
-            USTR(" ") +
-            rtl::OUString::number(nYTrans1) + USTR("cm") +
-            USTR(") ")
-            +
-            USTR("scale (") +
-            rtl::OUString::number(nFlipHori) +
-            USTR(" ") +
-            rtl::OUString::number(nFlipVert) +
-            USTR(") ")
-            +
-            USTR("translate (") +
-            rtl::OUString::number(nXTrans2) + USTR("cm") +
-            USTR(" ") +
-            rtl::OUString::number(nYTrans2) + USTR("cm") +
-            USTR(") ");
-    }
-
-    aStyleAttrs[USTR("draw:textarea-vertical-align")] = USTR("middle");
+        double nXTrans1 = mbFlipHori ? -maGeometry.mfX : 0;
+        double nXTrans2 = mbFlipHori ? maGeometry.mfX+maGeometry.mfWidth : 0;
+        double nYTrans1 = mbFlipVert ? -maGeometry.mfY : 0;
+        double nYTrans2 = mbFlipVert ? maGeometry.mfY+maGeometry.mfHeight : 0;
+        rtl::OUStringBuffer aTransform(96);
+        aTransform.appendAscii("translate (");
+        appendNumber(aTransform, nXTrans1, "cm");
+        aTransform.append(sal_Unicode(' '));
+        appendNumber(aTransform, nYTrans1, "cm");
+        aTransform.appendAscii(") scale (");
+        aTransform.append(nFlipHori);
+        aTransform.append(sal_Unicode(' '));
+        aTransform.append(nFlipVert);
+        aTransform.appendAscii(") translate (");
+        appendNumber(aTransform, nXTrans2, "cm");
+        aTransform.append(sal_Unicode(' '));
+        appendNumber(aTransform, nYTrans2, "cm");
+        aTransform.appendAscii(") ");
+        aAttrs["draw:transform"] = aTransform.makeStringAndClear();
+    }
+
+    aStyleAttrs["draw:textarea-vertical-align"] = USTR("middle");
     if (mnTextAlign == 0)
-        aStyleAttrs[USTR("draw:textarea-horizontal-align")] = USTR("left");
+        aStyleAttrs["draw:textarea-horizontal-align"] = USTR("left");
     else if (mnTextAlign == 2)
-        aStyleAttrs[USTR("draw:textarea-horizontal-align")] = USTR("right");
-    aStyleAttrs[USTR("fo:padding-top")] = rtl::OUString::number(mnPadding) + USTR("cm");
-    aStyleAttrs[USTR("fo:padding-bottom")] = rtl::OUString::number(mnPadding) + USTR("cm");
-    aStyleAttrs[USTR("fo:padding-left")] = rtl::OUString::number(mnPadding) + USTR("cm");
-    aStyleAttrs[USTR("fo:padding-right")] = rtl::OUString::number(mnPadding) + USTR("cm");
+        aStyleAttrs["draw:textarea-horizontal-align"] = USTR("right");
+    aStyleAttrs["fo:padding-top"] = formatNumber(maGeometry.mfPadding, "cm");
+    aStyleAttrs["fo:padding-bottom"] = formatNumber(maGeometry.mfPadding, "cm");
+    aStyleAttrs["fo:padding-left"] = formatNumber(maGeometry.mfPadding, "cm");
+    aStyleAttrs["fo:padding-right"] = formatNumber(maGeometry.mfPadding, "cm");
 
     if (mbAutoWidth)
-        aStyleAttrs[USTR("draw:auto-grow-width")] = USTR("true");
+        aStyleAttrs["draw:auto-grow-width"] = USTR("true");
 
     if (!mbShowBackground)
-        aStyleAttrs[USTR("draw:fill")] = USTR("none");
+        aStyleAttrs["draw:fill"] = USTR("none");
     else
-        aStyleAttrs[USTR("draw:fill")] = USTR("solid");
+        aStyleAttrs["draw:fill"] = USTR("solid");
 
     if (!mbShowBorder)
-        aStyleAttrs[USTR("draw:stroke")] = USTR("none");
+        aStyleAttrs["draw:stroke"] = USTR("none");
     else if (mbShowBorder && mnLineStyle != 0)
         rImporter.addStrokeDash(aStyleAttrs, mnLineStyle, mnDashLength);
     else
-        aStyleAttrs[USTR("draw:stroke")] = USTR("solid");
+        aStyleAttrs["draw:stroke"] = USTR("solid");
 
     rImporter.addAutomaticGraphicStyle(aAttrs, aStyleAttrs);
 
     return aAttrs;
 }
 
-void DiaObject::handleObjectAttribute(const uno::Reference<xml::dom::XElement> &rxElem,
+void DiaObject::handleObjectAttribute(DiaAttribute eAttr, const rtl::OUString &rName,
+    const uno::Reference<xml::dom::XElement> &rxElem,
     DiaImporter &rImporter,
     PropertyMap &rAttrs,
     PropertyMap &rStyleAttrs)
 {
-    const uno::Reference<xml::dom::XNamedNodeMap> xAttributes = rxElem->getAttributes();
-    uno::Reference<xml::dom::XNode> xNode(xAttributes->getNamedItem(USTR("name")));
-    if(xNode.is())
+    switch (eAttr)
     {
-        rtl::OUString sName(xNode->getNodeValue());
-        if (sName == USTR("obj_pos"))
+        case ATTR_OBJ_POS:
         {
             rtl::OUString sObjPos = valueOfSimpleAttribute(rxElem);
-            float nX1=0, nY1=0;
+            double nX1=0, nY1=0;
             sal_Int32 c = sObjPos.indexOf(',');
             if (c != -1)
             {
-                nX1 = sObjPos.copy(0, c).toFloat();
-                nY1 = sObjPos.copy(c+1).toFloat();
+                nX1 = sObjPos.copy(0, c).toDouble();
+                nY1 = sObjPos.copy(c+1).toDouble();
             }
             mnObjPosX = rImporter.adjustX(nX1);
             mnObjPosY = rImporter.adjustY(nY1);
+            break;
         }
-        else if (sName == USTR("obj_bb"))
+        case ATTR_OBJ_BB:
         {
             rtl::OUString sVal = valueOfSimpleAttribute(rxElem);
             sal_Int32 c = sVal.indexOf(';');
@@ -1484,133 +1812,140 @@ void DiaObject::handleObjectAttribute(const uno::Reference<xml::dom::XElement> &
                 rtl::OUString sTopLeft = sVal.copy(0, c);
                 rtl::OUString sBottomRight = sVal.copy(c+1);
         
-                float nX1=0, nY1=0, nX2, nY2;
+                double nX1=0, nY1=0, nX2, nY2;
 
                 c = sTopLeft.indexOf(',');
                 if (c != -1)
                 {
-                    nX1 = sTopLeft.copy(0, c).toFloat();
-                    nY1 = sTopLeft.copy(c+1).toFloat();
+                    nX1 = sTopLeft.copy(0, c).toDouble();
+                    nY1 = sTopLeft.copy(c+1).toDouble();
                 }
 
-                mnX = rImporter.adjustX(nX1);
-                mnY = rImporter.adjustY(nY1);
-                rAttrs[USTR("svg:x")] = rtl::OUString::number(mnX)+USTR("cm");
-                rAttrs[USTR("svg:y")] = rtl::OUString::number(mnY)+USTR("cm");
+                maGeometry.mfX = rImporter.adjustX(nX1);
+                maGeometry.mfY = rImporter.adjustY(nY1);
+                maGeometry.mbHasPosition = true;
 
                 c = sBottomRight.indexOf(',');
                 if (c != -1)
                 {
-                    nX2 = sBottomRight.copy(0, c).toFloat();
-                    nY2 = sBottomRight.copy(c+1).toFloat();
-                    mnWidth = nX2-nX1;
-                    mnHeight = nY2-nY1;
-                    rAttrs[USTR("svg:width")] = rtl::OUString::number(mnWidth)+USTR("cm");
-                    rAttrs[USTR("svg:height")] = rtl::OUString::number(mnHeight)+USTR("cm");
+                    nX2 = sBottomRight.copy(0, c).toDouble();
+                    nY2 = sBottomRight.copy(c+1).toDouble();
+                    maGeometry.mfWidth = nX2-nX1;
+                    maGeometry.mfHeight = nY2-nY1;
+                    maGeometry.mbHasWidth = maGeometry.mbHasHeight = true;
                 }
             }
+            break;
         }
-        else if (sName == USTR("elem_corner"))
+        case ATTR_ELEM_CORNER:
         {
             rtl::OUString sTopLeft = valueOfSimpleAttribute(rxElem);
-            float nX1=0, nY1=0;
+            double nX1=0, nY1=0;
             sal_Int32 c = sTopLeft.indexOf(',');
             if (c != -1)
             {
-                nX1 = sTopLeft.copy(0, c).toFloat();
-                nY1 = sTopLeft.copy(c+1).toFloat();
+                nX1 = sTopLeft.copy(0, c).toDouble();
+                nY1 = sTopLeft.copy(c+1).toDouble();
             }
-            mnX = rImporter.adjustX(nX1);
-            mnY = rImporter.adjustY(nY1);
-            rAttrs[USTR("svg:x")] = rtl::OUString::number(mnX)+USTR("cm");
-            rAttrs[USTR("svg:y")] = rtl::OUString::number(mnY)+USTR("cm");
-        }
-        else if (sName == USTR("elem_width"))
-        {
-            mnWidth = valueOfSimpleAttribute(rxElem).toFloat();
-            rAttrs[USTR("svg:width")] = rtl::OUString::number(mnWidth)+USTR("cm");
-        }
-        else if (sName == USTR("elem_height"))
-        {
-            mnHeight = valueOfSimpleAttribute(rxElem).toFloat();
-            rAttrs[USTR("svg:height")] = rtl::OUString::number(mnHeight)+USTR("cm");
-        }
-        else if (sName == USTR("border_width"))
-            rStyleAttrs[USTR("svg:stroke-width")] = valueOfSimpleAttribute(rxElem)+USTR("cm");
-        else if (sName == USTR("line_width"))
-            rStyleAttrs[USTR("svg:stroke-width")] = valueOfSimpleAttribute(rxElem)+USTR("cm");
-        else if (sName == USTR("border_color"))
-            rStyleAttrs[USTR("svg:stroke-color")] = valueOfSimpleAttribute(rxElem);
-        else if (sName == USTR("line_color") || sName == USTR("line_colour"))
-            rStyleAttrs[USTR("svg:stroke-color")] = valueOfSimpleAttribute(rxElem);
-        else if (sName == USTR("inner_color"))
-            rStyleAttrs[USTR("draw:fill-color")] = valueOfSimpleAttribute(rxElem);
-        else if (sName == USTR("fill_color") || sName == USTR("fill_colour"))
-            rStyleAttrs[USTR("draw:fill-color")] = valueOfSimpleAttribute(rxElem);
-        else if (sName == USTR("show_background"))
+            maGeometry.mfX = rImporter.adjustX(nX1);
+            maGeometry.mfY = rImporter.adjustY(nY1);
+            maGeometry.mbHasPosition = true;
+            break;
+        }
+        case ATTR_ELEM_WIDTH:
+            maGeometry.mfWidth = valueOfSimpleAttribute(rxElem).toDouble();
+            maGeometry.mbHasWidth = true;
+            break;
+        case ATTR_ELEM_HEIGHT:
+            maGeometry.mfHeight = valueOfSimpleAttribute(rxElem).toDouble();
+            maGeometry.mbHasHeight = true;
+            break;
+        case ATTR_BORDER_WIDTH:
+        case ATTR_LINE_WIDTH:
+            maGeometry.mfStrokeWidth = valueOfSimpleAttribute(rxElem).toDouble();
+            rStyleAttrs["svg:stroke-width"] = formatNumber(maGeometry.mfStrokeWidth, "cm");
+            break;
+        case ATTR_BORDER_COLOR:
+        case ATTR_LINE_COLOR:
+            rStyleAttrs["svg:stroke-color"] = valueOfSimpleAttribute(rxElem);
+            break;
+        case ATTR_INNER_COLOR:
+        case ATTR_FILL_COLOR:
+            rStyleAttrs["draw:fill-color"] = valueOfSimpleAttribute(rxElem);
+            break;
+        case ATTR_SHOW_BACKGROUND:
             mbShowBackground = valueOfSimpleAttribute(rxElem) == USTR("true");
-        else if (sName == USTR("line_style"))
+            break;
+        case ATTR_LINE_STYLE:
             mnLineStyle = valueOfSimpleAttribute(rxElem).toInt32();
-        else if (sName == USTR("dashlength"))
+            break;
+        case ATTR_DASHLENGTH:
             mnDashLength = valueOfSimpleAttribute(rxElem).toFloat();
-        else if (sName == USTR("corner_radius"))
-            rAttrs[USTR("draw:corner-radius")] = valueOfSimpleAttribute(rxElem)+USTR("cm");
-        else if (sName == USTR("aspect"))
-            /*IgnoreThis*/;
-        else if (sName == USTR("poly_points"))
-            rAttrs[USTR("draw:points")] = valueOfSimpleAttribute(rxElem).trim();
-        else if (sName == USTR("orth_points"))
-            rAttrs[USTR("draw:points")] = valueOfSimpleAttribute(rxElem).trim();
-        else if (sName == USTR("bez_points"))
-            rAttrs[USTR("draw:points")] = valueOfSimpleAttribute(rxElem).trim();
-        else if (sName == USTR("orth_orient"))
-            /*IgnoreThis*/;
-        else if (sName == USTR("keep_aspect"))
-            /*IgnoreThis*/;
-        else if (sName == USTR("conn_endpoints"))
+            break;
+        case ATTR_CORNER_RADIUS:
+            rAttrs["draw:corner-radius"] = formatNumber(valueOfSimpleAttribute(rxElem).toDouble(), "cm");
+            break;
+        case ATTR_POLY_POINTS:
+        case ATTR_ORTH_POINTS:
+        case ATTR_BEZ_POINTS:
+            maPoints.clear();
+            parsePoints(valueOfSimpleAttribute(rxElem), maPoints);
+            break;
+        case ATTR_CONN_ENDPOINTS:
             createPoints(rAttrs, valueOfSimpleAttribute(rxElem), rImporter);
-        else if (sName == USTR("draw_border"))
+            break;
+        case ATTR_DRAW_BORDER:
             mbShowBorder = valueOfSimpleAttribute(rxElem) == USTR("true");
-        else if (sName == USTR("subscale"))
-            /*IgnoreThis*/;
-        else if (sName == USTR("flip_horizontal"))
+            break;
+        case ATTR_FLIP_HORIZONTAL:
             mbFlipHori = valueOfSimpleAttribute(rxElem) == USTR("true");
-        else if (sName == USTR("flip_vertical"))
+            break;
+        case ATTR_FLIP_VERTICAL:
             mbFlipVert = valueOfSimpleAttribute(rxElem) == USTR("true");
-        else if (sName == USTR("text"))
+            break;
+        case ATTR_TEXT:
             handleObjectText(rxElem, rImporter);
-        else if (sName == USTR("padding"))
-            mnPadding = valueOfSimpleAttribute(rxElem).toFloat();
-        else if (sName == USTR("start_arrow"))
+            break;
+        case ATTR_PADDING:
+            maGeometry.mfPadding = valueOfSimpleAttribute(rxElem).toDouble();
+            break;
+        case ATTR_START_ARROW:
         {
             sal_Int32 nArrow = valueOfSimpleAttribute(rxElem).toInt32();
             if (nArrow)
-                rStyleAttrs[USTR("draw:marker-start")] = GetArrowName(nArrow);
+                rStyleAttrs["draw:marker-start"] = GetArrowName(nArrow);
+            break;
         }
-        else if (sName == USTR("start_arrow_width"))
-            rStyleAttrs[USTR("draw:marker-start-width")] = valueOfSimpleAttribute(rxElem)+USTR("cm");
-        else if (sName == USTR("end_arrow"))
+        case ATTR_START_ARROW_WIDTH:
+            rStyleAttrs["draw:marker-start-width"] = formatNumber(valueOfSimpleAttribute(rxElem).toDouble(), "cm");
+            break;
+        case ATTR_END_ARROW:
         {
             sal_Int32 nArrow = valueOfSimpleAttribute(rxElem).toInt32();
             if (nArrow)
-                rStyleAttrs[USTR("draw:marker-end")] = GetArrowName(nArrow);
-        }
-        else if (sName == USTR("end_arrow_width"))
-            rStyleAttrs[USTR("draw:marker-end-width")] = valueOfSimpleAttribute(rxElem)+USTR("cm");
-        else if (sName == USTR("valign")) /*don't think this really matters if we take the obj_pos*/
-             /*IgnoreThis*/;
-        else if (sName == USTR("meta"))
-             /*IgnoreThis*/;
-        else if (sName == USTR("numcp"))
-             /*ToDo*/;
-        else if (sName == USTR("start_arrow_length"))
-             /*ToDo*/;
-        else if (sName == USTR("end_arrow_length"))
-             /*ToDo*/;
-        else if (sName == USTR("corner_types"))
-             /*ToDo*/;
-        else
-            fprintf(stderr, "Unknown Object Attribute %s\n", rtl::OUStringToOString(sName, RTL_TEXTENCODING_UTF8).getStr());
+                rStyleAttrs["draw:marker-end"] = GetArrowName(nArrow);
+            break;
+        }
+        case ATTR_END_ARROW_WIDTH:
+            rStyleAttrs["draw:marker-end-width"] = formatNumber(valueOfSimpleAttribute(rxElem).toDouble(), "cm");
+            break;
+        case ATTR_ASPECT:
+        case ATTR_ORTH_ORIENT:
+        case ATTR_KEEP_ASPECT:
+        case ATTR_SUBSCALE:
+        case ATTR_VALIGN: /*don't think this really matters if we take the obj_pos*/
+        case ATTR_META:
+             /*IgnoreThis*/
+            break;
+        case ATTR_NUMCP:
+        case ATTR_START_ARROW_LENGTH:
+        case ATTR_END_ARROW_LENGTH:
+        case ATTR_CORNER_TYPES:
+             /*ToDo*/
+            break;
+        default:
+            fprintf(stderr, "Unknown Object Attribute %s\n", rtl::OUStringToOString(rName, RTL_TEXTENCODING_UTF8).getStr());
+            break;
     }
 }
 
@@ -1632,22 +1967,22 @@ void handleObjectTextFont(const uno::Reference<xml::dom::XElement> rxElem, Prope
                     uno::Reference<xml::dom::XNode> xNode(xAttributes->item(j));
                     rtl::OUString sName = xNode->getNodeName();
                     if (sName == USTR("family"))
-                        rAttrs[USTR("fo:font-family")] = xNode->getNodeValue();
+                        rAttrs["fo:font-family"] = xNode->getNodeValue();
                     else if (sName == USTR("name"))
                         /*IgnoreMe*/;
                     else if (sName == USTR("style"))
                     {
                         rtl::OUString sStyle = xNode->getNodeValue();
                         if (sStyle == USTR("0"))
-                            rAttrs[USTR("fo:font-style")] = USTR("normal");
+                            rAttrs["fo:font-style"] = USTR("normal");
                         else if (sStyle == USTR("8"))
-                            rAttrs[USTR("fo:font-style")] = USTR("italic");
+                            rAttrs["fo:font-style"] = USTR("italic");
                         else if (sStyle == USTR("80"))
-                            rAttrs[USTR("fo:font-weight")] = USTR("bold");
+                            rAttrs["fo:font-weight"] = USTR("bold");
                         else if (sStyle == USTR("88"))
                         {
-                            rAttrs[USTR("fo:font-style")] = USTR("italic");
-                            rAttrs[USTR("fo:font-weight")] = USTR("bold");
+                            rAttrs["fo:font-style"] = USTR("italic");
+                            rAttrs["fo:font-weight"] = USTR("bold");
                         }
                         else
                             fprintf(stderr, "unknown text style %s\n", rtl::OUStringToOString(sStyle, RTL_TEXTENCODING_UTF8).getStr());
@@ -1664,23 +1999,29 @@ void handleObjectTextFont(const uno::Reference<xml::dom::XElement> rxElem, Prope
 
 void DiaObject::handleObjectTextAttribute(const uno::Reference<xml::dom::XElement> &rElem, DiaImporter &rImporter, ParaTextStyle &rStyleProps)
 {
-    const uno::Reference<xml::dom::XNamedNodeMap> xAttributes = rElem->getAttributes();
-    uno::Reference<xml::dom::XNode> xNode(xAttributes->getNamedItem(USTR("name")));
-    if(xNode.is())
+    rtl::OUString sName;
+    DiaAttribute eAttr;
+    if (!lookupAttribute(rElem, sName, eAttr))
+        return;
+
+    switch (eAttr)
     {
-        rtl::OUString sName(xNode->getNodeValue());
-        if (sName == USTR("string"))
+        case ATTR_STRING:
             msString = deHashString(valueOfSimpleAttribute(rElem));
-        else if (sName == USTR("color"))
-            rStyleProps.maTextAttrs[USTR("fo:color")] = valueOfSimpleAttribute(rElem);
-        else if (sName == USTR("font"))
+            break;
+        case ATTR_COLOR:
+            rStyleProps.maTextAttrs["fo:color"] = valueOfSimpleAttribute(rElem);
+            break;
+        case ATTR_FONT:
             handleObjectTextFont(rElem, rStyleProps.maTextAttrs);
-        else if (sName == USTR("height"))
+            break;
+        case ATTR_HEIGHT:
         {
             float nHeight = valueOfSimpleAttribute(rElem).toFloat();
-            rStyleProps.maTextAttrs[USTR("fo:font-size")] = rtl::OUString::number(nHeight * 72 / 2.54) + USTR("pt");
+            rStyleProps.maTextAttrs["fo:font-size"] = formatNumber(nHeight * 72 / 2.54, "pt");
+            break;
         }
-        else if (sName == USTR("pos"))
+        case ATTR_POS:
         {
             rtl::OUString sTopLeft = valueOfSimpleAttribute(rElem);
             sal_Int32 c = sTopLeft.indexOf(',');
@@ -1691,28 +2032,27 @@ void DiaObject::handleObjectTextAttribute(const uno::Reference<xml::dom::XElemen
             }
             mnTextX = rImporter.adjustX(mnTextX);
             mnTextY = rImporter.adjustY(mnTextY);
+            break;
         }
-        else if (sName == USTR("alignment"))
-        {
+        case ATTR_ALIGNMENT:
             switch (valueOfSimpleAttribute(rElem).toInt32())
             {
                 default:
                     mnTextAlign = 0;
                     break;
                 case 1:
-                    rStyleProps.maParaAttrs[USTR("fo:text-align")] = USTR("center");
+                    rStyleProps.maParaAttrs["fo:text-align"] = USTR("center");
                     mnTextAlign = 1;
                     break;
                 case 2:
-                    rStyleProps.maParaAttrs[USTR("fo:text-align")] = USTR("end");
+                    rStyleProps.maParaAttrs["fo:text-align"] = USTR("end");
                     mnTextAlign = 2;
                     break;
             }
-        }
-        else
-        {
+            break;
+        default:
             fprintf(stderr, "Unknown Text Attribute %s\n", rtl::OUStringToOString(sName, RTL_TEXTENCODING_UTF8).getStr());
-        }
+            break;
     }
 }
 
@@ -1774,10 +2114,10 @@ void DiaObject::snapConnectionPoint(sal_Int32 nConnection, basegfx::B2DPoint &rP
     nConnection-=4;
     if (static_cast<size_t>(nConnection) < maConnectionPoints.size())
     {
-        float nCenterX = mnX + mnWidth/2;
-        float nCenterY = mnY + mnHeight/2;
-        float nX = nCenterX + (maConnectionPoints[nConnection].mx * mnWidth / 10);
-        float nY = nCenterY + (maConnectionPoints[nConnection].my * mnHeight / 10);
+        double nCenterX = maGeometry.mfX + maGeometry.mfWidth/2;
+        double nCenterY = maGeometry.mfY + maGeometry.mfHeight/2;
+        double nX = nCenterX + (maConnectionPoints[nConnection].mx * maGeometry.mfWidth / 10);
+        double nY = nCenterY + (maConnectionPoints[nConnection].my * maGeometry.mfHeight / 10);
 
         rPoint.setX(rImporter.unadjustX(nX));
         rPoint.setY(rImporter.unadjustY(nY));
@@ -1846,7 +2186,7 @@ public:
 PropertyMap StandardLineObject::import(const uno::Reference<xml::dom::XElement> &rxElem, DiaImporter &rImporter)
 {
     PropertyMap aProps = DiaObject::import(rxElem, rImporter);
-    aProps[USTR("draw:type")] = USTR("line");
+    aProps["draw:type"] = USTR("line");
     return aProps;
 }
 
@@ -1861,20 +2201,24 @@ class StandardArcObject : public DiaObject
 public:
     virtual rtl::OUString outputtype() const { return USTR("draw:circle"); }
     virtual PropertyMap import(const uno::Reference<xml::dom::XElement> &rxElem, DiaImporter &rImporter);
-    virtual void handleObjectAttribute(const uno::Reference<xml::dom::XElement> &rxElem,
+    virtual void handleObjectAttribute(DiaAttribute eAttr, const rtl::OUString &rName,
+        const uno::Reference<xml::dom::XElement> &rxElem,
         DiaImporter &rImporter, PropertyMap &rAttrs, PropertyMap &rStyleAttrs);
 };
 
 class ZigZagLineObject : public DiaObject
 {
     bool mbAutoRoute;
-    void confirmZigZag(PropertyMap &rProps, const DiaImporter &rImporter) const;
-    void rejectZigZag(PropertyMap &rProps, const DiaImporter &rImporter) const;
+    void confirmZigZag(PropertyMap &rProps, const std::vector< basegfx::B2DPoint > &rPoints,
+        const DiaImporter &rImporter) const;
+    void rejectZigZag(PropertyMap &rProps, const std::vector< basegfx::B2DPoint > &rPoints,
+        const DiaImporter &rImporter) const;
 public:
     ZigZagLineObject() : mbAutoRoute(false) {}
     virtual rtl::OUString outputtype() const { return USTR("draw:connector"); }
     virtual void write(uno::Reference<xml::sax::XDocumentHandler> &rDocHandler, const PropertyMap &rProps, const DiaImporter &rImporter) const;
-    virtual void handleObjectAttribute(const uno::Reference<xml::dom::XElement> &rxElem,
+    virtual void handleObjectAttribute(DiaAttribute eAttr, const rtl::OUString &rName,
+        const uno::Reference<xml::dom::XElement> &rxElem,
         DiaImporter &rImporter, PropertyMap &rAttrs, PropertyMap &rStyleAttrs);
     virtual void adjustConnectionPoints(PropertyMap &rProps, const DiaImporter &rImporter);
 };
@@ -1908,7 +2252,8 @@ public:
     StandardImageObject();
     virtual rtl::OUString outputtype() const { return USTR("draw:frame"); }
     virtual void write(uno::Reference<xml::sax::XDocumentHandler> &rDocHandler, const PropertyMap &rProps, const DiaImporter &rImporter) const;
-    virtual void handleObjectAttribute(const uno::Reference<xml::dom::XElement> &rxElem,
+    virtual void handleObjectAttribute(DiaAttribute eAttr, const rtl::OUString &rName,
+        const uno::Reference<xml::dom::XElement> &rxElem,
         DiaImporter &rImporter, PropertyMap &rAttrs, PropertyMap &rStyleAttrs);
 };
 
@@ -1920,6 +2265,7 @@ public:
     virtual void write(uno::Reference<xml::sax::XDocumentHandler> &rDocHandler, const PropertyMap &rProps, const DiaImporter &rImporter) const;
     virtual void setdefaultpadding(const uno::Reference<xml::dom::XElement> &) {}
     virtual void resizeIfNarrow(PropertyMap &, const DiaImporter &) {}
+    virtual void formatGeometry(PropertyMap &rProps);
 };
 
 StandardTextObject::StandardTextObject()
@@ -1946,8 +2292,8 @@ PropertyMap CustomObject::import(const uno::Reference<xml::dom::XElement> &rxEle
 {
     PropertyMap aProps = handleStandardObject(rxElem, rImporter);
     GraphicStyleManager &rStyleManager = rImporter.getGraphicStyleManager();
-    if (const PropertyMap *pStyle = rStyleManager.getStyleByName(aProps[USTR("draw:style-name")]))
-        maTemplate.generateStyles(rStyleManager, *pStyle, mbShowBackground);
+    if (const PropertyMap *pStyle = rStyleManager.getStyleByName(aProps["draw:style-name"]))
+        maTemplate.generateStyles(rStyleManager, *pStyle, mbShowBackground, maGeometry.mfStrokeWidth);
     return aProps;
 }
 
@@ -1964,8 +2310,8 @@ void CustomObject::write(uno::Reference<xml::sax::XDocumentHandler> &rDocHandler
     }
 #endif
 
-//    rDocHandler->startElement(outputtype(), new SaxAttrList(PropertyMap()));
-    maTemplate.convertShapes(rDocHandler, rProps, maTextProps, msString);
+//    rDocHandler->startElement(outputtype(), makeEmptyXAttribute());
+    maTemplate.convertShapes(rDocHandler, getBoundingBox(), rProps, maTextProps, maLayout.maLines);
 //    rDocHandler->endElement(outputtype());
 }
 
@@ -1982,10 +2328,10 @@ void CustomObject::snapConnectionPoint(sal_Int32 nConnection, basegfx::B2DPoint
     basegfx::B2DPoint aConnectionPoint;
     if (maTemplate.getConnectionPoint(nConnection, aConnectionPoint))
     {
-        float nCenterX = mnX + mnWidth/2;
-        float nCenterY = mnY + mnHeight/2;
-        float nX = nCenterX + (aConnectionPoint.getX() * mnWidth / 10);
-        float nY = nCenterY + (aConnectionPoint.getY() * mnHeight / 10);
+        double nCenterX = maGeometry.mfX + maGeometry.mfWidth/2;
+        double nCenterY = maGeometry.mfY + maGeometry.mfHeight/2;
+        double nX = nCenterX + (aConnectionPoint.getX() * maGeometry.mfWidth / 10);
+        double nY = nCenterY + (aConnectionPoint.getY() * maGeometry.mfHeight / 10);
 
         rPoint.setX(rImporter.unadjustX(nX));
         rPoint.setY(rImporter.unadjustY(nY));
@@ -1994,82 +2340,64 @@ void CustomObject::snapConnectionPoint(sal_Int32 nConnection, basegfx::B2DPoint
 
 StandardImageObject::StandardImageObject()
 {
-    maImageProps[USTR("xlink:type")] = USTR("simple");
-    maImageProps[USTR("xlink:show")] = USTR("embed");
-    maImageProps[USTR("xlink:actuate")] = USTR("onLoad");
+    maImageProps["xlink:type"] = USTR("simple");
+    maImageProps["xlink:show"] = USTR("embed");
+    maImageProps["xlink:actuate"] = USTR("onLoad");
     mbShowBorder = false;
     mbShowBackground = false;
 }
 
-void StandardImageObject::handleObjectAttribute(const uno::Reference<xml::dom::XElement> &rxElem,
+void StandardImageObject::handleObjectAttribute(DiaAttribute eAttr, const rtl::OUString &rName,
+    const uno::Reference<xml::dom::XElement> &rxElem,
     DiaImporter &rImporter,
     PropertyMap &rAttrs,
     PropertyMap &rStyleAttrs)
 {
-    const uno::Reference<xml::dom::XNamedNodeMap> xAttributes = rxElem->getAttributes();
-    uno::Reference<xml::dom::XNode> xNode(xAttributes->getNamedItem(USTR("name")));
-    if(xNode.is())
+    switch (eAttr)
     {
-        rtl::OUString sName(xNode->getNodeValue());
-        if (sName == USTR("file"))
+        case ATTR_FILE:
         {
             rtl::OUString sHomeURL, sFileURL, sSystemPath;
             osl::Security aSecurity;
             aSecurity.getHomeDir(sHomeURL);
             sSystemPath = deHashString(valueOfSimpleAttribute(rxElem));
             osl::File::getAbsoluteFileURL(sHomeURL, sSystemPath, sFileURL);
-            maImageProps[USTR("xlink:href")] = sFileURL;
+            maImageProps["xlink:href"] = sFileURL;
+            break;
         }
-        else
-            DiaObject::handleObjectAttribute(rxElem, rImporter, rAttrs, rStyleAttrs);
+        default:
+            DiaObject::handleObjectAttribute(eAttr, rName, rxElem, rImporter, rAttrs, rStyleAttrs);
+            break;
     }
 }
 
 void StandardImageObject::write(uno::Reference<xml::sax::XDocumentHandler> &rDocHandler, const PropertyMap &rProps, const DiaImporter &) const
 {
-    rDocHandler->startElement(outputtype(), new SaxAttrList(rProps));
-    rDocHandler->startElement(USTR("draw:image"), new SaxAttrList(maImageProps));
+    rDocHandler->startElement(outputtype(), makeXAttribute(rProps));
+    rDocHandler->startElement(USTR("draw:image"), makeXAttribute(maImageProps));
     rDocHandler->endElement(USTR("draw:image"));
     rDocHandler->endElement(outputtype());
 }
 
-void StandardTextObject::write(uno::Reference<xml::sax::XDocumentHandler> &rDocHandler, const PropertyMap &rProps, const DiaImporter &rImporter) const
+//Fit the frame around the measured text, hanging it from the baseline
+//that obj_pos gives
+void StandardTextObject::formatGeometry(PropertyMap &rProps)
 {
-    PropertyMap aProps(rProps);
-
-    rtl::OUString sTextStyleName;
-    PropertyMap::const_iterator aI = maTextProps.find(USTR("text:style-name"));
-    if (aI != maTextProps.end())
-        sTextStyleName = aI->second;
-    if (sTextStyleName.getLength())
+    Geometry aFrame(maGeometry);
+    if (maLayout.mbMeasured)
     {
-        const TextStyleManager &rTextStyleManager = rImporter.getTextStyleManager();
-
-        if (const PropertyMap *pStyle = rTextStyleManager.getStyleByName(sTextStyleName))
-        {
-            uno::Reference< awt::XFont > xFont = rTextStyleManager.getMatchingFont(*pStyle);
-            awt::SimpleFontMetric aMetric = xFont->getFontMetric();
-
-            float fHeight = (aMetric.Ascent + aMetric.Leading + aMetric.Descent) / 72.0 * 2.54;
-            int nCount=1;
-            sal_Int32 nIndex=0;
-            do
-            {
-                msString.getToken(0, '\n', nIndex);
-                ++nCount;
-            }
-            while ( nIndex >= 0 );
-            fHeight *= (nCount-1);
-            aProps[USTR("svg:height")] = rtl::OUString::number(fHeight + 0.2) + USTR("cm");
-
-            float fDiff = (aMetric.Ascent + aMetric.Leading) / 72.0 * 2.54;
-            aProps[USTR("svg:y")] = rtl::OUString::number(mnObjPosY - fDiff) + USTR("cm");
-        }
+        aFrame.mfHeight = maLayout.mfLineHeight * maLayout.maLines.size() + 0.2;
+        aFrame.mfY = mnObjPosY - maLayout.mfAscent;
+        aFrame.mbHasHeight = true;
     }
+    aFrame.format(rProps);
+}
 
+void StandardTextObject::write(uno::Reference<xml::sax::XDocumentHandler> &rDocHandler, const PropertyMap &rProps, const DiaImporter &) const
+{
 #ifdef DEBUG
-    PropertyMap::const_iterator aEnd = aProps.end();
-    for (PropertyMap::const_iterator aI = aProps.begin(); aI != aEnd; ++aI)
+    PropertyMap::const_iterator aEnd = rProps.end();
+    for (PropertyMap::const_iterator aI = rProps.begin(); aI != aEnd; ++aI)
     {
         fprintf(stderr, "textobject writing prop %s %s\n",
             rtl::OUStringToOString(aI->first, RTL_TEXTENCODING_UTF8).getStr(),
@@ -2078,8 +2406,8 @@ void StandardTextObject::write(uno::Reference<xml::sax::XDocumentHandler> &rDocH
     }
 #endif
 
-    rDocHandler->startElement(outputtype(), new SaxAttrList(aProps));
-    rDocHandler->startElement(USTR("draw:text-box"), new SaxAttrList(PropertyMap()));
+    rDocHandler->startElement(outputtype(), makeXAttribute(rProps));
+    rDocHandler->startElement(USTR("draw:text-box"), makeEmptyXAttribute());
 
     writeText(rDocHandler);
 
@@ -2090,23 +2418,23 @@ void StandardTextObject::write(uno::Reference<xml::sax::XDocumentHandler> &rDocH
 PropertyMap StandardBezierLineObject::import(const uno::Reference<xml::dom::XElement> &rxElem, DiaImporter &rImporter)
 {
     PropertyMap aProps = DiaObject::import(rxElem, rImporter);
-    createViewportFromRect(aProps);
-    makeCurvedPathFromPoints(aProps, false);
+    createViewportFromRect(aProps, getBoundingBox());
+    makeCurvedPathFromPoints(aProps, maPoints, false);
     return aProps;
 }
 
 PropertyMap StandardBeziergonObject::import(const uno::Reference<xml::dom::XElement> &rxElem, DiaImporter &rImporter)
 {
     PropertyMap aProps = DiaObject::import(rxElem, rImporter);
-    createViewportFromRect(aProps);
-    makeCurvedPathFromPoints(aProps, true);
+    createViewportFromRect(aProps, getBoundingBox());
+    makeCurvedPathFromPoints(aProps, maPoints, true);
 
     basegfx::B2DPolyPolygon aPolyPoly;
-    bool bSuccess = basegfx::tools::importFromSvgD( aPolyPoly, aProps[USTR("svg:d")] );
+    bool bSuccess = basegfx::tools::importFromSvgD( aPolyPoly, aProps["svg:d"] );
     if (!bSuccess)
     {
         fprintf(stderr, "Failed to import a polypolygon from %s\n",
-            rtl::OUStringToOString(aProps[USTR("draw:d")], RTL_TEXTENCODING_UTF8).getStr());
+            rtl::OUStringToOString(aProps["draw:d"], RTL_TEXTENCODING_UTF8).getStr());
     }
 
     basegfx::B2DRange aRange = aPolyPoly.getB2DRange();
@@ -2148,26 +2476,26 @@ PropertyMap StandardBeziergonObject::import(const uno::Reference<xml::dom::XElem
 PropertyMap StandardPolyLineObject::import(const uno::Reference<xml::dom::XElement> &rxElem, DiaImporter &rImporter)
 {
     PropertyMap aProps = DiaObject::import(rxElem, rImporter);
-    createViewportFromPoints(aProps[USTR("draw:points")], aProps,
-        rImporter.adjustX(0), rImporter.adjustY(0));
-    bumpPoints(aProps);
+    maGeometry.setFrame(createViewportFromPoints(maPoints, aProps,
+        rImporter.adjustX(0), rImporter.adjustY(0)));
+    bumpPoints(aProps, maPoints);
     return aProps;
 }
 
-void ZigZagLineObject::handleObjectAttribute(const uno::Reference<xml::dom::XElement> &rxElem,
+void ZigZagLineObject::handleObjectAttribute(DiaAttribute eAttr, const rtl::OUString &rName,
+    const uno::Reference<xml::dom::XElement> &rxElem,
     DiaImporter &rImporter,
     PropertyMap &rAttrs,
     PropertyMap &rStyleAttrs)
 {
-    const uno::Reference<xml::dom::XNamedNodeMap> xAttributes = rxElem->getAttributes();
-    uno::Reference<xml::dom::XNode> xNode(xAttributes->getNamedItem(USTR("name")));
-    if(xNode.is())
+    switch (eAttr)
     {
-        rtl::OUString sName(xNode->getNodeValue());
-        if (sName == USTR("autorouting"))
+        case ATTR_AUTOROUTING:
             mbAutoRoute = valueOfSimpleAttribute(rxElem) == USTR("true");
-        else
-            DiaObject::handleObjectAttribute(rxElem, rImporter, rAttrs, rStyleAttrs);
+            break;
+        default:
+            DiaObject::handleObjectAttribute(eAttr, rName, rxElem, rImporter, rAttrs, rStyleAttrs);
+            break;
     }
 }
 
@@ -2552,52 +2880,37 @@ bool what_would_ooo_do(const basegfx::B2DPoint &frompos, int fromdir,
 
 #define BUMPFACTOR 1000
 
-void ZigZagLineObject::confirmZigZag(PropertyMap &rProps, const DiaImporter &rImporter) const
+void ZigZagLineObject::confirmZigZag(PropertyMap &rProps, const std::vector< basegfx::B2DPoint > &rPoints,
+    const DiaImporter &rImporter) const
 {
-    rtl::OUString sPoints = rProps[USTR("draw:points")];
-
-    sal_Int32 nIndex = 0;
-    float nStartX = sPoints.getToken(0, ',', nIndex).toFloat();
-    nStartX = rImporter.adjustX(nStartX);
-    float nStartY = sPoints.getToken(0, ' ', nIndex).toFloat();
-    nStartY = rImporter.adjustY(nStartY);
-
-    rtl::OUString sNewPoints =
-        rtl::OUString::number(nStartX) + USTR(",") +
-        rtl::OUString::number(nStartY);
-
-    //get endpoints, and fix up positions
-    float nEndX, nEndY;
-    do
+    //fix up positions
+    std::vector< basegfx::B2DPoint > aPoints;
+    aPoints.reserve(rPoints.size());
+    std::vector< basegfx::B2DPoint >::const_iterator aEnd = rPoints.end();
+    for (std::vector< basegfx::B2DPoint >::const_iterator aI = rPoints.begin(); aI != aEnd; ++aI)
     {
-        nEndX = sPoints.getToken(0, ',', nIndex).toFloat();
-        nEndX = rImporter.adjustX(nEndX);
-
-        nEndY = sPoints.getToken(0, ' ', nIndex).toFloat();
-        nEndY = rImporter.adjustY(nEndY);
-
-        sNewPoints = sNewPoints + USTR(" ");
-        sNewPoints = sNewPoints +
-            rtl::OUString::number(nEndX) + USTR(",") + rtl::OUString::number(nEndY);
+        aPoints.push_back(basegfx::B2DPoint(rImporter.adjustX(aI->getX()),
+            rImporter.adjustY(aI->getY())));
     }
-    while ( nIndex >= 0 );
-    rProps[USTR("draw:points")] = sNewPoints;
 
-    rProps[USTR("svg:x1")] = rtl::OUString::number(nStartX)+USTR("cm");
-    rProps[USTR("svg:y1")] = rtl::OUString::number(nStartY)+USTR("cm");
+    rProps["svg:x1"] = formatNumber(aPoints.front().getX(), "cm");
+    rProps["svg:y1"] = formatNumber(aPoints.front().getY(), "cm");
 
-    rProps[USTR("svg:x2")] = rtl::OUString::number(nEndX)+USTR("cm");
-    rProps[USTR("svg:y2")] = rtl::OUString::number(nEndY)+USTR("cm");
+    rProps["svg:x2"] = formatNumber(aPoints.back().getX(), "cm");
+    rProps["svg:y2"] = formatNumber(aPoints.back().getY(), "cm");
 
-    bumpPoints(rProps, BUMPFACTOR);
-    makePathFromPoints(rProps, false);
+    bumpPoints(rProps, aPoints, BUMPFACTOR);
+    makePathFromPoints(rProps, aPoints, false, BUMPFACTOR);
 }
 
-void ZigZagLineObject::rejectZigZag(PropertyMap &rProps, const DiaImporter &rImporter) const
+void ZigZagLineObject::rejectZigZag(PropertyMap &rProps, const std::vector< basegfx::B2DPoint > &rPoints,
+    const DiaImporter &rImporter) const
 {
-    createViewportFromPoints(rProps[USTR("draw:points")], rProps,
-        rImporter.adjustX(0), rImporter.adjustY(0));
-    bumpPoints(rProps);
+    Geometry aFrame;
+    aFrame.setFrame(createViewportFromPoints(rPoints, rProps,
+        rImporter.adjustX(0), rImporter.adjustY(0)));
+    aFrame.format(rProps);
+    bumpPoints(rProps, rPoints);
 }
 
 void ZigZagLineObject::adjustConnectionPoints(PropertyMap &rProps, const DiaImporter &rImporter)
@@ -2606,22 +2919,22 @@ void ZigZagLineObject::adjustConnectionPoints(PropertyMap &rProps, const DiaImpo
 
     rtl::OUString sStartShape, sStartPoint, sEndShape, sEndPoint;
     PropertyMap::const_iterator aI;
-    aI = rProps.find(USTR("draw:start-shape"));
+    aI = rProps.find("draw:start-shape");
     if (aI != rProps.end())
     {
         sStartShape = aI->second;
     }
-    aI = rProps.find(USTR("draw:start-glue-point"));
+    aI = rProps.find("draw:start-glue-point");
     if (aI != rProps.end())
     {
         sStartPoint = aI->second;
     }
-    aI = rProps.find(USTR("draw:end-shape"));
+    aI = rProps.find("draw:end-shape");
     if (aI != rProps.end())
     {
         sEndShape = aI->second;
     }
-    aI = rProps.find(USTR("draw:end-glue-point"));
+    aI = rProps.find("draw:end-glue-point");
     if (aI != rProps.end())
     {
         sEndPoint = aI->second;
@@ -2645,22 +2958,9 @@ void ZigZagLineObject::adjustConnectionPoints(PropertyMap &rProps, const DiaImpo
             aEndShape = rImporter.getobjectbyid(sEndShape);
     }
 
-    rtl::OUString sPoints = rProps[USTR("draw:points")];
-    std::vector<basegfx::B2DPoint> dia_layout;
-
-    sal_Int32 nIndex = 0;
-    float xend, xstart = sPoints.getToken(0, ',', nIndex).toFloat();
-    float yend, ystart = sPoints.getToken(0, ' ', nIndex).toFloat();
-    dia_layout.push_back(basegfx::B2DPoint(xstart, ystart));
-    size_t nPairs=1;
-    do
-    {
-        xend = sPoints.getToken(0, ',', nIndex).toFloat();
-        yend = sPoints.getToken(0, ' ', nIndex).toFloat();
-        dia_layout.push_back(basegfx::B2DPoint(xend, yend));
-        ++nPairs;
-    }
-    while ( nIndex >= 0 );
+    if (maPoints.empty())
+        return;
+    std::vector<basegfx::B2DPoint> &dia_layout = maPoints;
 
     if (aStartShape.get())
     {
@@ -2688,19 +2988,6 @@ void ZigZagLineObject::adjustConnectionPoints(PropertyMap &rProps, const DiaImpo
                 aI->setY(dia_layout.front().getY());
         }
     }
-
-    rtl::OUString sNewPoints;
-
-    std::vector<basegfx::B2DPoint>::const_iterator aEnd = dia_layout.end();
-    for (std::vector<basegfx::B2DPoint>::const_iterator aI = dia_layout.begin(); aI != aEnd; ++aI)
-    {
-        if (sNewPoints.getLength())
-            sNewPoints = sNewPoints + USTR(" ");
-        sNewPoints = sNewPoints +
-            rtl::OUString::number(aI->getX()) + USTR(",") + rtl::OUString::number(aI->getY());
-    }
-
-    rProps[USTR("draw:points")] = sNewPoints;
 }
 
 void ZigZagLineObject::write(uno::Reference<xml::sax::XDocumentHandler> &rDocHandler, const PropertyMap &rProps, const DiaImporter &rImporter) const
@@ -2711,22 +2998,22 @@ void ZigZagLineObject::write(uno::Reference<xml::sax::XDocumentHandler> &rDocHan
 
     rtl::OUString sStartShape, sStartPoint, sEndShape, sEndPoint;
     PropertyMap::const_iterator aI;
-    aI = aProps.find(USTR("draw:start-shape"));
+    aI = aProps.find("draw:start-shape");
     if (aI != aProps.end())
     {
         sStartShape = aI->second;
     }
-    aI = aProps.find(USTR("draw:start-glue-point"));
+    aI = aProps.find("draw:start-glue-point");
     if (aI != aProps.end())
     {
         sStartPoint = aI->second;
     }
-    aI = aProps.find(USTR("draw:end-shape"));
+    aI = aProps.find("draw:end-shape");
     if (aI != aProps.end())
     {
         sEndShape = aI->second;
     }
-    aI = aProps.find(USTR("draw:end-glue-point"));
+    aI = aProps.find("draw:end-glue-point");
     if (aI != aProps.end())
     {
         sEndPoint = aI->second;
@@ -2757,30 +3044,13 @@ void ZigZagLineObject::write(uno::Reference<xml::sax::XDocumentHandler> &rDocHan
     if (aEndShape.get())
         enddirection = aEndShape->getConnectionDirection(sEndPoint.toInt32());
 
-    rtl::OUString sPoints = aProps[USTR("draw:points")];
-    std::vector<basegfx::B2DPoint> dia_layout;
-
-    sal_Int32 nIndex = 0;
-    float xend, xstart = sPoints.getToken(0, ',', nIndex).toFloat();
-    float yend, ystart = sPoints.getToken(0, ' ', nIndex).toFloat();
-    dia_layout.push_back(basegfx::B2DPoint(xstart, ystart));
-    size_t nPairs=1;
-    do
-    {
-        xend = sPoints.getToken(0, ',', nIndex).toFloat();
-        yend = sPoints.getToken(0, ' ', nIndex).toFloat();
-        dia_layout.push_back(basegfx::B2DPoint(xend, yend));
-        ++nPairs;
-    }
-    while ( nIndex >= 0 );
+    const std::vector<basegfx::B2DPoint> &dia_layout = maPoints;
+    size_t nPairs = dia_layout.size();
 
     std::vector<basegfx::B2DPoint> best_layout;
-    bool ok = what_would_dia_do(dia_layout.front(), startdirection,
+    bool ok = nPairs == 4 && what_would_dia_do(dia_layout.front(), startdirection,
                       dia_layout.back(), enddirection, best_layout);
 
-    if (nPairs != 4)
-        ok = false;
-
 #if DEBUG_CONNECTOR_RECALCULATE
     if (0)
 #else
@@ -2824,8 +3094,8 @@ void ZigZagLineObject::write(uno::Reference<xml::sax::XDocumentHandler> &rDocHan
             else if (best_layout[1].getY() != best_layout[2].getY())
                 fSkew = dia_layout[2].getX() - best_layout[2].getX();
 
-            aProps[USTR("draw:line-skew")] = rtl::OUString::number(fSkew) + USTR("cm");
-            confirmZigZag(aProps, rImporter);
+            aProps["draw:line-skew"] = formatNumber(fSkew, "cm");
+            confirmZigZag(aProps, dia_layout, rImporter);
         }
     }
     if (!ok)
@@ -2835,7 +3105,7 @@ void ZigZagLineObject::write(uno::Reference<xml::sax::XDocumentHandler> &rDocHan
             fprintf(stderr, "INFO: ZigZagLine has more segments than OOo currently supports, replacing with PolyLine\n");
         else
             fprintf(stderr, "INFO: Forced to use a PolyLine instead of a Connector\n");
-        rejectZigZag(aProps, rImporter);
+        rejectZigZag(aProps, dia_layout, rImporter);
         sOutputType = USTR("draw:polyline");
     }
 
@@ -2851,7 +3121,7 @@ void ZigZagLineObject::write(uno::Reference<xml::sax::XDocumentHandler> &rDocHan
 #endif
 
     
-    rDocHandler->startElement(sOutputType, new SaxAttrList(aProps));
+    rDocHandler->startElement(sOutputType, makeXAttribute(aProps));
     writeConnectionPoints(rDocHandler);
     if (msString.getLength())
         writeText(rDocHandler);
@@ -2862,14 +3132,14 @@ PropertyMap StandardArcObject::import(const uno::Reference<xml::dom::XElement> &
 {
     PropertyMap aProps = DiaObject::import(rxElem, rImporter);
 
-    rtl::OUString sPoints = aProps[USTR("dia:endpoints")];
+    rtl::OUString sPoints = aProps["dia:endpoints"];
     sal_Int32 nIndex = 0;
     float x1 = sPoints.getToken(0, ',', nIndex).toFloat();
     float y1 = sPoints.getToken(0, ' ', nIndex).toFloat();
     float x2 = sPoints.getToken(0, ',', nIndex).toFloat();
     float y2 = sPoints.getToken(0, ' ', nIndex).toFloat();
 
-    float curve_distance = aProps[USTR("dia:curve_distance")].toFloat();
+    float curve_distance = aProps["dia:curve_distance"].toFloat();
 
     float lensq = (x2-x1)*(x2-x1) + (y2-y1)*(y2-y1);
     float radius = lensq/(8*curve_distance) + curve_distance/2.0;
@@ -2897,50 +3167,47 @@ PropertyMap StandardArcObject::import(const uno::Reference<xml::dom::XElement> &
         radius = -radius;
     }
 
-    aProps[USTR("draw:kind")] = USTR("arc");
-    aProps[USTR("draw:start-angle")] = rtl::OUString::number(angle1);
-    aProps[USTR("draw:end-angle")] = rtl::OUString::number(angle2);
-    mnWidth = mnHeight = radius*2;
-    mnX = rImporter.adjustX(xc-radius);
-    mnY = rImporter.adjustY(yc-radius);
-    aProps[USTR("svg:width")] = aProps[USTR("svg:height")] = rtl::OUString::number(mnWidth) + USTR("cm");
-    aProps[USTR("svg:x")] = rtl::OUString::number(mnX) + USTR("cm");
-    aProps[USTR("svg:y")] = rtl::OUString::number(mnY) + USTR("cm");
+    aProps["draw:kind"] = USTR("arc");
+    aProps["draw:start-angle"] = formatNumber(angle1);
+    aProps["draw:end-angle"] = formatNumber(angle2);
+    maGeometry.mfWidth = maGeometry.mfHeight = radius*2;
+    maGeometry.mfX = rImporter.adjustX(xc-radius);
+    maGeometry.mfY = rImporter.adjustY(yc-radius);
+    maGeometry.mbHasPosition = maGeometry.mbHasWidth = maGeometry.mbHasHeight = true;
 
     return aProps;
 }
 
-void StandardArcObject::handleObjectAttribute(const uno::Reference<xml::dom::XElement> &rxElem,
+void StandardArcObject::handleObjectAttribute(DiaAttribute eAttr, const rtl::OUString &rName,
+    const uno::Reference<xml::dom::XElement> &rxElem,
     DiaImporter &rImporter,
     PropertyMap &rAttrs,
     PropertyMap &rStyleAttrs)
 {
-    const uno::Reference<xml::dom::XNamedNodeMap> xAttributes = rxElem->getAttributes();
-    uno::Reference<xml::dom::XNode> xNode(xAttributes->getNamedItem(USTR("name")));
-    if(xNode.is())
+    switch (eAttr)
     {
-        rtl::OUString sName(xNode->getNodeValue());
-        if (sName == USTR("conn_endpoints"))
-            rAttrs[USTR("dia:endpoints")] = valueOfSimpleAttribute(rxElem);
-        else if (sName == USTR("curve_distance"))
-            rAttrs[USTR("dia:curve_distance")] = valueOfSimpleAttribute(rxElem);
-        else
-            DiaObject::handleObjectAttribute(rxElem, rImporter, rAttrs, rStyleAttrs);
+        case ATTR_CONN_ENDPOINTS:
+            rAttrs["dia:endpoints"] = valueOfSimpleAttribute(rxElem);
+            break;
+        case ATTR_CURVE_DISTANCE:
+            rAttrs["dia:curve_distance"] = valueOfSimpleAttribute(rxElem);
+            break;
+        default:
+            DiaObject::handleObjectAttribute(eAttr, rName, rxElem, rImporter, rAttrs, rStyleAttrs);
+            break;
     }
 }
 
 PropertyMap StandardPolygonObject::import(const uno::Reference<xml::dom::XElement> &rxElem, DiaImporter &rImporter)
 {
     PropertyMap aProps = DiaObject::import(rxElem, rImporter);
-    createViewportFromRect(aProps);
+    createViewportFromRect(aProps, getBoundingBox());
+    bumpPoints(aProps, maPoints);
 
     basegfx::B2DPolygon aPoly;
-    bool bSuccess = basegfx::tools::importFromSvgPoints(aPoly, aProps[USTR("draw:points")]);
-    if (!bSuccess)
-    {
-        fprintf(stderr, "Failed to import a polygon from %s\n",
-            rtl::OUStringToOString(aProps[USTR("draw:points")], RTL_TEXTENCODING_UTF8).getStr());
-    }
+    std::vector< basegfx::B2DPoint >::const_iterator aEnd = maPoints.end();
+    for (std::vector< basegfx::B2DPoint >::const_iterator aI = maPoints.begin(); aI != aEnd; ++aI)
+        aPoly.append(*aI);
     aPoly.setClosed(true);
 
     basegfx::B2DRange aRange = aPoly.getB2DRange();
@@ -2979,54 +3246,14 @@ PropertyMap StandardPolygonObject::import(const uno::Reference<xml::dom::XElemen
 
 shapeimporter DiaImporter::findCustomImporter(const rtl::OUString &rName)
 {
-    if (maTemplates.empty())
-        recursiveScan(msInstallDir + USTR("shapes"));
-    return maTemplates[rName];
-}
-
-void DiaImporter::recursiveScan(const rtl::OUString &rDir)
-{
-    osl::Directory aShapeDir(rDir);
-    if (aShapeDir.open() != osl::FileBase::E_None)
-        return;
-    osl::DirectoryItem aItem;
-    while (aShapeDir.getNextItem(aItem) == osl::FileBase::E_None)
-    {
-        osl::FileStatus aStatus(osl_FileStatus_Mask_Type | osl_FileStatus_Mask_FileURL);
-        if (!aItem.getFileStatus(aStatus) == osl::FileBase::E_None)
-            continue;
-        if (aStatus.getFileType() == osl::FileStatus::Directory)
-            recursiveScan(aStatus.getFileURL());
-        else
-            importShape(aStatus.getFileURL());
-    }
-}
-
-void DiaImporter::importShape(const rtl::OUString &rShapeFile)
-{
-    try
-    {
-
-        uno::Reference< ucb::XSimpleFileAccess > xSimpleFileAccess(
-            mxCtx->getServiceManager()->createInstanceWithContext(USTR("com.sun.star.ucb.SimpleFileAccess"),
-                mxCtx), uno::UNO_QUERY_THROW);
-        uno::Reference< io::XInputStream > xInputStream(xSimpleFileAccess->openFileRead(rShapeFile));
-        uno::Reference<xml::dom::XDocumentBuilder> xDomBuilder(
-            mxMSF->createInstance(USTR("com.sun.star.xml.dom.DocumentBuilder") ), uno::UNO_QUERY_THROW);
-        uno::Reference<xml::dom::XDocument> xDom(xDomBuilder->parse(xInputStream), uno::UNO_QUERY_THROW);
-        uno::Reference<xml::dom::XElement> xDocElem(xDom->getDocumentElement(), uno::UNO_QUERY_THROW);
-    
-        shapeimporter pImporter(new ShapeImporter());
-        if (pImporter->import(xDocElem))
-        {
-            //fprintf(stderr, "title s %s\n", rtl::OUStringToOString(pImporter->getTitle(), RTL_TEXTENCODING_UTF8).getStr());
-            maTemplates[pImporter->getTitle()] = pImporter;
-        }
-    }
-    catch ( ... )
+    //The shape library is shared with other imports, just make sure once per
+    //import that the installed shapes haven't changed underneath it
+    if (!mbTemplatesChecked)
     {
-        fprintf(stderr, "Could not parse %s\n", rtl::OUStringToOString(rShapeFile, RTL_TEXTENCODING_UTF8).getStr());
+        ShapeLibrary::get().update(mxCtx, msInstallDir);
+        mbTemplatesChecked = true;
     }
+    return ShapeLibrary::get().findImporter(mxCtx, rName);
 }
 
 class FlowchartBoxObject : public DiaObject
@@ -3070,44 +3297,38 @@ public:
     FlowchartParallelogramObject() : mnShearAngle(45) {}
     virtual rtl::OUString outputtype() const { return USTR("draw:polygon"); }
     virtual PropertyMap import(const uno::Reference<xml::dom::XElement> &rxElem, DiaImporter &rImporter);
-    virtual void handleObjectAttribute(const uno::Reference<xml::dom::XElement> &rxElem,
+    virtual void handleObjectAttribute(DiaAttribute eAttr, const rtl::OUString &rName,
+        const uno::Reference<xml::dom::XElement> &rxElem,
         DiaImporter &rImporter,
         PropertyMap &rAttrs,
         PropertyMap &rStyleAttrs);
 };
 
-void FlowchartParallelogramObject::handleObjectAttribute(const uno::Reference<xml::dom::XElement> &rxElem,
+void FlowchartParallelogramObject::handleObjectAttribute(DiaAttribute eAttr, const rtl::OUString &rName,
+    const uno::Reference<xml::dom::XElement> &rxElem,
     DiaImporter &rImporter,
     PropertyMap &rAttrs,
     PropertyMap &rStyleAttrs)
 {
-    const uno::Reference<xml::dom::XNamedNodeMap> xAttributes = rxElem->getAttributes();
-    uno::Reference<xml::dom::XNode> xNode(xAttributes->getNamedItem(USTR("name")));
-    if(xNode.is())
+    switch (eAttr)
     {
-        rtl::OUString sName(xNode->getNodeValue());
-        if (sName == USTR("shear_angle"))
+        case ATTR_SHEAR_ANGLE:
             mnShearAngle = valueOfSimpleAttribute(rxElem).toFloat();
-        else
-            DiaObject::handleObjectAttribute(rxElem, rImporter, rAttrs, rStyleAttrs);
+            break;
+        default:
+            DiaObject::handleObjectAttribute(eAttr, rName, rxElem, rImporter, rAttrs, rStyleAttrs);
+            break;
     }
 }
 
 namespace
 {
-    rtl::OUString makePointsString(const basegfx::B2DPolygon &rPoly)
+    void getPoints(const basegfx::B2DPolygon &rPoly, std::vector< basegfx::B2DPoint > &rPoints)
     {
-        rtl::OUString sPoints;
         sal_uInt32 nEnd = rPoly.count();
+        rPoints.resize(nEnd);
         for (sal_uInt32 i = 0; i < nEnd; ++i)
-        {
-            if (sPoints.getLength())
-                sPoints = sPoints + USTR(" ");
-            basegfx::B2DPoint aPoint = rPoly.getB2DPoint(i);
-            sPoints = sPoints + rtl::OUString::number(aPoint.getX())+
-                USTR(",") + rtl::OUString::number(aPoint.getY());
-        }
-        return sPoints;
+            rPoints[i] = rPoly.getB2DPoint(i);
     }
 }
 
@@ -3115,7 +3336,7 @@ PropertyMap FlowchartParallelogramObject::import(const uno::Reference<xml::dom::
 {
     PropertyMap aProps = DiaObject::import(rxElem, rImporter);
 
-    basegfx::B2DPolygon aPoly = basegfx::tools::createPolygonFromRect(basegfx::B2DRectangle(mnX, mnY, mnX+mnWidth, mnY+mnHeight));
+    basegfx::B2DPolygon aPoly = basegfx::tools::createPolygonFromRect(basegfx::B2DRectangle(maGeometry.mfX, maGeometry.mfY, maGeometry.mfX+maGeometry.mfWidth, maGeometry.mfY+maGeometry.mfHeight));
     basegfx::B2DRange aOldSize = aPoly.getB2DRange();
 
     basegfx::B2DHomMatrix aMatrix;
@@ -3127,13 +3348,15 @@ PropertyMap FlowchartParallelogramObject::import(const uno::Reference<xml::dom::
     aMatrix.scale(aOldSize.getWidth()/aNewSize.getWidth(), 1);
     aPoly.transform(aMatrix);
 
-    aProps[USTR("draw:points")] = makePointsString(aPoly);
-    createViewportFromRect(aProps);
+    getPoints(aPoly, maPoints);
+    createViewportFromRect(aProps, getBoundingBox());
+    bumpPoints(aProps, maPoints);
     return aProps;
 }
 
 class FlowchartDiamondObject : public DiaObject
 {
+    void setDiamondPoints();
 public:
     FlowchartDiamondObject();
     virtual rtl::OUString outputtype() const { return USTR("draw:polygon"); }
@@ -3170,92 +3393,50 @@ FlowchartDiamondObject::FlowchartDiamondObject()
     maConnectionPoints.push_back(ConnectionPoint(0, 0, DIR_ALL));
 }
 
+void FlowchartDiamondObject::setDiamondPoints()
+{
+    const Geometry &rG = maGeometry;
+    maPoints.clear();
+    maPoints.push_back(basegfx::B2DPoint(rG.mfX+rG.mfWidth/2, rG.mfY));
+    maPoints.push_back(basegfx::B2DPoint(rG.mfX+rG.mfWidth, rG.mfY+rG.mfHeight/2));
+    maPoints.push_back(basegfx::B2DPoint(rG.mfX+rG.mfWidth/2, rG.mfY+rG.mfHeight));
+    maPoints.push_back(basegfx::B2DPoint(rG.mfX, rG.mfY+rG.mfHeight/2));
+}
+
 PropertyMap FlowchartDiamondObject::import(const uno::Reference<xml::dom::XElement> &rxElem, DiaImporter &rImporter)
 {
     PropertyMap aProps = DiaObject::import(rxElem, rImporter);
 
-    aProps[USTR("draw:points")] =
-        rtl::OUString::number(mnX+mnWidth/2) + USTR(",") + rtl::OUString::number(mnY) +
-        USTR(" ") +
-        rtl::OUString::number(mnX+mnWidth) + USTR(",") + rtl::OUString::number(mnY+mnHeight/2) +
-        USTR(" ") +
-        rtl::OUString::number(mnX+mnWidth/2) + USTR(",") + rtl::OUString::number(mnY+mnHeight) +
-        USTR(" ") +
-        rtl::OUString::number(mnX) + USTR(",") + rtl::OUString::number(mnY+mnHeight/2);
-
-    createViewportFromRect(aProps);
+    setDiamondPoints();
+    createViewportFromRect(aProps, getBoundingBox());
+    bumpPoints(aProps, maPoints);
     return aProps;
 }
 
-void FlowchartDiamondObject::resizeIfNarrow(PropertyMap &rProps, const DiaImporter &rImporter)
+void FlowchartDiamondObject::resizeIfNarrow(PropertyMap &rProps, const DiaImporter &)
 {
-    PropertyMap::const_iterator aI;
-
-    float fStrokeWidth = 0.1;
-    float fWidth = 0, fHeight = 0;
-
-    aI = rProps.find(USTR("svg:width"));
-    if (aI != rProps.end())
-        fWidth = ::comphelper::string::searchAndReplaceAllAsciiWithAscii(aI->second, "cm", "").toFloat();
-    aI = rProps.find(USTR("svg:height"));
-    if (aI != rProps.end())
-        fHeight = ::comphelper::string::searchAndReplaceAllAsciiWithAscii(aI->second, "cm", "").toFloat();
-
-    rtl::OUString sDrawStyleName;
-    aI = rProps.find(USTR("draw:style-name"));
-    if (aI != rProps.end())
-        sDrawStyleName = aI->second;
-
-    if (sDrawStyleName.getLength())
-    {
-        const GraphicStyleManager &rGraphicStyleManager = rImporter.getGraphicStyleManager();
-        if (const PropertyMap *pStyle = rGraphicStyleManager.getStyleByName(sDrawStyleName))
-        {
-            aI = pStyle->find(USTR("svg:stroke-width"));
-            if (aI != pStyle->end())
-                fStrokeWidth = ::comphelper::string::searchAndReplaceAllAsciiWithAscii(aI->second, "cm", "").toFloat();
-        }
-    }
+    double fStrokeWidth = maGeometry.mfStrokeWidth;
+    double fWidth = maGeometry.mfWidth, fHeight = maGeometry.mfHeight;
 
     rtl::OUString sTextStyleName;
-    aI = maTextProps.find(USTR("text:style-name"));
+    PropertyMap::const_iterator aI = maTextProps.find("text:style-name");
     if (aI != maTextProps.end())
         sTextStyleName = aI->second;
     if (sTextStyleName.getLength())
     {
-        const TextStyleManager &rTextStyleManager = rImporter.getTextStyleManager();
-        double fTextWidth = 0.0;
+        double fTextWidth = maLayout.mfWidth;
 
-        float fCalcHeight = 0.0;
-        if (const PropertyMap *pStyle = rTextStyleManager.getStyleByName(sTextStyleName))
-        {
-            uno::Reference< awt::XFont > xFont = rTextStyleManager.getMatchingFont(*pStyle);
-            awt::SimpleFontMetric aMetric = xFont->getFontMetric();
-            fCalcHeight = (aMetric.Ascent + aMetric.Leading + aMetric.Descent) / 72.0 * 2.54;
-        }
-
-        int nCount=1;
-        sal_Int32 nIndex=0;
-        do
-        {
-            rtl::OUString sSpan = msString.getToken(0, '\n', nIndex);
-            double fSpanWidth = rTextStyleManager.getStringWidth(sTextStyleName, sSpan);
-            if (fSpanWidth > fTextWidth)
-                fTextWidth = fSpanWidth;
-            ++nCount;
-        }
-        while ( nIndex >= 0 );
-        fCalcHeight *= (nCount-1);
-        fCalcHeight += mnPadding * 2 + fStrokeWidth * 2;
+        double fCalcHeight = maLayout.mfLineHeight * maLayout.maLines.size();
+        fCalcHeight += maGeometry.mfPadding * 2 + fStrokeWidth * 2;
 
-        double fCalcWidth = mnPadding * 2 + fStrokeWidth * 2 + fTextWidth;
+        double fCalcWidth = maGeometry.mfPadding * 2 + fStrokeWidth * 2 + fTextWidth;
 
         double fNewWidth = fWidth, fNewHeight = fHeight;
         //fairly arbitrary dia settings
         if (fCalcHeight > (fWidth - fCalcWidth) * fHeight / fWidth)
         {
             /* increase size of the diamond while keeping its aspect ratio */
-            float grad = fWidth/fHeight;
+            double grad = fWidth/fHeight;
             if (grad < 1.0/4) grad = 1.0/4;
             if (grad > 4)     grad = 4;
             fNewWidth = fCalcWidth + fCalcHeight * grad;
@@ -3264,32 +3445,23 @@ void FlowchartDiamondObject::resizeIfNarrow(PropertyMap &rProps, const DiaImport
 
         if (fNewWidth > fWidth)
         {
-            mnWidth=fNewWidth;
-            rProps[USTR("svg:width")] = rtl::OUString::number(fNewWidth)+USTR("cm");
+            maGeometry.mfWidth=fNewWidth;
             double fDiff = (fNewWidth - fWidth) / 2;
-            mnX-=fDiff;
-            rProps[USTR("svg:x")] = rtl::OUString::number(mnX)+USTR("cm");
+            maGeometry.mfX-=fDiff;
+            maGeometry.mbHasWidth = maGeometry.mbHasPosition = true;
         }
 
         if (fNewHeight > fHeight)
         {
-            mnHeight=fNewHeight;
-            rProps[USTR("svg:height")] = rtl::OUString::number(fNewHeight)+USTR("cm");
+            maGeometry.mfHeight=fNewHeight;
             double fDiff = (fNewHeight - fHeight) / 2;
-            mnY-=fDiff;
-            rProps[USTR("svg:y")] = rtl::OUString::number(mnY)+USTR("cm");
+            maGeometry.mfY-=fDiff;
+            maGeometry.mbHasHeight = maGeometry.mbHasPosition = true;
         }
 
-        rProps[USTR("draw:points")] =
-            rtl::OUString::number(mnX+mnWidth/2) + USTR(",") + rtl::OUString::number(mnY) +
-            USTR(" ") +
-            rtl::OUString::number(mnX+mnWidth) + USTR(",") + rtl::OUString::number(mnY+mnHeight/2) +
-            USTR(" ") +
-            rtl::OUString::number(mnX+mnWidth/2) + USTR(",") + rtl::OUString::number(mnY+mnHeight) +
-            USTR(" ") +
-            rtl::OUString::number(mnX) + USTR(",") + rtl::OUString::number(mnY+mnHeight/2);
-
-        createViewportFromRect(rProps);
+        setDiamondPoints();
+        createViewportFromRect(rProps, getBoundingBox());
+        bumpPoints(rProps, maPoints);
     }
 }
 
@@ -3301,7 +3473,8 @@ public:
     KaosGoalObject();
     virtual rtl::OUString outputtype() const;
     virtual PropertyMap import(const uno::Reference<xml::dom::XElement> &rxElem, DiaImporter &rImporter);
-    virtual void handleObjectAttribute(const uno::Reference<xml::dom::XElement> &rxElem,
+    virtual void handleObjectAttribute(DiaAttribute eAttr, const rtl::OUString &rName,
+        const uno::Reference<xml::dom::XElement> &rxElem,
         DiaImporter &rImporter, PropertyMap &rAttrs, PropertyMap &rStyleAttrs);
 };
 
@@ -3320,26 +3493,22 @@ rtl::OUString KaosGoalObject::outputtype() const
     return sRet;
 }
 
-void KaosGoalObject::handleObjectAttribute(const uno::Reference<xml::dom::XElement> &rxElem,
+void KaosGoalObject::handleObjectAttribute(DiaAttribute eAttr, const rtl::OUString &rName,
+    const uno::Reference<xml::dom::XElement> &rxElem,
     DiaImporter &rImporter,
     PropertyMap &rAttrs,
     PropertyMap &rStyleAttrs)
 {
-    const uno::Reference<xml::dom::XNamedNodeMap> xAttributes = rxElem->getAttributes();
-    uno::Reference<xml::dom::XNode> xNode(xAttributes->getNamedItem(USTR("name")));
-    if(xNode.is())
+    switch (eAttr)
     {
-        rtl::OUString sName(xNode->getNodeValue());
-        if (sName == USTR("type"))
-        {
+        case ATTR_TYPE:
             mnType = valueOfSimpleAttribute(rxElem).toInt32();
-            if (mnType == 2 || mnType == 3)
-                rStyleAttrs[USTR("svg:stroke-width")] = USTR("0.18cm");
-            else
-                rStyleAttrs[USTR("svg:stroke-width")] = USTR("0.09cm");
-        }
-        else
-            DiaObject::handleObjectAttribute(rxElem, rImporter, rAttrs, rStyleAttrs);
+            maGeometry.mfStrokeWidth = (mnType == 2 || mnType == 3) ? 0.18 : 0.09;
+            rStyleAttrs["svg:stroke-width"] = formatNumber(maGeometry.mfStrokeWidth, "cm");
+            break;
+        default:
+            DiaObject::handleObjectAttribute(eAttr, rName, rxElem, rImporter, rAttrs, rStyleAttrs);
+            break;
     }
 }
 
@@ -3392,7 +3561,7 @@ PropertyMap KaosGoalObject::import(const uno::Reference<xml::dom::XElement> &rxE
             break;
         default:
             {
-            basegfx::B2DPolygon aPoly = basegfx::tools::createPolygonFromRect(basegfx::B2DRectangle(mnX, mnY, mnX+mnWidth, mnY+mnHeight));
+            basegfx::B2DPolygon aPoly = basegfx::tools::createPolygonFromRect(basegfx::B2DRectangle(maGeometry.mfX, maGeometry.mfY, maGeometry.mfX+maGeometry.mfWidth, maGeometry.mfY+maGeometry.mfHeight));
             basegfx::B2DRange aOldSize = aPoly.getB2DRange();
 
             basegfx::B2DHomMatrix aMatrix;
@@ -3405,8 +3574,9 @@ PropertyMap KaosGoalObject::import(const uno::Reference<xml::dom::XElement> &rxE
             aMatrix.scale(aOldSize.getWidth()/aNewSize.getWidth(), 1);
             aPoly.transform(aMatrix);
 
-            aProps[USTR("draw:points")] = makePointsString(aPoly);
-            createViewportFromRect(aProps);
+            getPoints(aPoly, maPoints);
+            createViewportFromRect(aProps, getBoundingBox());
+            bumpPoints(aProps, maPoints);
             }
             break;
     }
@@ -3415,6 +3585,51 @@ PropertyMap KaosGoalObject::import(const uno::Reference<xml::dom::XElement> &rxE
 }
 
 
+namespace
+{
+    template<class T> DiaObject* createObject() { return new T(); }
+
+    //The dia object types implemented natively, anything else is looked for
+    //in the custom shapes
+    class ObjectRegistry
+    {
+    private:
+        typedef DiaObject* (*objectfactory)();
+        typedef boost::unordered_map< rtl::OUString, objectfactory, rtl::OUStringHash > factories;
+        factories maFactories;
+        void add(const char *pType, objectfactory pFactory)
+            { maFactories[rtl::OUString::createFromAscii(pType)] = pFactory; }
+    public:
+        ObjectRegistry()
+        {
+            add("Standard - Box", &createObject<StandardBoxObject>);
+            add("Standard - Ellipse", &createObject<StandardEllipseObject>);
+            add("Standard - Polygon", &createObject<StandardPolygonObject>);
+            add("Standard - Line", &createObject<StandardLineObject>);
+            add("Standard - Arc", &createObject<StandardArcObject>);
+            add("Standard - ZigZagLine", &createObject<ZigZagLineObject>);
+            add("Standard - PolyLine", &createObject<StandardPolyLineObject>);
+            add("Standard - BezierLine", &createObject<StandardBezierLineObject>);
+            add("Standard - Beziergon", &createObject<StandardBeziergonObject>);
+            add("Standard - Image", &createObject<StandardImageObject>);
+            add("Standard - Text", &createObject<StandardTextObject>);
+            add("Flowchart - Box", &createObject<FlowchartBoxObject>);
+            add("Flowchart - Parallelogram", &createObject<FlowchartParallelogramObject>);
+            add("Flowchart - Diamond", &createObject<FlowchartDiamondObject>);
+            add("Flowchart - Ellipse", &createObject<StandardEllipseObject>);
+            add("KAOS - goal", &createObject<KaosGoalObject>);
+        }
+        //A new object of the native type rType, or NULL if there isn't one
+        DiaObject* create(const rtl::OUString &rType) const
+        {
+            factories::const_iterator aI = maFactories.find(rType);
+            return aI != maFactories.end() ? (*aI->second)() : NULL;
+        }
+    };
+
+    struct theObjectRegistry : public rtl::Static<ObjectRegistry, theObjectRegistry> {};
+}
+
 void DiaImporter::handleObject(const uno::Reference<xml::dom::XElement> &rxElem, shapes &rShapes)
 {
     const uno::Reference<xml::dom::XNamedNodeMap> xAttributes = rxElem->getAttributes();
@@ -3438,40 +3653,8 @@ void DiaImporter::handleObject(const uno::Reference<xml::dom::XElement> &rxElem,
         return;
     }
 
-    diaobject diaobj;
-    if (sType == USTR("Standard - Box"))
-        diaobj.reset(new StandardBoxObject());
-    else if (sType == USTR("Standard - Ellipse"))
-        diaobj.reset(new StandardEllipseObject());
-    else if (sType == USTR("Standard - Polygon"))
-        diaobj.reset(new StandardPolygonObject());
-    else if (sType == USTR("Standard - Line"))
-        diaobj.reset(new StandardLineObject());
-    else if (sType == USTR("Standard - Arc"))
-        diaobj.reset(new StandardArcObject());
-    else if (sType == USTR("Standard - ZigZagLine"))
-        diaobj.reset(new ZigZagLineObject());
-    else if (sType == USTR("Standard - PolyLine"))
-        diaobj.reset(new StandardPolyLineObject());
-    else if (sType == USTR("Standard - BezierLine"))
-        diaobj.reset(new StandardBezierLineObject());
-    else if (sType == USTR("Standard - Beziergon"))
-        diaobj.reset(new StandardBeziergonObject());
-    else if (sType == USTR("Standard - Image"))
-        diaobj.reset(new StandardImageObject());
-    else if (sType == USTR("Standard - Text"))
-        diaobj.reset(new StandardTextObject());
-    else if (sType == USTR("Flowchart - Box"))
-        diaobj.reset(new FlowchartBoxObject());
-    else if (sType == USTR("Flowchart - Parallelogram"))
-        diaobj.reset(new FlowchartParallelogramObject());
-    else if (sType == USTR("Flowchart - Diamond"))
-        diaobj.reset(new FlowchartDiamondObject());
-    else if (sType == USTR("Flowchart - Ellipse"))
-        diaobj.reset(new StandardEllipseObject());
-    else if (sType == USTR("KAOS - goal"))
-        diaobj.reset(new KaosGoalObject());
-    else
+    diaobject diaobj(theObjectRegistry::get().create(sType));
+    if (!diaobj.get())
     {
         shapeimporter aTemplate = findCustomImporter(sType);
         if (aTemplate.get())
@@ -3485,8 +3668,25 @@ void DiaImporter::handleObject(const uno::Reference<xml::dom::XElement> &rxElem,
     }
 
     PropertyMap aProps = diaobj->import(rxElem, *this);
-    rShapes.push_back(shape(diaobj, aProps));
-    mapId[aProps[USTR("draw:id")]] = diaobj;
+    addShape(diaobj, aProps, rShapes);
+}
+
+void DiaImporter::addShape(const diaobject &rObj, const PropertyMap &rProps, shapes &rShapes)
+{
+    rShapes.push_back(shape(rObj, rProps));
+    PropertyMap::const_iterator aI = rProps.find("draw:id");
+    mapId[aI != rProps.end() ? aI->second : rtl::OUString()] = rObj;
+}
+
+//Measure all the text up front, so resizing and writing the shapes only
+//have to look up the results
+void DiaImporter::layoutText()
+{
+    TextLayouter aLayouter;
+    shapes::iterator aEnd = maShapes.end();
+    for (shapes::iterator aI = maShapes.begin(); aI != aEnd; ++aI)
+        aI->first->collectText(aLayouter);
+    aLayouter.measure(maTextStyles);
 }
 
 //DIA will resize shapes that are too narrow to contain their text,
@@ -3509,17 +3709,23 @@ void DiaImporter::adjustConnectionPoints()
 
 void DiaImporter::writeShapes()
 {
-    shapes::const_iterator aEnd = maShapes.end();
-    for (shapes::const_iterator aI = maShapes.begin(); aI != aEnd; ++aI)
+    shapes::iterator aEnd = maShapes.end();
+    for (shapes::iterator aI = maShapes.begin(); aI != aEnd; ++aI)
+    {
+        aI->first->formatGeometry(aI->second);
         aI->first->write(mxDocHandler, aI->second, *this);
+    }
 }
 
 //Somewhat against my better judgement, but lets expand the page in units of
 //the "real" page size in order to fit everything in
 void DiaImporter::adjustPageSize(PropertyMap &rPageProps)
 {
-    float fPageWidth = ::comphelper::string::searchAndReplaceAllAsciiWithAscii(rPageProps[USTR("fo:page-width")], "mm", "").toFloat();
-    float fPageHeight = ::comphelper::string::searchAndReplaceAllAsciiWithAscii(rPageProps[USTR("fo:page-height")], "mm", "").toFloat();
+    if (mfPageWidth <= 0 || mfPageHeight <= 0)
+        return;
+
+    double fPageWidth = mfPageWidth;
+    double fPageHeight = mfPageHeight;
 
     basegfx::B2DPolyPolygon aScene;
 
@@ -3531,17 +3737,14 @@ void DiaImporter::adjustPageSize(PropertyMap &rPageProps)
 
     double fMaxY = aSceneRange.getMaxY()*10;
     if (fPageHeight < fMaxY)
-    {
-        float fMul = ceilf(fMaxY / fPageHeight);
-        rPageProps[USTR("fo:page-height")] = rtl::OUString::number(fPageHeight*fMul)+USTR("mm");
-    }
+        fPageHeight *= ceil(fMaxY / fPageHeight);
 
     double fMaxX = aSceneRange.getMaxX()*10;
     if (fPageWidth < fMaxX)
-    {
-        float fMul = ceilf(fMaxX / fPageWidth);
-        rPageProps[USTR("fo:page-width")] = rtl::OUString::number(fPageWidth*fMul)+USTR("mm");
-    }
+        fPageWidth *= ceil(fMaxX / fPageWidth);
+
+    rPageProps["fo:page-width"] = formatNumber(fPageWidth, "mm");
+    rPageProps["fo:page-height"] = formatNumber(fPageHeight, "mm");
 }
 
 void DiaImporter::handleLayer(const uno::Reference<xml::dom::XElement> &rxElem)
@@ -3572,11 +3775,20 @@ public:
     virtual rtl::OUString outputtype() const { return USTR("draw:g"); }
     virtual void write(uno::Reference<xml::sax::XDocumentHandler> &rDocHandler, const PropertyMap &rProps, const DiaImporter &rImporter) const;
     virtual PropertyMap import(const uno::Reference<xml::dom::XElement> &rxElem, DiaImporter &rImporter);
+    virtual void collectText(TextLayouter &rLayouter);
     virtual void resizeIfNarrow(PropertyMap &rProps, const DiaImporter &rImporter);
+    virtual void formatGeometry(PropertyMap &rProps);
     virtual void adjustConnectionPoints(PropertyMap &rProps, const DiaImporter &rImporter);
     shapes &getShapes() { return maShapes; }
 };
 
+void GroupObject::collectText(TextLayouter &rLayouter)
+{
+    shapes::iterator aShapeEnd = maShapes.end();
+    for (shapes::iterator aI = maShapes.begin(); aI != aShapeEnd; ++aI)
+        aI->first->collectText(rLayouter);
+}
+
 void GroupObject::resizeIfNarrow(PropertyMap &rProps, const DiaImporter &rImporter)
 {
     shapes::iterator aShapeEnd = maShapes.end();
@@ -3584,6 +3796,13 @@ void GroupObject::resizeIfNarrow(PropertyMap &rProps, const DiaImporter &rImport
         aI->first->resizeIfNarrow(aI->second, rImporter);
 }
 
+void GroupObject::formatGeometry(PropertyMap &)
+{
+    shapes::iterator aShapeEnd = maShapes.end();
+    for (shapes::iterator aI = maShapes.begin(); aI != aShapeEnd; ++aI)
+        aI->first->formatGeometry(aI->second);
+}
+
 void GroupObject::adjustConnectionPoints(PropertyMap &rProps, const DiaImporter &rImporter)
 {
     shapes::iterator aShapeEnd = maShapes.end();
@@ -3605,7 +3824,7 @@ void GroupObject::write(uno::Reference<xml::sax::XDocumentHandler> &rDocHandler,
     }
 #endif
 
-    rDocHandler->startElement(outputtype(), new SaxAttrList(PropertyMap()));
+    rDocHandler->startElement(outputtype(), makeEmptyXAttribute());
 
     shapes::const_iterator aShapeEnd = maShapes.end();
     for (shapes::const_iterator aI = maShapes.begin(); aI != aShapeEnd; ++aI)
@@ -3642,36 +3861,263 @@ void DiaImporter::handleGroup(const uno::Reference<xml::dom::XElement> &rxElem,
     }
 
     PropertyMap aProps = diaobj->import(rxElem, *this);
-    rShapes.push_back(shape(diaobj, aProps));
-    mapId[aProps[USTR("draw:id")]] = diaobj;
+    addShape(diaobj, aProps, rShapes);
+}
+
+//Drives a DiaImporter from sax events, replacing the handleDiagram,
+//handleLayer and handleGroup walk over a full DOM. Only the diagramdata or
+//object currently being read is built up as a DOM fragment and handed on to
+//the existing element handlers, after which it is thrown away.
+class DiaStreamHandler : public cppu::WeakImplHelper1< xml::sax::XDocumentHandler >
+{
+private:
+    enum State { STATE_START, STATE_DIAGRAM, STATE_LAYER, STATE_DONE };
+
+    DiaImporter &mrImporter;
+    uno::Reference<xml::dom::XDocument> mxFragmentDoc;
+    State meState;
+    sal_Int32 mnSkipDepth;
+    bool mbConverted;
+
+    //Open groups of the current layer, innermost last
+    std::vector< boost::shared_ptr<GroupObject> > maGroups;
+    //Open elements of the current fragment, innermost last
+    std::vector< uno::Reference<xml::dom::XElement> > maFragment;
+    rtl::OUStringBuffer maCharacters;
+
+    static rtl::OUString getLocalName(const rtl::OUString &rName)
+    {
+        return rName.copy(rName.indexOf(':') + 1);
+    }
+    shapes &getCurrentShapes()
+    {
+        return maGroups.empty() ? mrImporter.getShapes() : maGroups.back()->getShapes();
+    }
+    void flushCharacters();
+    void startFragmentElement(const rtl::OUString &rName,
+        const uno::Reference<xml::sax::XAttributeList> &rxAttribs);
+    void endFragmentElement();
+    void skipElement(const rtl::OUString &rName);
+public:
+    DiaStreamHandler(DiaImporter &rImporter, const uno::Reference<xml::dom::XDocument> &rxFragmentDoc);
+    bool isConverted() const { return mbConverted; }
+
+    // XDocumentHandler
+    virtual void SAL_CALL startDocument();
+    virtual void SAL_CALL endDocument();
+    virtual void SAL_CALL startElement(const rtl::OUString &rName,
+        const uno::Reference<xml::sax::XAttributeList> &rxAttribs);
+    virtual void SAL_CALL endElement(const rtl::OUString &rName);
+    virtual void SAL_CALL characters(const rtl::OUString &rChars);
+    virtual void SAL_CALL ignorableWhitespace(const rtl::OUString &rWhitespaces);
+    virtual void SAL_CALL processingInstruction(const rtl::OUString &rTarget, const rtl::OUString &rData);
+    virtual void SAL_CALL setDocumentLocator(const uno::Reference<xml::sax::XLocator> &rxLocator);
+};
+
+DiaStreamHandler::DiaStreamHandler(DiaImporter &rImporter, const uno::Reference<xml::dom::XDocument> &rxFragmentDoc)
+    : mrImporter(rImporter)
+    , mxFragmentDoc(rxFragmentDoc)
+    , meState(STATE_START)
+    , mnSkipDepth(0)
+    , mbConverted(false)
+{
+}
+
+//Text is added as a single node, the same as the DOM builder does, so that
+//valueOfSimpleAttribute and friends find what they expect
+void DiaStreamHandler::flushCharacters()
+{
+    if (maCharacters.getLength())
+    {
+        uno::Reference<xml::dom::XNode> xText(mxFragmentDoc->createTextNode(maCharacters.makeStringAndClear()), uno::UNO_QUERY_THROW);
+        maFragment.back()->appendChild(xText);
+    }
+}
+
+void DiaStreamHandler::startFragmentElement(const rtl::OUString &rName,
+    const uno::Reference<xml::sax::XAttributeList> &rxAttribs)
+{
+    uno::Reference<xml::dom::XElement> xElem(mxFragmentDoc->createElement(getLocalName(rName)));
+
+    const sal_Int16 nAttribs = rxAttribs.is() ? rxAttribs->getLength() : 0;
+    for (sal_Int16 i = 0; i < nAttribs; ++i)
+        xElem->setAttribute(rxAttribs->getNameByIndex(i), rxAttribs->getValueByIndex(i));
+
+    if (!maFragment.empty())
+    {
+        flushCharacters();
+        uno::Reference<xml::dom::XNode> xNode(xElem, uno::UNO_QUERY_THROW);
+        maFragment.back()->appendChild(xNode);
+    }
+
+    maFragment.push_back(xElem);
+}
+
+void DiaStreamHandler::endFragmentElement()
+{
+    flushCharacters();
+
+    uno::Reference<xml::dom::XElement> xElem(maFragment.back());
+    maFragment.pop_back();
+    if (!maFragment.empty())
+        return;
+
+    //Completed the whole fragment
+    if (meState == STATE_DIAGRAM)
+        mrImporter.handleDiagramData(xElem);
+    else
+        mrImporter.handleObject(xElem, getCurrentShapes());
+}
+
+void DiaStreamHandler::skipElement(const rtl::OUString &rName)
+{
+    reportUnknownElement(getLocalName(rName));
+    mnSkipDepth = 1;
+}
+
+void SAL_CALL DiaStreamHandler::startDocument()
+{
+}
+
+void SAL_CALL DiaStreamHandler::endDocument()
+{
+}
+
+void SAL_CALL DiaStreamHandler::startElement(const rtl::OUString &rName,
+    const uno::Reference<xml::sax::XAttributeList> &rxAttribs)
+{
+    if (mnSkipDepth)
+    {
+        ++mnSkipDepth;
+        return;
+    }
+
+    if (!maFragment.empty())
+    {
+        startFragmentElement(rName, rxAttribs);
+        return;
+    }
+
+    rtl::OUString sName(getLocalName(rName));
+    switch (meState)
+    {
+        case STATE_START:
+            if (sName == USTR("diagram"))
+            {
+                mrImporter.beginDiagram();
+                meState = STATE_DIAGRAM;
+            }
+            else
+                skipElement(rName);
+            break;
+        case STATE_DIAGRAM:
+            if (sName == USTR("diagramdata"))
+                startFragmentElement(rName, rxAttribs);
+            else if (sName == USTR("layer"))
+                meState = STATE_LAYER;
+            else
+                skipElement(rName);
+            break;
+        case STATE_LAYER:
+            if (sName == USTR("object"))
+                startFragmentElement(rName, rxAttribs);
+            else if (sName == USTR("group"))
+                maGroups.push_back(boost::shared_ptr<GroupObject>(new GroupObject()));
+            else
+                skipElement(rName);
+            break;
+        case STATE_DONE:
+            skipElement(rName);
+            break;
+    }
+}
+
+void SAL_CALL DiaStreamHandler::endElement(const rtl::OUString &)
+{
+    if (mnSkipDepth)
+    {
+        --mnSkipDepth;
+        return;
+    }
+
+    if (!maFragment.empty())
+    {
+        endFragmentElement();
+        return;
+    }
+
+    switch (meState)
+    {
+        case STATE_LAYER:
+            if (!maGroups.empty())
+            {
+                diaobject diaobj(maGroups.back());
+                maGroups.pop_back();
+                PropertyMap aProps = diaobj->import(uno::Reference<xml::dom::XElement>(), mrImporter);
+                mrImporter.addShape(diaobj, aProps, getCurrentShapes());
+            }
+            else
+                meState = STATE_DIAGRAM;
+            break;
+        case STATE_DIAGRAM:
+            mrImporter.endDiagram();
+            mbConverted = true;
+            meState = STATE_DONE;
+            break;
+        default:
+            break;
+    }
+}
+
+void SAL_CALL DiaStreamHandler::characters(const rtl::OUString &rChars)
+{
+    if (!mnSkipDepth && !maFragment.empty())
+        maCharacters.append(rChars);
+}
+
+void SAL_CALL DiaStreamHandler::ignorableWhitespace(const rtl::OUString &)
+{
+}
+
+void SAL_CALL DiaStreamHandler::processingInstruction(const rtl::OUString &, const rtl::OUString &)
+{
+}
+
+void SAL_CALL DiaStreamHandler::setDocumentLocator(const uno::Reference<xml::sax::XLocator> &)
+{
 }
 
 void DiaImporter::writeResults()
 {
+    mbResultsWritten = true;
+
+    SaxAttrListPool aAttrLists;
+    SaxAttrListPool::Scope aAttrListScope(aAttrLists);
+
     mxDocHandler->startDocument();
 
     PropertyMap aAttrs;
 
-    aAttrs[USTR("xmlns:office")] = USTR(OASIS_STR "office:1.0");
-    aAttrs[USTR("xmlns:style")] = USTR(OASIS_STR "style:1.0");
-    aAttrs[USTR("xmlns:text")] = USTR(OASIS_STR "text:1.0");
-    aAttrs[USTR("xmlns:svg")] = USTR(OASIS_STR "svg-compatible:1.0");
-    aAttrs[USTR("xmlns:table")] = USTR(OASIS_STR "table:1.0");
-    aAttrs[USTR("xmlns:draw")] = USTR(OASIS_STR "drawing:1.0");
-    aAttrs[USTR("xmlns:fo")] = USTR(OASIS_STR "xsl-fo-compatible:1.0");
-    aAttrs[USTR("xmlns:xlink")] = USTR("http://www.w3.org/1999/xlink");
-    aAttrs[USTR("xmlns:dc")] = USTR("http://purl.org/dc/elements/1.1/");
-    aAttrs[USTR("xmlns:number")] = USTR(OASIS_STR "datastyle:1.0");
-    aAttrs[USTR("xmlns:presentation")] = USTR(OASIS_STR "presentation:1.0");
-    aAttrs[USTR("xmlns:math")] = USTR("http://www.w3.org/1998/Math/MathML");
-    aAttrs[USTR("xmlns:form")] = USTR(OASIS_STR "form:1.0");
-    aAttrs[USTR("xmlns:script")] = USTR(OASIS_STR "script:1.0");
-    aAttrs[USTR("xmlns:dom")] = USTR("http://www.w3.org/2001/xml-events");
-    aAttrs[USTR("xmlns:xforms")] = USTR("http://www.w3.org/2002/xforms");
-    aAttrs[USTR("xmlns:xsd")] = USTR("http://www.w3.org/2001/XMLSchema");
-    aAttrs[USTR("xmlns:xsi")] = USTR("http://www.w3.org/2001/XMLSchema-instance");
-    aAttrs[USTR("office:version")] = USTR("1.0");
-    aAttrs[USTR("office:mimetype")] = USTR("application/vnd.oasis.opendocument.graphics");
+    aAttrs["xmlns:office"] = USTR(OASIS_STR "office:1.0");
+    aAttrs["xmlns:style"] = USTR(OASIS_STR "style:1.0");
+    aAttrs["xmlns:text"] = USTR(OASIS_STR "text:1.0");
+    aAttrs["xmlns:svg"] = USTR(OASIS_STR "svg-compatible:1.0");
+    aAttrs["xmlns:table"] = USTR(OASIS_STR "table:1.0");
+    aAttrs["xmlns:draw"] = USTR(OASIS_STR "drawing:1.0");
+    aAttrs["xmlns:fo"] = USTR(OASIS_STR "xsl-fo-compatible:1.0");
+    aAttrs["xmlns:xlink"] = USTR("http://www.w3.org/1999/xlink");
+    aAttrs["xmlns:dc"] = USTR("http://purl.org/dc/elements/1.1/");
+    aAttrs["xmlns:number"] = USTR(OASIS_STR "datastyle:1.0");
+    aAttrs["xmlns:presentation"] = USTR(OASIS_STR "presentation:1.0");
+    aAttrs["xmlns:math"] = USTR("http://www.w3.org/1998/Math/MathML");
+    aAttrs["xmlns:form"] = USTR(OASIS_STR "form:1.0");
+    aAttrs["xmlns:script"] = USTR(OASIS_STR "script:1.0");
+    aAttrs["xmlns:dom"] = USTR("http://www.w3.org/2001/xml-events");
+    aAttrs["xmlns:xforms"] = USTR("http://www.w3.org/2002/xforms");
+    aAttrs["xmlns:xsd"] = USTR("http://www.w3.org/2001/XMLSchema");
+    aAttrs["xmlns:xsi"] = USTR("http://www.w3.org/2001/XMLSchema-instance");
+    aAttrs["office:version"] = USTR("1.0");
+    aAttrs["office:mimetype"] = USTR("application/vnd.oasis.opendocument.graphics");
 
     mxDocHandler->startElement(USTR("office:document"), makeXAttributeAndClear(aAttrs));
     mxDocHandler->startElement(USTR("office:styles"), uno::Reference<xml::sax::XAttributeList>());
@@ -3681,8 +4127,8 @@ void DiaImporter::writeResults()
         for (autostyles::const_iterator aI = maArrows.begin(); aI != aEnd; ++aI)
         {
             aAttrs = aI->second;
-            aAttrs[USTR("draw:name")] = aI->first;
-            aAttrs[USTR("draw:display-name")] = 
+            aAttrs["draw:name"] = aI->first;
+            aAttrs["draw:display-name"] = 
                 ::comphelper::string::searchAndReplaceAllAsciiWithAscii(aI->first, "_20_", " ");
             mxDocHandler->startElement(USTR("draw:marker"), makeXAttributeAndClear(aAttrs));
             mxDocHandler->endElement(USTR("draw:marker"));
@@ -3694,27 +4140,27 @@ void DiaImporter::writeResults()
         for (autostyles::const_iterator aI = maDashes.begin(); aI != aEnd; ++aI)
         {
             aAttrs = aI->second;
-            aAttrs[USTR("draw:name")] = aI->first;
-            aAttrs[USTR("draw:display-name")] = 
+            aAttrs["draw:name"] = aI->first;
+            aAttrs["draw:display-name"] = 
                 ::comphelper::string::searchAndReplaceAllAsciiWithAscii(aI->first, "_20_", " ");
             mxDocHandler->startElement(USTR("draw:stroke-dash"), makeXAttributeAndClear(aAttrs));
             mxDocHandler->endElement(USTR("draw:stroke-dash"));
         }
     }
 
-    aAttrs[USTR("style:name")] = USTR("standard");
-    aAttrs[USTR("style:family")] = USTR("graphic");
+    aAttrs["style:name"] = USTR("standard");
+    aAttrs["style:family"] = USTR("graphic");
     mxDocHandler->startElement(USTR("style:style"), makeXAttributeAndClear(aAttrs));
-    aAttrs[USTR("svg:stroke-width")] = USTR("0.10cm");
-    aAttrs[USTR("draw:fill-color")] = USTR("#ffffff");
-    aAttrs[USTR("draw:start-line-spacing-horizontal")] = USTR("0cm");
-    aAttrs[USTR("draw:start-line-spacing-vertical")] = USTR("0cm");
-    aAttrs[USTR("draw:end-line-spacing-horizontal")] = USTR("0cm");
-    aAttrs[USTR("draw:end-line-spacing-vertical")] = USTR("0cm");
+    aAttrs["svg:stroke-width"] = USTR("0.10cm");
+    aAttrs["draw:fill-color"] = USTR("#ffffff");
+    aAttrs["draw:start-line-spacing-horizontal"] = USTR("0cm");
+    aAttrs["draw:start-line-spacing-vertical"] = USTR("0cm");
+    aAttrs["draw:end-line-spacing-horizontal"] = USTR("0cm");
+    aAttrs["draw:end-line-spacing-vertical"] = USTR("0cm");
     mxDocHandler->startElement(USTR("style:graphic-properties"), makeXAttributeAndClear(aAttrs));
     mxDocHandler->endElement(USTR("style:graphic-properties"));
-    aAttrs[USTR("fo:language")] = USTR("zxx");
-    aAttrs[USTR("fo:country")] = USTR("none");
+    aAttrs["fo:language"] = USTR("zxx");
+    aAttrs["fo:country"] = USTR("none");
     mxDocHandler->startElement(USTR("style:text-properties"), makeXAttributeAndClear(aAttrs));
     mxDocHandler->endElement(USTR("style:text-properties"));
     mxDocHandler->endElement(USTR("style:style"));
@@ -3723,19 +4169,19 @@ void DiaImporter::writeResults()
     mxDocHandler->startElement(USTR("office:automatic-styles"), uno::Reference<xml::sax::XAttributeList>());
     if (page_layout_properties.get())
     {
-        aAttrs[USTR("style:name")] = USTR("pagelayout1");
+        aAttrs["style:name"] = USTR("pagelayout1");
         mxDocHandler->startElement(USTR("style:page-layout"), makeXAttributeAndClear(aAttrs));
         adjustPageSize(page_layout_properties->second);
-        mxDocHandler->startElement(USTR("style:page-layout-properties"), new SaxAttrList(page_layout_properties->second));
+        mxDocHandler->startElement(USTR("style:page-layout-properties"), makeXAttribute(page_layout_properties->second));
         mxDocHandler->endElement(USTR("style:page-layout-properties"));
         mxDocHandler->endElement(USTR("style:page-layout"));
     }
     if (drawing_page_properties.get())
     {
-        aAttrs[USTR( "style:name")] = USTR("pagestyle1");
-        aAttrs[USTR( "style:family")] = USTR("drawing-page");
+        aAttrs["style:name"] = USTR("pagestyle1");
+        aAttrs["style:family"] = USTR("drawing-page");
         mxDocHandler->startElement(USTR("style:style"), makeXAttributeAndClear(aAttrs));
-        mxDocHandler->startElement(USTR("style:drawing-page-properties"), new SaxAttrList(drawing_page_properties->second));
+        mxDocHandler->startElement(USTR("style:drawing-page-properties"), makeXAttribute(drawing_page_properties->second));
         mxDocHandler->endElement(USTR("style:drawing-page-properties"));
         mxDocHandler->endElement(USTR("style:style"));
     }
@@ -3747,11 +4193,11 @@ void DiaImporter::writeResults()
     mxDocHandler->endElement( USTR("office:automatic-styles") );
 
     mxDocHandler->startElement( USTR("office:master-styles"), uno::Reference<xml::sax::XAttributeList>());
-    aAttrs[USTR( "style:name")] = USTR("Default");
+    aAttrs["style:name"] = USTR("Default");
     if (page_layout_properties.get())
-        aAttrs[USTR( "style:page-layout-name")] = USTR("pagelayout1");
+        aAttrs["style:page-layout-name"] = USTR("pagelayout1");
     if (drawing_page_properties.get())
-        aAttrs[USTR( "draw:style-name")] = USTR("pagestyle1");
+        aAttrs["draw:style-name"] = USTR("pagestyle1");
     mxDocHandler->startElement(USTR("style:master-page"), makeXAttributeAndClear(aAttrs));
     mxDocHandler->endElement(USTR("style:master-page"));
     mxDocHandler->endElement(USTR("office:master-styles"));
@@ -3759,11 +4205,13 @@ void DiaImporter::writeResults()
     mxDocHandler->startElement(USTR("office:body"), uno::Reference<xml::sax::XAttributeList>());
     mxDocHandler->startElement(USTR("office:drawing"), uno::Reference<xml::sax::XAttributeList>());
 
-    aAttrs[USTR("draw:master-page-name")] = USTR("Default");
+    aAttrs["draw:master-page-name"] = USTR("Default");
     if (drawing_page_properties.get())
-        aAttrs[USTR("draw:style-name")] = USTR("pagestyle1");
+        aAttrs["draw:style-name"] = USTR("pagestyle1");
     mxDocHandler->startElement(USTR("draw:page"), makeXAttributeAndClear(aAttrs));
 
+    layoutText();
+
     resizeNarrowShapes();
 
     adjustConnectionPoints();
@@ -3778,6 +4226,22 @@ void DiaImporter::writeResults()
     mxDocHandler->endDocument();  
 }
 
+void DiaImporter::beginDiagram()
+{
+    addDash(USTR("DIA_20_Dashed"), makeDash(1));
+    addDash(USTR("DIA_20_Dash_20_Dot"), makeDashDot(1));
+    addDash(USTR("DIA_20_Dash_20_Dot_20_Dot"), makeDashDotDot(1));
+    addDash(USTR("DIA_20_Dotted"), makeDot(1));
+
+    for (int i = 2; i < 34; ++i)
+        maArrows.push_back(autostyle(GetArrowName(i), makeArrow(i)));
+}
+
+void DiaImporter::endDiagram()
+{
+    writeResults();
+}
+
 bool DiaImporter::handleDiagram(const uno::Reference<xml::dom::XElement> &rxElem)
 {
     //Get Page Layout and Drawing Page styles
@@ -3791,13 +4255,7 @@ bool DiaImporter::handleDiagram(const uno::Reference<xml::dom::XElement> &rxElem
         }
     }
 
-    maDashes.push_back(autostyle(USTR("DIA_20_Dashed"), makeDash(1)));
-    maDashes.push_back(autostyle(USTR("DIA_20_Dash_20_Dot"), makeDashDot(1)));
-    maDashes.push_back(autostyle(USTR("DIA_20_Dash_20_Dot_20_Dot"), makeDashDotDot(1)));
-    maDashes.push_back(autostyle(USTR("DIA_20_Dotted"), makeDot(1)));
-
-    for (int i = 2; i < 34; ++i)
-        maArrows.push_back(autostyle(GetArrowName(i), makeArrow(i)));
+    beginDiagram();
 
     //Collect shapes and their required Auto-Styles
     {
@@ -3810,7 +4268,7 @@ bool DiaImporter::handleDiagram(const uno::Reference<xml::dom::XElement> &rxElem
         }
     }
 
-    writeResults();
+    endDiagram();
 
     //Just check if there's anything we don't know about
     uno::Reference<xml::dom::XNodeList> xChildren( rxElem->getChildNodes() );
@@ -3832,16 +4290,34 @@ bool DiaImporter::handleDiagram(const uno::Reference<xml::dom::XElement> &rxElem
     return true;
 }
 
-bool DiaImporter::convert()
+bool DiaImporter::convert(const uno::Reference<xml::dom::XElement> &rxDocElem)
 {
     bool bOk = false;
-    if (mxDocElem->getTagName() == USTR("diagram"))
-        bOk = handleDiagram(mxDocElem);
+    if (rxDocElem->getTagName() == USTR("diagram"))
+        bOk = handleDiagram(rxDocElem);
     else
-        reportUnknownElement(mxDocElem);
+        reportUnknownElement(rxDocElem);
     return bOk;
 }
 
+bool DiaImporter::convert(const uno::Reference<xml::sax::XParser> &rxParser,
+    const uno::Reference<io::XInputStream> &rxInputStream)
+{
+    uno::Reference<xml::dom::XDocumentBuilder> xDomBuilder(
+        mxMSF->createInstance( USTR("com.sun.star.xml.dom.DocumentBuilder") ), uno::UNO_QUERY_THROW );
+
+    DiaStreamHandler *pHandler = new DiaStreamHandler(*this, xDomBuilder->newDocument());
+    uno::Reference<xml::sax::XDocumentHandler> xHandler(pHandler);
+
+    xml::sax::InputSource aInputSource;
+    aInputSource.aInputStream = rxInputStream;
+
+    rxParser->setDocumentHandler(xHandler);
+    rxParser->parseStream(aInputSource);
+
+    return pHandler->isConverted();
+}
+
 ::rtl::OUString DIAFilter::getInstallPath()
 {
     if (msInstallDir.getLength() == 0)
@@ -3868,52 +4344,151 @@ bool DiaImporter::convert()
 }
 
 
+namespace
+{
+    //Map local files rather than reading them through rxInputStream, as
+    //long as the mapping looks to be of the same file
+    uno::Reference< io::XInputStream > mapLocalFile(const rtl::OUString &rURL,
+        const uno::Reference< io::XSeekable > &rxSeekable)
+    {
+        uno::Reference< io::XInputStream > xRet;
+        if (!rxSeekable.is() || !rURL.matchIgnoreAsciiCaseAsciiL(RTL_CONSTASCII_STRINGPARAM("file://")))
+            return xRet;
+
+        boost::shared_ptr< MappedFile > pFile(new MappedFile(rURL));
+        if (pFile->is() && rxSeekable->getPosition() == 0 &&
+            rxSeekable->getLength() == static_cast<sal_Int64>(pFile->getSize()))
+        {
+            xRet = new mem_InputStream(pFile->getData(), pFile->getSize(), pFile);
+        }
+        return xRet;
+    }
+
+    //.dia files are usually gzipped, but not always. With bPipelined inflate
+    //on a thread of its own while the caller parses rather than all at once
+    uno::Reference< io::XInputStream > openDiaStream(const uno::Reference< io::XInputStream > &rxInputStream,
+        const uno::Reference< io::XSeekable > &rxSeekable, sal_Int64 nPos, bool bPipelined)
+    {
+        //Local files can be inflated all at once
+        if (rxSeekable.is() && !bPipelined)
+        {
+            try
+            {
+                uno::Reference< io::XInputStream > xInflated(inflateGzStream(rxInputStream, rxSeekable));
+                if (xInflated.is())
+                    return xInflated;
+            }
+            catch(...)
+            {
+            }
+            rxSeekable->seek(nPos);
+        }
+
+        try
+        {
+            uno::Reference< io::XInputStream > xInflated(new gz_InputStream(rxInputStream));
+            if (bPipelined)
+            {
+                readahead_InputStream *pReadahead = new readahead_InputStream(xInflated);
+                uno::Reference< io::XInputStream > xReadahead(pReadahead);
+                if (pReadahead->start())
+                    return xReadahead;
+            }
+            return xInflated;
+        }
+        catch(...)
+        {
+            if (rxSeekable.is())
+                rxSeekable->seek(nPos);
+        }
+        return rxInputStream;
+    }
+}
+
 sal_Bool SAL_CALL DIAFilter::filter( const uno::Sequence< beans::PropertyValue >& rDescriptor )
 {
     if (!mxDstDoc.is())
         return sal_False;
 
     uno::Reference< io::XInputStream > xInputStream;
+    rtl::OUString sFilterOptions;
+    rtl::OUString sURL;
     const sal_Int32 nLength = rDescriptor.getLength();
     const beans::PropertyValue* pAttribs = rDescriptor.getConstArray();
     for ( sal_Int32 i=0 ; i<nLength; ++i, ++pAttribs )
     {   
         if( pAttribs->Name.equalsAscii( "InputStream" ) )
             pAttribs->Value >>= xInputStream;
+        else if( pAttribs->Name.equalsAscii( "FilterOptions" ) )
+            pAttribs->Value >>= sFilterOptions;
+        else if( pAttribs->Name.equalsAscii( "URL" ) )
+            pAttribs->Value >>= sURL;
     }   
     if (!xInputStream.is())
         return sal_False;
 
+    //For batch conversion, e.g. --infilter="DIA:BuiltinFontMetrics", measure
+    //text with the builtin metrics instead of the installed fonts
+    bool bBuiltinFontMetrics =
+        sFilterOptions.indexOfAsciiL(RTL_CONSTASCII_STRINGPARAM("BuiltinFontMetrics")) != -1;
+    //For very large compressed diagrams inflate and parse side by side
+    bool bPipelined =
+        sFilterOptions.indexOfAsciiL(RTL_CONSTASCII_STRINGPARAM("PipelinedInflate")) != -1;
+
     uno::Reference < xml::sax::XDocumentHandler > xDocHandler(
         mxMSF->createInstance( USTR("com.sun.star.comp.Draw.XMLOasisImporter") ), uno::UNO_QUERY_THROW );
 
     uno::Reference < XImporter > xImporter(xDocHandler, uno::UNO_QUERY_THROW);
     xImporter->setTargetDocument(mxDstDoc);
 
-    uno::Reference<xml::dom::XDocumentBuilder> xDomBuilder(
-        mxMSF->createInstance( USTR("com.sun.star.xml.dom.DocumentBuilder") ), uno::UNO_QUERY_THROW );
-
     sal_Int64 nPos = 0;
     uno::Reference< io::XSeekable > xSeekable( xInputStream, uno::UNO_QUERY );
-    if (xSeekable.is())
-       nPos = xSeekable->getPosition();
-    try
+    uno::Reference< io::XInputStream > xMapped(mapLocalFile(sURL, xSeekable));
+    if (xMapped.is())
     {
-        uno::Reference< io::XInputStream > xTmpInputStream(new gz_InputStream(xInputStream));
-        xInputStream = xTmpInputStream;
+        xInputStream = xMapped;
+        xSeekable = uno::Reference< io::XSeekable >(xInputStream, uno::UNO_QUERY);
     }
-    catch(...)
+    if (xSeekable.is())
+       nPos = xSeekable->getPosition();
+
+    uno::Reference< io::XInputStream > xDiaStream(openDiaStream(xInputStream, xSeekable, nPos, bPipelined));
+
+    //Prefer streaming the diagram straight into the importer, but fall back
+    //to the DOM if there's no sax parser, or if the streaming import fails
+    //before anything has been written and we can rewind to try again
+    uno::Reference<xml::sax::XParser> xParser(
+        mxMSF->createInstance( USTR("com.sun.star.xml.sax.Parser") ), uno::UNO_QUERY );
+    if (xParser.is())
     {
-        if (xSeekable.is())
-            xSeekable->seek(nPos);
+        DiaImporter aImporter(mxCtx, mxMSF, xDocHandler, getInstallPath(), bBuiltinFontMetrics);
+        try
+        {
+            return aImporter.convert(xParser, xDiaStream);
+        }
+        catch (const uno::Exception &rException)
+        {
+            if (aImporter.hasWrittenResults() || !xSeekable.is())
+                throw;
+            fprintf(stderr, "streaming import failed: %s, retrying\n",
+                rtl::OUStringToOString(rException.Message, RTL_TEXTENCODING_UTF8).getStr());
+        }
+        //Stop any reading ahead from xInputStream before rewinding it
+        if (xDiaStream != xInputStream)
+            xDiaStream->closeInput();
+        xSeekable->seek(nPos);
+        xDiaStream = openDiaStream(xInputStream, xSeekable, nPos, bPipelined);
     }
 
-    uno::Reference<xml::dom::XDocument> xDom( xDomBuilder->parse(xInputStream), uno::UNO_QUERY_THROW );
+    uno::Reference<xml::dom::XDocumentBuilder> xDomBuilder(
+        mxMSF->createInstance( USTR("com.sun.star.xml.dom.DocumentBuilder") ), uno::UNO_QUERY_THROW );
+
+    uno::Reference<xml::dom::XDocument> xDom( xDomBuilder->parse(xDiaStream), uno::UNO_QUERY_THROW );
 
     uno::Reference<xml::dom::XElement> xDocElem( xDom->getDocumentElement(), uno::UNO_QUERY_THROW );
 
-    DiaImporter aImporter(mxCtx, mxMSF, xDocHandler, xDocElem, getInstallPath());
-    return aImporter.convert();
+    DiaImporter aImporter(mxCtx, mxMSF, xDocHandler, getInstallPath(), bBuiltinFontMetrics);
+    return aImporter.convert(xDocElem);
 }
 
 void SAL_CALL DIAFilter::setTargetDocument( const uno::Reference< lang::XComponent >& xDoc )
@@ -3936,36 +4511,13 @@ rtl::OUString SAL_CALL DIAFilter::detect( uno::Sequence< beans::PropertyValue >&
     if (!xInputStream.is())
         return rtl::OUString();
 
-    sal_Int64 nPos = 0;
-    uno::Reference< io::XSeekable > xSeekable( xInputStream, uno::UNO_QUERY );
-
     try
     {
-        if (xSeekable.is())
-           nPos = xSeekable->getPosition();
-
-        try
-        {
-            uno::Reference< io::XInputStream > xTmpInputStream(new gz_InputStream(xInputStream));
-            xInputStream = xTmpInputStream;
-        }
-        catch(...)
-        {
-            if (xSeekable.is())
-                xSeekable->seek(nPos);
-        }
-
         rtl::OUString sRet;
 
-        uno::Sequence<sal_Int8> aData(64);
-        sal_Int32 nLen = xInputStream->readBytes(aData, 64);
-        rtl::OString aTmp(reinterpret_cast<const sal_Char*>(aData.getArray()), nLen);
-        if (aTmp.indexOf(rtl::OString(RTL_CONSTASCII_STRINGPARAM("<dia:diagram "))) != -1)
+        if (peekContent(xInputStream).indexOf(rtl::OString(RTL_CONSTASCII_STRINGPARAM("<dia:diagram "))) != -1)
             sRet = rtl::OUString(RTL_CONSTASCII_USTRINGPARAM("dia_DIA"));
 
-        if (xSeekable.is())
-            xSeekable->seek(nPos);
-
         return sRet;
     }
     catch (io::IOException const&)
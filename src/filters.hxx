@@ -27,8 +27,15 @@
 #include <com/sun/star/xml/sax/XDocumentHandler.hpp>
 #include <com/sun/star/io/XInputStream.hpp>
 #include <cppuhelper/implbase4.hxx>
+#include <basegfx/point/b2dpoint.hxx>
+#include <basegfx/range/b2drange.hxx>
 #include <boost/unordered_map.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <vector>
+#include "propertymap.hxx"
+#include "numberformat.hxx"
 #include "saxattrlist.hxx"
+#include "fontmetrics.hxx"
 
 using namespace ::com::sun::star;
 
@@ -69,7 +76,6 @@ private:
     rtl::OUString getInstallPath();
 };
 
-typedef boost::unordered_map< rtl::OUString, rtl::OUString, rtl::OUStringHash > PropertyMap;
 typedef std::pair< rtl::OUString, PropertyMap > autostyle;
 typedef std::vector< autostyle > autostyles;
 
@@ -77,15 +83,26 @@ struct ParaTextStyle
 {
     PropertyMap maTextAttrs;
     PropertyMap maParaAttrs;
+    bool operator==(const ParaTextStyle &rOther) const
+    {
+        return maTextAttrs == rOther.maTextAttrs && maParaAttrs == rOther.maParaAttrs;
+    }
 };
 
 typedef std::pair< rtl::OUString, ParaTextStyle  > extendedautostyle;
 typedef std::vector< extendedautostyle > extendedautostyles;
 
+//Positions of styles in an autostyles or extendedautostyles, by style hash
+typedef boost::unordered_multimap< size_t, size_t > styleindex;
+//Positions of styles in an autostyles or extendedautostyles, by style name
+typedef boost::unordered_map< rtl::OUString, size_t, rtl::OUStringHash > stylenameindex;
+
 class GraphicStyleManager
 {
 private:
     autostyles maGraphicStyles;
+    styleindex maStyleIndex;
+    stylenameindex maNameIndex;
     void addTextBoxStyle();
 public:
     GraphicStyleManager()
@@ -102,16 +119,22 @@ class TextStyleManager
 {
 private:
     extendedautostyles maTextStyles;
-    uno::Reference< awt::XDevice > mxReferenceDevice;
+    styleindex maStyleIndex;
+    stylenameindex maNameIndex;
+    boost::scoped_ptr< FontMetricsProvider > mpFontMetrics;
+
     void fixFontSizes(PropertyMap &rStyleAttrs);
 public:
-    void makeReferenceDevice(uno::Reference< uno::XComponentContext > xCtx);
+    //Takes ownership of pFontMetrics
+    void setFontMetrics(FontMetricsProvider *pFontMetrics) { mpFontMetrics.reset(pFontMetrics); }
     void addAutomaticTextStyle(PropertyMap &rAttrs, ParaTextStyle &rStyleAttrs);
     void write(uno::Reference < xml::sax::XDocumentHandler > xDocHandler);
     const PropertyMap *getStyleByName(const rtl::OUString &rName) const;
-    double getStringWidth(const rtl::OUString &rStyleName, const rtl::OUString &rString) const;
+    //Widths in cm of each of rStrings in the rStyleAttrs text style
+    void getStringWidths(const PropertyMap &rStyleAttrs, const std::vector< rtl::OUString > &rStrings,
+        std::vector< double > &rWidths) const;
     awt::FontDescriptor getFontDescriptor(const PropertyMap &rStyleAttrs) const;
-    uno::Reference< awt::XFont > getMatchingFont(const PropertyMap &rStyleAttrs) const;
+    FontMetric getFontMetric(const PropertyMap &rStyleAttrs) const;
 };
 
 class ShapeTemplate;
@@ -156,13 +179,28 @@ private:
 #define OASIS_STR "urn:oasis:names:tc:opendocument:xmlns:"
 
 using pdfi::SaxAttrList;
-SaxAttrList *makeXAttribute(const PropertyMap &rAttrs);
-SaxAttrList *makeXAttributeAndClear(PropertyMap &rProps);
+using pdfi::SaxAttrListPool;
+//Attribute lists for startElement, drawn from the current SaxAttrListPool if
+//there is one. Those from makeXAttribute refer to rAttrs rather than copying
+//it, so it has to stay alive and unchanged until the matching endElement.
+//xmloff reads a draw:frame's attributes again when its child starts, so don't
+//reuse the map of a frame for its text-box or image
+uno::Reference< xml::sax::XAttributeList > makeXAttribute(const PropertyMap &rAttrs);
+//Takes over the contents of rProps, so rProps can be reused straight away
+uno::Reference< xml::sax::XAttributeList > makeXAttributeAndClear(PropertyMap &rProps);
+uno::Reference< xml::sax::XAttributeList > makeEmptyXAttribute();
+//As makeXAttribute, for attributes spread over nLayers maps where a name in
+//an earlier map overrides the same name in a later one. The maps are read
+//through in place instead of being merged, so the same goes for all of them
+//and for the ppLayers array
+uno::Reference< xml::sax::XAttributeList > makeXAttribute(const PropertyMap * const *ppLayers, size_t nLayers);
 
 void createViewportAndPolygonFromPoints(const rtl::OUString &rPoints, PropertyMap &rAttrs, bool bClose=false);
 void createViewportAndPathFromPath(const rtl::OUString &rPath, PropertyMap &rAttrs);
-void createViewportFromPoints(const rtl::OUString &rPath, PropertyMap &rAttrs, float fAdjustX, float fAdjustY);
+//Sets the svg:viewBox for rPoints and returns the area they cover, in cm
+basegfx::B2DRange createViewportFromPoints(const std::vector< basegfx::B2DPoint > &rPoints, PropertyMap &rAttrs,
+    double fAdjustX, double fAdjustY);
 void writeText(uno::Reference<xml::sax::XDocumentHandler> &rDocHandler,
-    const PropertyMap &rTextProps, const rtl::OUString &rString);
+    const PropertyMap &rTextProps, const std::vector< rtl::OUString > &rLines);
 
 /* vi:set tabstop=4 shiftwidth=4 expandtab: */
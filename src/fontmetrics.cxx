@@ -0,0 +1,326 @@
+/*************************************************************************
+ *
+ * Caolán McNamara
+ * Copyright 2010 by Red Hat, Inc. 
+ *
+ * openoffice.org-diafilter is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 3 or
+ * later, as published by the Free Software Foundation.
+ *
+ * openoffice.org-diafilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ *
+ * You should have received a copy of the GNU General Public License version 3
+ * along with openoffice.org-diafilter.  If not, see
+ * <http://www.gnu.org/copyleft/gpl.html> for a copy of the GPLv3 License.
+ *
+ ************************************************************************/
+
+
+
+#include <com/sun/star/awt/FontSlant.hpp>
+#include <com/sun/star/awt/FontWeight.hpp>
+#include <com/sun/star/awt/SimpleFontMetric.hpp>
+#include <com/sun/star/awt/XDevice.hpp>
+#include <com/sun/star/awt/XFont.hpp>
+#include <rtl/ustrbuf.hxx>
+#include <boost/scoped_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "fontmetrics.hxx"
+#include "referencedevice.hxx"
+
+#include <stdio.h>
+
+using namespace com::sun::star;
+
+namespace
+{
+    //Advance widths per 1000 units of the em for U+0020 to U+007E, from the
+    //Adobe AFMs of the standard 14 fonts. ' and ` are the upright quotesingle
+    //and grave rather than the curly quotes of StandardEncoding
+    const sal_uInt16 aHelvetica[] =
+    {
+        278, 278, 355, 556, 556, 889, 667, 191, 333, 333, 389, 584, 278, 333, 278, 278,
+        556, 556, 556, 556, 556, 556, 556, 556, 556, 556, 278, 278, 584, 584, 584, 556,
+        1015, 667, 667, 722, 722, 667, 611, 778, 722, 278, 500, 667, 556, 833, 722, 778,
+        667, 778, 722, 667, 611, 722, 667, 944, 667, 667, 611, 278, 278, 278, 469, 556,
+        333, 556, 556, 500, 556, 556, 278, 556, 556, 222, 222, 500, 222, 833, 556, 556,
+        556, 556, 333, 500, 278, 556, 500, 722, 500, 500, 500, 334, 260, 334, 584
+    };
+
+    const sal_uInt16 aHelveticaBold[] =
+    {
+        278, 333, 474, 556, 556, 889, 722, 238, 333, 333, 389, 584, 278, 333, 278, 278,
+        556, 556, 556, 556, 556, 556, 556, 556, 556, 556, 333, 333, 584, 584, 584, 611,
+        975, 722, 722, 722, 722, 667, 611, 778, 722, 278, 556, 722, 611, 833, 722, 778,
+        667, 778, 722, 667, 611, 722, 667, 944, 667, 667, 611, 333, 278, 333, 584, 556,
+        333, 556, 611, 556, 611, 556, 333, 611, 611, 278, 278, 556, 278, 889, 611, 611,
+        611, 611, 389, 556, 333, 611, 556, 778, 556, 556, 500, 389, 280, 389, 584
+    };
+
+    const sal_uInt16 aTimes[] =
+    {
+        250, 333, 408, 500, 500, 833, 778, 180, 333, 333, 500, 564, 250, 333, 250, 278,
+        500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 278, 278, 564, 564, 564, 444,
+        921, 722, 667, 667, 722, 611, 556, 722, 722, 333, 389, 722, 611, 889, 722, 722,
+        556, 722, 667, 556, 611, 722, 722, 944, 722, 722, 611, 333, 278, 333, 469, 500,
+        333, 444, 500, 444, 500, 444, 333, 500, 500, 278, 278, 500, 278, 778, 500, 500,
+        500, 500, 333, 389, 278, 500, 500, 722, 500, 500, 444, 480, 200, 480, 541
+    };
+
+    const sal_uInt16 aTimesBold[] =
+    {
+        250, 333, 555, 500, 500, 1000, 833, 278, 333, 333, 500, 570, 250, 333, 250, 278,
+        500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 333, 333, 570, 570, 570, 500,
+        930, 722, 667, 722, 722, 667, 611, 778, 778, 389, 500, 778, 667, 944, 722, 778,
+        611, 778, 722, 556, 667, 722, 722, 1000, 722, 722, 667, 333, 278, 333, 581, 500,
+        333, 500, 556, 444, 556, 444, 333, 500, 556, 278, 333, 556, 278, 833, 556, 500,
+        556, 556, 444, 389, 333, 556, 500, 722, 500, 500, 444, 394, 220, 394, 520
+    };
+
+    const sal_uInt16 aTimesItalic[] =
+    {
+        250, 333, 420, 500, 500, 833, 778, 214, 333, 333, 500, 675, 250, 333, 250, 278,
+        500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 333, 333, 675, 675, 675, 500,
+        920, 611, 611, 667, 722, 611, 611, 722, 722, 333, 444, 667, 556, 833, 667, 722,
+        611, 722, 611, 500, 556, 722, 611, 833, 611, 556, 556, 389, 278, 389, 422, 500,
+        333, 500, 500, 444, 500, 444, 278, 500, 500, 278, 278, 444, 278, 722, 500, 500,
+        500, 500, 389, 389, 278, 500, 444, 667, 444, 444, 389, 400, 275, 400, 541
+    };
+
+    const sal_uInt16 aTimesBoldItalic[] =
+    {
+        250, 389, 555, 500, 500, 833, 778, 278, 333, 333, 500, 570, 250, 333, 250, 278,
+        500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 333, 333, 570, 570, 570, 500,
+        832, 667, 667, 667, 722, 667, 667, 722, 778, 389, 500, 667, 611, 889, 722, 722,
+        611, 722, 667, 556, 611, 722, 667, 889, 667, 611, 611, 333, 278, 333, 570, 500,
+        333, 500, 500, 444, 500, 444, 333, 500, 556, 278, 278, 500, 278, 778, 556, 500,
+        500, 500, 389, 389, 278, 556, 444, 667, 500, 444, 389, 348, 220, 348, 570
+    };
+
+    //The vertical metrics are those of the metric compatible Liberation
+    //fonts which usually stand in for these, with the leading being the
+    //internal leading as the reference device reports it
+    struct BuiltinFace
+    {
+        const sal_uInt16 *mpWidths; //or NULL if fixed pitch
+        sal_uInt16 mnFixedWidth;
+        sal_uInt16 mnAscent;
+        sal_uInt16 mnDescent;
+    };
+
+    const BuiltinFace aSans[] =
+    {
+        { aHelvetica, 0, 905, 212 },
+        { aHelveticaBold, 0, 905, 212 },
+        { aHelvetica, 0, 905, 212 },
+        { aHelveticaBold, 0, 905, 212 }
+    };
+
+    const BuiltinFace aSerif[] =
+    {
+        { aTimes, 0, 891, 216 },
+        { aTimesBold, 0, 891, 216 },
+        { aTimesItalic, 0, 891, 216 },
+        { aTimesBoldItalic, 0, 891, 216 }
+    };
+
+    const BuiltinFace aMonospace[] =
+    {
+        { NULL, 600, 833, 300 },
+        { NULL, 600, 833, 300 },
+        { NULL, 600, 833, 300 },
+        { NULL, 600, 833, 300 }
+    };
+
+    bool containsAny(const rtl::OUString &rName, const char * const *ppNames)
+    {
+        for (; *ppNames; ++ppNames)
+        {
+            if (rName.indexOfAsciiL(*ppNames, rtl_str_getLength(*ppNames)) != -1)
+                return true;
+        }
+        return false;
+    }
+
+    const BuiltinFace &findBuiltinFace(const awt::FontDescriptor &rFD)
+    {
+        static const char * const aMonospaceNames[] =
+        {
+            "mono", "courier", "console", "fixed", "typewriter", NULL
+        };
+        static const char * const aSerifNames[] =
+        {
+            "serif", "times", "roman", "georgia", "century", "palatino",
+            "bookman", "schoolbook", "garamond", "cambria", NULL
+        };
+
+        rtl::OUString sName(rFD.Name.toAsciiLowerCase());
+
+        const BuiltinFace *pFamily = aSans;
+        if (containsAny(sName, aMonospaceNames))
+            pFamily = aMonospace;
+        //"sans-serif" is sans
+        else if (sName.indexOfAsciiL(RTL_CONSTASCII_STRINGPARAM("sans")) == -1 &&
+            containsAny(sName, aSerifNames))
+        {
+            pFamily = aSerif;
+        }
+
+        int nStyle = 0;
+        if (rFD.Weight > awt::FontWeight::NORMAL)
+            nStyle |= 1;
+        if (rFD.Slant == awt::FontSlant_ITALIC || rFD.Slant == awt::FontSlant_OBLIQUE)
+            nStyle |= 2;
+        return pFamily[nStyle];
+    }
+
+    bool isWide(sal_Unicode c)
+    {
+        return (c >= 0x1100 && c <= 0x115F) || (c >= 0x2E80 && c <= 0xA4CF) ||
+            (c >= 0xAC00 && c <= 0xD7A3) || (c >= 0xF900 && c <= 0xFAFF) ||
+            (c >= 0xFF00 && c <= 0xFF60) || (c >= 0xFFE0 && c <= 0xFFE6) ||
+            (c >= 0xD800 && c <= 0xDBFF);
+    }
+
+    class BuiltinFontMetrics : public FontMetricsProvider
+    {
+    public:
+        virtual FontMetric getFontMetric(const awt::FontDescriptor &rFD)
+        {
+            const BuiltinFace &rFace = findBuiltinFace(rFD);
+            FontMetric aMetric;
+            aMetric.mfAscent = rFD.Height * rFace.mnAscent / 1000.0;
+            aMetric.mfDescent = rFD.Height * rFace.mnDescent / 1000.0;
+            aMetric.mfLeading = rFD.Height * (rFace.mnAscent + rFace.mnDescent - 1000) / 1000.0;
+            return aMetric;
+        }
+
+        virtual double getStringWidth(const awt::FontDescriptor &rFD, const rtl::OUString &rString)
+        {
+            const BuiltinFace &rFace = findBuiltinFace(rFD);
+            //Anything else outside the table gets the width of an 'n'
+            sal_uInt16 nDefault = rFace.mpWidths ? rFace.mpWidths['n' - 0x20] : rFace.mnFixedWidth;
+
+            sal_Int32 nUnits = 0;
+            const sal_Unicode *pStr = rString.getStr();
+            const sal_Unicode *pEnd = pStr + rString.getLength();
+            for (; pStr < pEnd; ++pStr)
+            {
+                sal_Unicode c = *pStr;
+                if (c < 0x20 || (c >= 0xDC00 && c <= 0xDFFF))
+                    continue;
+                else if (c <= 0x7E)
+                    nUnits += rFace.mpWidths ? rFace.mpWidths[c - 0x20] : rFace.mnFixedWidth;
+                else if (isWide(c))
+                    nUnits += 1000;
+                else
+                    nUnits += nDefault;
+            }
+            return rFD.Height * nUnits / 1000.0;
+        }
+    };
+
+    class DeviceFontMetrics : public FontMetricsProvider
+    {
+    private:
+        uno::Reference< uno::XComponentContext > mxCtx;
+        uno::Reference< awt::XDevice > mxDevice;
+        boost::scoped_ptr< FontMetricsProvider > mpFallback;
+
+        //Each font asked of the reference device, by its descriptor
+        struct CachedFont
+        {
+            uno::Reference< awt::XFont > mxFont;
+            FontMetric maMetric;
+        };
+        typedef boost::unordered_map< rtl::OUString, CachedFont, rtl::OUStringHash > fontcache;
+        fontcache maFontCache;
+
+        const CachedFont &getCachedFont(const awt::FontDescriptor &rFD);
+        //Only go looking for the reference device when something first needs
+        //to be measured
+        bool hasDevice();
+    public:
+        explicit DeviceFontMetrics(const uno::Reference< uno::XComponentContext > &rxCtx)
+            : mxCtx(rxCtx)
+        {
+        }
+
+        virtual FontMetric getFontMetric(const awt::FontDescriptor &rFD)
+        {
+            if (!hasDevice())
+                return mpFallback->getFontMetric(rFD);
+            return getCachedFont(rFD).maMetric;
+        }
+
+        virtual double getStringWidth(const awt::FontDescriptor &rFD, const rtl::OUString &rString)
+        {
+            if (!hasDevice())
+                return mpFallback->getStringWidth(rFD, rString);
+            return getCachedFont(rFD).mxFont->getStringWidth(rString);
+        }
+    };
+
+    bool DeviceFontMetrics::hasDevice()
+    {
+        if (mxDevice.is())
+            return true;
+        if (mpFallback)
+            return false;
+
+        try
+        {
+            mxDevice = ReferenceDevice::get().getDevice(mxCtx);
+        }
+        catch (const uno::Exception &rException)
+        {
+            fprintf(stderr, "no reference device: %s, using builtin font metrics\n",
+                rtl::OUStringToOString(rException.Message, RTL_TEXTENCODING_UTF8).getStr());
+        }
+
+        if (!mxDevice.is())
+            mpFallback.reset(createBuiltinFontMetrics());
+        return mxDevice.is();
+    }
+
+    const DeviceFontMetrics::CachedFont &DeviceFontMetrics::getCachedFont(const awt::FontDescriptor &rFD)
+    {
+        //Only the fields getFontDescriptor fills in matter
+        rtl::OUStringBuffer aKey(rFD.Name);
+        aKey.append(sal_Unicode('\n'));
+        aKey.append(rFD.Height);
+        aKey.append(sal_Unicode('\n'));
+        aKey.append(static_cast<sal_Int32>(rFD.Slant));
+        aKey.append(sal_Unicode('\n'));
+        aKey.append(rFD.Weight);
+        rtl::OUString sKey(aKey.makeStringAndClear());
+
+        fontcache::iterator aI = maFontCache.find(sKey);
+        if (aI == maFontCache.end())
+        {
+            CachedFont aFont;
+            aFont.mxFont = mxDevice->getFont(rFD);
+            awt::SimpleFontMetric aMetric = aFont.mxFont->getFontMetric();
+            aFont.maMetric.mfAscent = aMetric.Ascent;
+            aFont.maMetric.mfDescent = aMetric.Descent;
+            aFont.maMetric.mfLeading = aMetric.Leading;
+            aI = maFontCache.insert(fontcache::value_type(sKey, aFont)).first;
+        }
+        return aI->second;
+    }
+}
+
+FontMetricsProvider *createDeviceFontMetrics(const uno::Reference< uno::XComponentContext > &rxCtx)
+{
+    return new DeviceFontMetrics(rxCtx);
+}
+
+FontMetricsProvider *createBuiltinFontMetrics()
+{
+    return new BuiltinFontMetrics();
+}
+
+/* vi:set tabstop=4 shiftwidth=4 expandtab: */
@@ -0,0 +1,62 @@
+/*************************************************************************
+ *
+ * Caolán McNamara
+ * Copyright 2010 by Red Hat, Inc. 
+ *
+ * openoffice.org-diafilter is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 3 or
+ * later, as published by the Free Software Foundation.
+ *
+ * openoffice.org-diafilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ *
+ * You should have received a copy of the GNU General Public License version 3
+ * along with openoffice.org-diafilter.  If not, see
+ * <http://www.gnu.org/copyleft/gpl.html> for a copy of the GPLv3 License.
+ *
+ ************************************************************************/
+
+
+
+#ifndef FONTMETRICS_HXX
+#define FONTMETRICS_HXX
+
+#include <com/sun/star/uno/XComponentContext.hpp>
+#include <com/sun/star/awt/FontDescriptor.hpp>
+#include <rtl/ustring.hxx>
+
+//Font metrics in points for the FontDescriptor's Height
+struct FontMetric
+{
+    double mfAscent;
+    double mfDescent;
+    double mfLeading;
+    FontMetric() : mfAscent(0), mfDescent(0), mfLeading(0) {}
+};
+
+//Where text gets measured. Only the Name, Height, Slant and Weight of the
+//FontDescriptor are expected to be filled in
+class FontMetricsProvider
+{
+public:
+    virtual FontMetric getFontMetric(const ::com::sun::star::awt::FontDescriptor &rFD) = 0;
+    //Width of rString in points
+    virtual double getStringWidth(const ::com::sun::star::awt::FontDescriptor &rFD,
+        const rtl::OUString &rString) = 0;
+    virtual ~FontMetricsProvider() {}
+};
+
+//Measures against the fonts of the office's shared reference device, falling
+//back to the builtin metrics if the device can't be had
+FontMetricsProvider *createDeviceFontMetrics(
+    const ::com::sun::star::uno::Reference< ::com::sun::star::uno::XComponentContext > &rxCtx);
+
+//Measures against embedded advance widths of the standard Helvetica, Times
+//and Courier fonts which stand in for Dia's sans, serif and monospace
+//families. Needs neither a running office nor any installed fonts, so the
+//results are the same wherever the conversion is run
+FontMetricsProvider *createBuiltinFontMetrics();
+
+#endif
+/* vi:set tabstop=4 shiftwidth=4 expandtab: */
@@ -18,10 +18,21 @@
  ************************************************************************/
 
 #include <gz_inputstream.hxx>
+#include <mem_inputstream.hxx>
 
 #include <stdio.h>
 #include <string.h>
 #include <zlib.h>
+#ifdef HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+#include <osl/mutex.hxx>
+#include <rtl/alloc.h>
+#include <rtl/instance.hxx>
+
+#include <algorithm>
+#include <boost/shared_ptr.hpp>
 
 #define ASCII_FLAG   0x01 /* bit 0 set: file probably ascii text */
 #define HEAD_CRC     0x02 /* bit 1 set: header CRC present */
@@ -30,50 +41,62 @@
 #define COMMENT      0x10 /* bit 4 set: file comment present */
 #define RESERVED     0xE0 /* bits 5..7: reserved */
 
-#define Z_BUFSIZE    16384
-
 using namespace com::sun::star;
 
-gz_InputStream::gz_InputStream(uno::Reference<io::XInputStream> xInputStream)
-	: mxInputStream(xInputStream)
+gz_InputStream::gz_InputStream(uno::Reference<io::XInputStream> xInputStream, sal_Int32 nBufferSize)
+    : mxInputStream(xInputStream)
+    , mnBufferSize(nBufferSize > 0 ? nBufferSize : GZ_BUFSIZE)
+    , maBuffer(mnBufferSize)
+    , mnPendingPos(0)
+    , mnPendingLen(0)
+    , mpStream(NULL)
+    , mbEnd(false)
 {
     if (!mxInputStream.is())
         throw io::NotConnectedException();
 
-    uno::Sequence< sal_Int8 > aData(10);
-    if (10 != mxInputStream->readBytes(aData, 10))
-        throw io::NotConnectedException();
-
-    if (aData[0] != 0x1F || aData[1] != static_cast<sal_Int8>(0x8B))
+    //inflateInit2 doesn't look at the input, so the header is parsed out of
+    //the same window that inflate then carries on from
+    mpStream = new z_stream;
+    memset(mpStream, 0, sizeof(z_stream));
+    if (Z_OK != inflateInit2(mpStream, -MAX_WBITS))
+    {
+        delete mpStream;
+        mpStream = NULL;
         throw io::NotConnectedException();
+    }
 
-    int method = aData[2];
-    int flags = aData[3];
+    try
+    {
+        if (readHeaderByte() != 0x1F || readHeaderByte() != 0x8B)
+            throw io::NotConnectedException();
 
-    if (method != Z_DEFLATED || (flags & RESERVED) != 0)
-        throw io::NotConnectedException();
+        int method = readHeaderByte();
+        int flags = readHeaderByte();
 
-    if ((flags & EXTRA_FIELD) != 0)
-    {
-        if (2 != mxInputStream->readBytes(aData, 2))
+        if (method != Z_DEFLATED || (flags & RESERVED) != 0)
             throw io::NotConnectedException();
-        unsigned int len = static_cast<unsigned int>(aData[0]);
-        len += static_cast<unsigned int>(aData[1])<<8;
-        mxInputStream->skipBytes(len);
-    }
-    if ((flags & ORIG_NAME) != 0)
-        while (mxInputStream->readBytes(aData, 1) == 1 && aData[0] != 0) {};
-    if ((flags & COMMENT) != 0)
-        while (mxInputStream->readBytes(aData, 1) == 1 && aData[0] != 0) {};
-    if ((flags & HEAD_CRC) != 0)
-        mxInputStream->skipBytes(2);
 
-    mpStream = new z_stream;
-    memset(mpStream, 0, sizeof(z_stream));
-    if (Z_OK != inflateInit2(mpStream, -MAX_WBITS))
+        //mtime, xfl and os
+        skipHeaderBytes(6);
+
+        if ((flags & EXTRA_FIELD) != 0)
+        {
+            unsigned int len = readHeaderByte();
+            len += static_cast<unsigned int>(readHeaderByte())<<8;
+            skipHeaderBytes(len);
+        }
+        if ((flags & ORIG_NAME) != 0)
+            while (readHeaderByte() != 0) {};
+        if ((flags & COMMENT) != 0)
+            while (readHeaderByte() != 0) {};
+        if ((flags & HEAD_CRC) != 0)
+            skipHeaderBytes(2);
+    }
+    catch (...)
     {
-        delete mpStream;
-        throw io::NotConnectedException();
+        closeInput();
+        throw;
     }
 }
 
@@ -84,58 +107,345 @@ gz_InputStream::~gz_InputStream()
 
 void SAL_CALL gz_InputStream::closeInput()
 {
+    if (!mpStream)
+        return;
     inflateEnd(mpStream);
     delete mpStream;
     mpStream = NULL;
 }
 
-void SAL_CALL gz_InputStream::skipBytes( sal_Int32 nBytesToSkip )
+//Refill the window of compressed data once inflate has used it all up
+bool gz_InputStream::fillBuffer()
 {
-	uno::Sequence< sal_Int8 > aData(nBytesToSkip);
-    readBytes(aData, nBytesToSkip);
+    if (mpStream->avail_in)
+        return true;
+    sal_Int32 nRead = mxInputStream->readSomeBytes(maBuffer, mnBufferSize);
+    mpStream->avail_in = nRead > 0 ? nRead : 0;
+    mpStream->next_in = reinterpret_cast<unsigned char*>(maBuffer.getArray());
+    return mpStream->avail_in != 0;
 }
 
-sal_Int32 SAL_CALL gz_InputStream::readBytes( uno::Sequence< sal_Int8 >& aData, sal_Int32 nBytesToRead )
+sal_uInt8 gz_InputStream::readHeaderByte()
 {
-    try
+    if (!fillBuffer())
+        throw io::NotConnectedException();
+    --mpStream->avail_in;
+    return *mpStream->next_in++;
+}
+
+void gz_InputStream::skipHeaderBytes(sal_Int32 nBytesToSkip)
+{
+    while (nBytesToSkip > 0)
     {
-        aData.realloc( nBytesToRead );
+        if (!fillBuffer())
+            throw io::NotConnectedException();
+        sal_Int32 nSkip = std::min<sal_Int32>(nBytesToSkip, mpStream->avail_in);
+        mpStream->avail_in -= nSkip;
+        mpStream->next_in += nSkip;
+        nBytesToSkip -= nSkip;
     }
-    catch ( const uno::Exception &e )
+}
+
+sal_Int32 gz_InputStream::readPending(sal_Int8 *pData, sal_Int32 nBytesToRead)
+{
+    sal_Int32 nRead = std::min(nBytesToRead, mnPendingLen - mnPendingPos);
+    if (nRead > 0)
     {
-        throw io::BufferSizeExceededException();
+        memcpy(pData, maPending.getConstArray() + mnPendingPos, nRead);
+        mnPendingPos += nRead;
     }
+    return nRead > 0 ? nRead : 0;
+}
 
-    if (!nBytesToRead)
-        return 0;
-
+//Without bMayBlock only inflate what is already in the window
+sal_Int32 gz_InputStream::inflateInto(sal_Int8 *pData, sal_Int32 nBytesToRead, bool bMayBlock)
+{
     mpStream->avail_out = nBytesToRead;
-    mpStream->next_out = reinterpret_cast<unsigned char*>(aData.getArray());
+    mpStream->next_out = reinterpret_cast<unsigned char*>(pData);
 
-    while (mpStream->avail_out)
+    while (mpStream->avail_out && !mbEnd)
     {
-        if (mpStream->avail_in == 0)
-        {
-            mpStream->avail_in = mxInputStream->readSomeBytes(maBuffer, Z_BUFSIZE);
-            mpStream->next_in = reinterpret_cast<unsigned char*>(maBuffer.getArray());
-        }
-        if (mpStream->avail_in == 0)
+        if (mpStream->avail_in == 0 && (!bMayBlock || !fillBuffer()))
             break;
-        if (Z_OK != inflate(mpStream, Z_NO_FLUSH))
+        int nRet = inflate(mpStream, Z_NO_FLUSH);
+        if (nRet == Z_STREAM_END)
+            mbEnd = true;
+        else if (nRet != Z_OK)
             break;
     }
     return nBytesToRead-mpStream->avail_out;
 }
 
+void SAL_CALL gz_InputStream::skipBytes( sal_Int32 nBytesToSkip )
+{
+    if (!mpStream)
+        throw io::NotConnectedException();
+
+    sal_Int32 nPending = std::min(nBytesToSkip, mnPendingLen - mnPendingPos);
+    if (nPending > 0)
+    {
+        mnPendingPos += nPending;
+        nBytesToSkip -= nPending;
+    }
+    if (nBytesToSkip <= 0)
+        return;
+    mnPendingPos = mnPendingLen = 0;
+
+    //Inflate in chunks through the scratch buffer rather than a throwaway
+    //buffer the size of the skip
+    if (maPending.getLength() != mnBufferSize)
+        maPending.realloc(mnBufferSize);
+    while (nBytesToSkip > 0)
+    {
+        sal_Int32 nSkipped = inflateInto(maPending.getArray(),
+            std::min(nBytesToSkip, mnBufferSize), true);
+        if (!nSkipped)
+            break;
+        nBytesToSkip -= nSkipped;
+    }
+}
+
+sal_Int32 SAL_CALL gz_InputStream::readBytes( uno::Sequence< sal_Int8 >& aData, sal_Int32 nBytesToRead )
+{
+    if (!mpStream)
+        throw io::NotConnectedException();
+    if (nBytesToRead < 0)
+        throw io::BufferSizeExceededException();
+
+    //Reuse the caller's buffer if it's already the right size
+    if (aData.getLength() != nBytesToRead)
+    {
+        try
+        {
+            aData.realloc( nBytesToRead );
+        }
+        catch ( const uno::Exception & )
+        {
+            throw io::BufferSizeExceededException();
+        }
+    }
+
+    if (!nBytesToRead)
+        return 0;
+
+    sal_Int8 *pData = aData.getArray();
+    sal_Int32 nRead = readPending(pData, nBytesToRead);
+    if (nRead < nBytesToRead)
+        nRead += inflateInto(pData + nRead, nBytesToRead - nRead, true);
+
+    if (nRead < nBytesToRead)
+        aData.realloc(nRead);
+    return nRead;
+}
+
+//What can be read without blocking, i.e. whatever inflates out of the
+//compressed data already read in
 sal_Int32 SAL_CALL gz_InputStream::available()
 {
-    return 0;
+    if (!mpStream)
+        throw io::NotConnectedException();
+
+    if (mnPendingPos == mnPendingLen && mpStream->avail_in && !mbEnd)
+    {
+        if (maPending.getLength() != mnBufferSize)
+            maPending.realloc(mnBufferSize);
+        mnPendingPos = 0;
+        mnPendingLen = inflateInto(maPending.getArray(), mnBufferSize, false);
+    }
+    return mnPendingLen - mnPendingPos;
 }
 
 sal_Int32 SAL_CALL gz_InputStream::readSomeBytes(
-	uno::Sequence< sal_Int8 >& aData, sal_Int32 nMaxBytesToRead )
+    uno::Sequence< sal_Int8 >& aData, sal_Int32 nMaxBytesToRead )
 {
     return readBytes(aData, nMaxBytesToRead);
 }
 
+namespace
+{
+    //Length of the gzip header at the start of pData, or -1 if it isn't one
+    sal_Int32 parseHeader(const sal_uInt8 *pData, sal_Int32 nLength)
+    {
+        if (nLength < 10 || pData[0] != 0x1F || pData[1] != 0x8B)
+            return -1;
+
+        int method = pData[2];
+        int flags = pData[3];
+
+        if (method != Z_DEFLATED || (flags & RESERVED) != 0)
+            return -1;
+
+        sal_Int32 nPos = 10;
+        if ((flags & EXTRA_FIELD) != 0)
+        {
+            if (nPos + 2 > nLength)
+                return -1;
+            nPos += 2 + (pData[nPos] | (pData[nPos+1] << 8));
+        }
+        if ((flags & ORIG_NAME) != 0)
+        {
+            while (nPos < nLength && pData[nPos] != 0)
+                ++nPos;
+            ++nPos;
+        }
+        if ((flags & COMMENT) != 0)
+        {
+            while (nPos < nLength && pData[nPos] != 0)
+                ++nPos;
+            ++nPos;
+        }
+        if ((flags & HEAD_CRC) != 0)
+            nPos += 2;
+
+        return nPos <= nLength ? nPos : -1;
+    }
+
+    //Inflate raw deflate data which must exactly fill pOut
+    bool inflateAll(const sal_uInt8 *pIn, sal_Int32 nIn, sal_uInt8 *pOut, sal_uInt32 nOut)
+    {
+#ifdef HAVE_LIBDEFLATE
+        libdeflate_decompressor *pDecompressor = libdeflate_alloc_decompressor();
+        if (!pDecompressor)
+            return false;
+        size_t nActualIn = 0, nActualOut = 0;
+        libdeflate_result eResult = libdeflate_deflate_decompress_ex(pDecompressor,
+            pIn, nIn, pOut, nOut, &nActualIn, &nActualOut);
+        libdeflate_free_decompressor(pDecompressor);
+        return eResult == LIBDEFLATE_SUCCESS && nActualIn == static_cast<size_t>(nIn) &&
+            nActualOut == nOut;
+#else
+        z_stream aStream;
+        memset(&aStream, 0, sizeof(z_stream));
+        if (Z_OK != inflateInit2(&aStream, -MAX_WBITS))
+            return false;
+        aStream.next_in = const_cast<Bytef*>(pIn);
+        aStream.avail_in = nIn;
+        aStream.next_out = pOut;
+        aStream.avail_out = nOut;
+        int nRet = inflate(&aStream, Z_FINISH);
+        inflateEnd(&aStream);
+        return nRet == Z_STREAM_END && aStream.avail_in == 0 && aStream.avail_out == 0;
+#endif
+    }
+}
+
+uno::Reference< io::XInputStream > inflateGzStream(const uno::Reference< io::XInputStream > &rxInputStream,
+    const uno::Reference< io::XSeekable > &rxSeekable)
+{
+    uno::Reference< io::XInputStream > xRet;
+    if (!rxInputStream.is() || !rxSeekable.is())
+        return xRet;
+
+    sal_Int64 nPos = rxSeekable->getPosition();
+    sal_Int64 nCompressed = rxSeekable->getLength() - nPos;
+    //header plus the crc and isize trailer, and no more than is worth
+    //reading in one go
+    if (nCompressed < 18 || nCompressed > GZ_INFLATE_ALL_MAX)
+        return xRet;
+
+    //Don't read all of something that isn't gzipped
+    uno::Sequence< sal_Int8 > aCompressed;
+    if (rxInputStream->readBytes(aCompressed, 2) != 2 ||
+        aCompressed[0] != 0x1F || aCompressed[1] != static_cast<sal_Int8>(0x8B))
+    {
+        return xRet;
+    }
+    rxSeekable->seek(nPos);
+
+    sal_Int32 nRead = rxInputStream->readBytes(aCompressed, static_cast<sal_Int32>(nCompressed));
+    const sal_uInt8 *pData = reinterpret_cast<const sal_uInt8*>(aCompressed.getConstArray());
+
+    sal_Int32 nHeader = parseHeader(pData, nRead);
+    if (nHeader < 0 || nHeader + 8 > nRead)
+        return xRet;
+
+    const sal_uInt8 *pTrailer = pData + nRead - 4;
+    sal_uInt32 nSize = pTrailer[0] | (pTrailer[1] << 8) | (pTrailer[2] << 16) |
+        (static_cast<sal_uInt32>(pTrailer[3]) << 24);
+
+    //isize is only the size modulo 4G, and a concatenation of gzip members
+    //gives only the size of the last one, so a size deflate can't get to is
+    //garbage and a size too small is caught when the output buffer fills.
+    //Anything bigger than GZ_INFLATE_ALL_MAX is streamed rather than taking
+    //isize's word for how much to allocate
+    if (!nSize || nSize / 1032 > static_cast<sal_uInt32>(nRead) ||
+        nSize > static_cast<sal_uInt32>(GZ_INFLATE_ALL_MAX))
+        return xRet;
+
+    //Every byte is about to be written by the inflate, so don't zero it first
+    boost::shared_ptr< void > pInflated(rtl_allocateMemory(nSize), rtl_freeMemory);
+    if (!pInflated.get())
+        return xRet;
+    sal_Int8 *pOut = static_cast<sal_Int8*>(pInflated.get());
+    if (!inflateAll(pData + nHeader, nRead - nHeader - 8, reinterpret_cast<sal_uInt8*>(pOut), nSize))
+        return xRet;
+
+    xRet = new mem_InputStream(pOut, nSize, pInflated);
+    return xRet;
+}
+
+sal_Int32 sniffContent(const sal_Int8 *pPeeked, sal_Int32 nPeeked, sal_Int8 *pContent)
+{
+    const sal_uInt8 *pData = reinterpret_cast<const sal_uInt8*>(pPeeked);
+    sal_Int32 nHeader = parseHeader(pData, nPeeked);
+    if (nHeader < 0)
+    {
+        sal_Int32 nLen = std::min<sal_Int32>(nPeeked, SNIFF_SIZE);
+        if (nLen > 0)
+            memcpy(pContent, pPeeked, nLen);
+        return nLen > 0 ? nLen : 0;
+    }
+
+    z_stream aStream;
+    memset(&aStream, 0, sizeof(z_stream));
+    if (Z_OK != inflateInit2(&aStream, -MAX_WBITS))
+        return 0;
+    aStream.next_in = const_cast<Bytef*>(pData + nHeader);
+    aStream.avail_in = nPeeked - nHeader;
+    aStream.next_out = reinterpret_cast<Bytef*>(pContent);
+    aStream.avail_out = SNIFF_SIZE;
+    inflate(&aStream, Z_SYNC_FLUSH);
+    sal_Int32 nLen = SNIFF_SIZE - aStream.avail_out;
+    inflateEnd(&aStream);
+    return nLen;
+}
+
+namespace
+{
+    struct LastSniff
+    {
+        osl::Mutex maMutex;
+        uno::Sequence< sal_Int8 > maPeeked;
+        rtl::OString maContent;
+    };
+
+    struct theLastSniff : public rtl::Static<LastSniff, theLastSniff> {};
+}
+
+rtl::OString peekContent(const uno::Reference< io::XInputStream > &rxInputStream)
+{
+    uno::Reference< io::XSeekable > xSeekable(rxInputStream, uno::UNO_QUERY);
+    sal_Int64 nPos = xSeekable.is() ? xSeekable->getPosition() : 0;
+
+    uno::Sequence< sal_Int8 > aPeeked;
+    sal_Int32 nPeeked = rxInputStream->readBytes(aPeeked, SNIFF_PEEK_SIZE);
+
+    if (xSeekable.is())
+        xSeekable->seek(nPos);
+
+    LastSniff &rLast = theLastSniff::get();
+    osl::MutexGuard aGuard(rLast.maMutex);
+    if (rLast.maPeeked.getLength() == nPeeked &&
+        !memcmp(rLast.maPeeked.getConstArray(), aPeeked.getConstArray(), nPeeked))
+    {
+        return rLast.maContent;
+    }
+
+    sal_Int8 aContent[SNIFF_SIZE];
+    sal_Int32 nLen = sniffContent(aPeeked.getConstArray(), nPeeked, aContent);
+    rLast.maPeeked = aPeeked;
+    rLast.maContent = rtl::OString(reinterpret_cast<const sal_Char*>(aContent), nLen);
+    return rLast.maContent;
+}
+
 /* vi:set tabstop=4 shiftwidth=4 expandtab: */
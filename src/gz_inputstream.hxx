@@ -23,22 +23,44 @@
 #include <com/sun/star/io/BufferSizeExceededException.hpp>
 #include <com/sun/star/io/NotConnectedException.hpp>
 #include <com/sun/star/io/XInputStream.hpp>
+#include <com/sun/star/io/XSeekable.hpp>
 #include <cppuhelper/implbase1.hxx>
+#include <rtl/string.hxx>
 
 extern "C"
 {
     typedef struct z_stream_s z_stream;
 }
 
+//Default size of the window of compressed data read from the wrapped stream
+#define GZ_BUFSIZE 65536
+//Largest .dia inflated in one go by inflateGzStream, anything bigger, or
+//claiming to be, is streamed instead
+#define GZ_INFLATE_ALL_MAX (64 * 1024 * 1024)
+
 class gz_InputStream :
     public ::cppu::WeakImplHelper1< ::com::sun::star::io::XInputStream >
 {
 private:
-	::com::sun::star::uno::Reference< ::com::sun::star::io::XInputStream > mxInputStream;
+    ::com::sun::star::uno::Reference< ::com::sun::star::io::XInputStream > mxInputStream;
+    sal_Int32 mnBufferSize;
+    //compressed data read from mxInputStream, but not yet inflated
     ::com::sun::star::uno::Sequence< sal_Int8 > maBuffer;
+    //inflated data not yet read, from available() or scratch for skipBytes
+    ::com::sun::star::uno::Sequence< sal_Int8 > maPending;
+    sal_Int32 mnPendingPos;
+    sal_Int32 mnPendingLen;
     z_stream* mpStream;
+    bool mbEnd;
+
+    bool fillBuffer();
+    sal_uInt8 readHeaderByte();
+    void skipHeaderBytes(sal_Int32 nBytesToSkip);
+    sal_Int32 readPending(sal_Int8 *pData, sal_Int32 nBytesToRead);
+    sal_Int32 inflateInto(sal_Int8 *pData, sal_Int32 nBytesToRead, bool bMayBlock);
 public:
-	gz_InputStream(::com::sun::star::uno::Reference< ::com::sun::star::io::XInputStream > xInputStream);
+    gz_InputStream(::com::sun::star::uno::Reference< ::com::sun::star::io::XInputStream > xInputStream,
+        sal_Int32 nBufferSize = GZ_BUFSIZE);
     virtual ~gz_InputStream();
 
     // XInputStream
@@ -55,5 +77,28 @@ public:
     virtual void SAL_CALL closeInput( void );
 };
 
+//If the whole of a gzipped stream is there to be had, i.e. it is seekable,
+//read it all in and inflate it in one go into a buffer of the size given in
+//its trailer. Returns an empty reference if that can't be done, in which case
+//seek back and use a gz_InputStream
+::com::sun::star::uno::Reference< ::com::sun::star::io::XInputStream > inflateGzStream(
+    const ::com::sun::star::uno::Reference< ::com::sun::star::io::XInputStream > &rxInputStream,
+    const ::com::sun::star::uno::Reference< ::com::sun::star::io::XSeekable > &rxSeekable);
+
+//Raw bytes of a stream peeked at to identify it, and bytes of its
+//content, inflated if need be, that are then looked at
+#define SNIFF_PEEK_SIZE 1024
+#define SNIFF_SIZE 64
+
+//Given the first raw bytes of a stream, copy up to SNIFF_SIZE bytes of the
+//start of its content into pContent, inflating only that much through a
+//z_stream on the stack if it is gzipped. Returns the number copied
+sal_Int32 sniffContent(const sal_Int8 *pPeeked, sal_Int32 nPeeked, sal_Int8 *pContent);
+
+//The start of the content of rxInputStream for detection, leaving it where
+//it was if it's seekable. The last peeked start is remembered so that the
+//detectors of each filter looking at the same stream don't all inflate it
+rtl::OString peekContent(const ::com::sun::star::uno::Reference< ::com::sun::star::io::XInputStream > &rxInputStream);
+
 #endif
 /* vi:set tabstop=4 shiftwidth=4 expandtab: */
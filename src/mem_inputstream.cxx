@@ -0,0 +1,136 @@
+/*************************************************************************
+ *
+ * Caolán McNamara
+ * Copyright 2010 by Red Hat, Inc. 
+ *
+ * openoffice.org-diafilter is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 3 or
+ * later, as published by the Free Software Foundation.
+ *
+ * openoffice.org-diafilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ *
+ * You should have received a copy of the GNU General Public License version 3
+ * along with openoffice.org-diafilter.  If not, see
+ * <http://www.gnu.org/copyleft/gpl.html> for a copy of the GPLv3 License.
+ *
+ ************************************************************************/
+
+
+#include <mem_inputstream.hxx>
+
+#include <algorithm>
+
+#include <string.h>
+
+using namespace com::sun::star;
+
+MappedFile::MappedFile(const rtl::OUString &rURL)
+    : mhFile(NULL)
+    , mpData(NULL)
+    , mnSize(0)
+{
+    if (osl_openFile(rURL.pData, &mhFile, osl_File_OpenFlag_Read) != osl_File_E_None)
+    {
+        mhFile = NULL;
+        return;
+    }
+
+    if (osl_getFileSize(mhFile, &mnSize) != osl_File_E_None || !mnSize ||
+        osl_mapFile(mhFile, &mpData, mnSize, 0, osl_File_MapFlag_RandomAccess) != osl_File_E_None)
+    {
+        mpData = NULL;
+        mnSize = 0;
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (mpData)
+        osl_unmapMappedFile(mhFile, mpData, mnSize);
+    if (mhFile)
+        osl_closeFile(mhFile);
+}
+
+mem_InputStream::mem_InputStream(const sal_Int8 *pData, sal_Int64 nLength,
+    const boost::shared_ptr<void> &rOwner)
+    : mpOwner(rOwner)
+    , mpData(pData)
+    , mnLength(nLength)
+    , mnPos(0)
+{
+}
+
+sal_Int32 SAL_CALL mem_InputStream::readBytes( uno::Sequence< sal_Int8 >& aData, sal_Int32 nBytesToRead )
+{
+    if (!mpData)
+        throw io::NotConnectedException();
+
+    if (nBytesToRead < 0)
+        throw io::BufferSizeExceededException();
+
+    sal_Int32 nRead = static_cast<sal_Int32>(std::min<sal_Int64>(nBytesToRead, mnLength - mnPos));
+
+    try
+    {
+        aData.realloc( nRead );
+    }
+    catch ( const uno::Exception & )
+    {
+        throw io::BufferSizeExceededException();
+    }
+
+    memcpy(aData.getArray(), mpData + mnPos, nRead);
+    mnPos += nRead;
+    return nRead;
+}
+
+sal_Int32 SAL_CALL mem_InputStream::readSomeBytes(
+    uno::Sequence< sal_Int8 >& aData, sal_Int32 nMaxBytesToRead )
+{
+    return readBytes(aData, nMaxBytesToRead);
+}
+
+void SAL_CALL mem_InputStream::skipBytes( sal_Int32 nBytesToSkip )
+{
+    if (!mpData)
+        throw io::NotConnectedException();
+
+    if (nBytesToSkip > 0)
+        mnPos = std::min<sal_Int64>(mnPos + nBytesToSkip, mnLength);
+}
+
+sal_Int32 SAL_CALL mem_InputStream::available()
+{
+    if (!mpData)
+        throw io::NotConnectedException();
+
+    return static_cast<sal_Int32>(std::min<sal_Int64>(SAL_MAX_INT32, mnLength - mnPos));
+}
+
+void SAL_CALL mem_InputStream::closeInput()
+{
+    mpData = NULL;
+    mpOwner.reset();
+}
+
+void SAL_CALL mem_InputStream::seek( sal_Int64 nLocation )
+{
+    if (nLocation < 0 || nLocation > mnLength)
+        throw lang::IllegalArgumentException();
+
+    mnPos = nLocation;
+}
+
+sal_Int64 SAL_CALL mem_InputStream::getPosition()
+{
+    return mnPos;
+}
+
+sal_Int64 SAL_CALL mem_InputStream::getLength()
+{
+    return mnLength;
+}
+
+/* vi:set tabstop=4 shiftwidth=4 expandtab: */
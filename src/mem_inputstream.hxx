@@ -0,0 +1,87 @@
+/*************************************************************************
+ *
+ * Caolán McNamara
+ * Copyright 2010 by Red Hat, Inc. 
+ *
+ * openoffice.org-diafilter is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 3 or
+ * later, as published by the Free Software Foundation.
+ *
+ * openoffice.org-diafilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ *
+ * You should have received a copy of the GNU General Public License version 3
+ * along with openoffice.org-diafilter.  If not, see
+ * <http://www.gnu.org/copyleft/gpl.html> for a copy of the GPLv3 License.
+ *
+ ************************************************************************/
+
+
+#ifndef MEM_INPUTSTREAM_HXX
+#define MEM_INPUTSTREAM_HXX
+
+#include <com/sun/star/io/BufferSizeExceededException.hpp>
+#include <com/sun/star/io/NotConnectedException.hpp>
+#include <com/sun/star/io/XInputStream.hpp>
+#include <com/sun/star/io/XSeekable.hpp>
+#include <com/sun/star/lang/IllegalArgumentException.hpp>
+#include <cppuhelper/implbase2.hxx>
+#include <osl/file.h>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+//A local file mapped read-only into memory
+class MappedFile : private boost::noncopyable
+{
+private:
+    oslFileHandle mhFile;
+    void *mpData;
+    sal_uInt64 mnSize;
+public:
+    explicit MappedFile(const ::rtl::OUString &rURL);
+    ~MappedFile();
+
+    bool is() const { return mpData != NULL; }
+    const sal_Int8* getData() const { return static_cast<const sal_Int8*>(mpData); }
+    sal_uInt64 getSize() const { return mnSize; }
+};
+
+//An XInputStream over a block of memory, rOwner (if any) is kept alive for
+//as long as the stream is, so it can hold e.g. a MappedFile
+class mem_InputStream :
+    public ::cppu::WeakImplHelper2< ::com::sun::star::io::XInputStream,
+        ::com::sun::star::io::XSeekable >
+{
+private:
+    boost::shared_ptr<void> mpOwner;
+    const sal_Int8 *mpData;
+    sal_Int64 mnLength;
+    sal_Int64 mnPos;
+public:
+    mem_InputStream(const sal_Int8 *pData, sal_Int64 nLength,
+        const boost::shared_ptr<void> &rOwner = boost::shared_ptr<void>());
+
+    // XInputStream
+    virtual sal_Int32 SAL_CALL readBytes( ::com::sun::star::uno::Sequence< sal_Int8 > & aData,
+        sal_Int32 nBytesToRead );
+
+    virtual sal_Int32 SAL_CALL readSomeBytes( ::com::sun::star::uno::Sequence< sal_Int8 > & aData,
+        sal_Int32 nMaxBytesToRead );
+
+    virtual void SAL_CALL skipBytes( sal_Int32 nBytesToSkip );
+
+    virtual sal_Int32 SAL_CALL available( void );
+
+    virtual void SAL_CALL closeInput( void );
+
+    // XSeekable
+    virtual void SAL_CALL seek( sal_Int64 nLocation );
+
+    virtual sal_Int64 SAL_CALL getPosition( void );
+
+    virtual sal_Int64 SAL_CALL getLength( void );
+};
+
+#endif
+/* vi:set tabstop=4 shiftwidth=4 expandtab: */
@@ -0,0 +1,134 @@
+/*************************************************************************
+ *
+ * Caolán McNamara
+ * Copyright 2010 by Red Hat, Inc.
+ *
+ * openoffice.org-diafilter is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 3 or
+ * later, as published by the Free Software Foundation.
+ *
+ * openoffice.org-diafilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License version 3
+ * along with openoffice.org-diafilter.  If not, see
+ * <http://www.gnu.org/copyleft/gpl.html> for a copy of the GPLv3 License.
+ *
+ ************************************************************************/
+
+#include <rtl/math.hxx>
+
+#include "numberformat.hxx"
+
+#include <math.h>
+
+namespace
+{
+    enum { MAX_DECIMALS = 6, MAX_UNIT = 16, MAX_NUMBER = 48 };
+
+    const sal_uInt64 aPowersOfTen[MAX_DECIMALS + 1] =
+    {
+        1, 10, 100, 1000, 10000, 100000, 1000000
+    };
+
+    //Anything this big is nonsense in a drawing, but rather than overflow
+    //the integer arithmetic below it's handed to the general formatter
+    const double fMaxFixed = 1e12;
+
+    //Writes the number and unit into pOut, which has room for MAX_NUMBER +
+    //MAX_UNIT characters, returning how many were written
+    sal_Int32 writeNumber(sal_Unicode *pOut, double fValue, const sal_Char *pUnit, int nDecimals)
+    {
+        sal_Unicode *pPos = pOut;
+
+        if (nDecimals < 0)
+            nDecimals = 0;
+        else if (nDecimals > MAX_DECIMALS)
+            nDecimals = MAX_DECIMALS;
+
+        //also catches NaN and infinity
+        if (!(fabs(fValue) < fMaxFixed))
+        {
+            rtl::OUString sNumber = rtl::math::doubleToUString(fValue,
+                rtl_math_StringFormat_Automatic, rtl_math_DecimalPlaces_Max, '.', true);
+            const sal_Unicode *pStr = sNumber.getStr();
+            for (sal_Int32 i = 0; i < sNumber.getLength() && i < MAX_NUMBER; ++i)
+                *pPos++ = pStr[i];
+        }
+        else
+        {
+            const sal_uInt64 nPower = aPowersOfTen[nDecimals];
+            sal_uInt64 nScaled = static_cast< sal_uInt64 >(fabs(fValue) * nPower + 0.5);
+            sal_uInt64 nInteger = nScaled / nPower;
+            sal_uInt64 nFraction = nScaled % nPower;
+
+            //no "-0" for values that round away to nothing
+            if (fValue < 0 && nScaled != 0)
+                *pPos++ = '-';
+
+            sal_Unicode aDigits[24];
+            int nDigits = 0;
+            do
+            {
+                aDigits[nDigits++] = static_cast< sal_Unicode >('0' + nInteger % 10);
+                nInteger /= 10;
+            }
+            while (nInteger);
+            while (nDigits)
+                *pPos++ = aDigits[--nDigits];
+
+            if (nFraction)
+            {
+                int nWanted = nDecimals;
+                while (nFraction % 10 == 0)
+                {
+                    nFraction /= 10;
+                    --nWanted;
+                }
+                *pPos++ = '.';
+                for (int i = nWanted - 1; i >= 0; --i)
+                {
+                    pPos[i] = static_cast< sal_Unicode >('0' + nFraction % 10);
+                    nFraction /= 10;
+                }
+                pPos += nWanted;
+            }
+        }
+
+        if (pUnit)
+        {
+            for (int i = 0; pUnit[i] && i < MAX_UNIT; ++i)
+                *pPos++ = static_cast< sal_Unicode >(pUnit[i]);
+        }
+
+        return static_cast< sal_Int32 >(pPos - pOut);
+    }
+}
+
+void appendNumber(rtl::OUStringBuffer &rBuf, double fValue, const sal_Char *pUnit, int nDecimals)
+{
+    sal_Unicode aNumber[MAX_NUMBER + MAX_UNIT];
+    rBuf.append(aNumber, writeNumber(aNumber, fValue, pUnit, nDecimals));
+}
+
+rtl::OUString formatNumber(double fValue, const sal_Char *pUnit, int nDecimals)
+{
+    sal_Unicode aNumber[MAX_NUMBER + MAX_UNIT];
+    return rtl::OUString(aNumber, writeNumber(aNumber, fValue, pUnit, nDecimals));
+}
+
+rtl::OUString formatViewBox(double fX, double fY, double fWidth, double fHeight)
+{
+    sal_Unicode aViewBox[4 * (MAX_NUMBER + 1)];
+    sal_Int32 nLen = writeNumber(aViewBox, fX, 0, NUMBER_DECIMALS);
+    aViewBox[nLen++] = ' ';
+    nLen += writeNumber(aViewBox + nLen, fY, 0, NUMBER_DECIMALS);
+    aViewBox[nLen++] = ' ';
+    nLen += writeNumber(aViewBox + nLen, fWidth, 0, NUMBER_DECIMALS);
+    aViewBox[nLen++] = ' ';
+    nLen += writeNumber(aViewBox + nLen, fHeight, 0, NUMBER_DECIMALS);
+    return rtl::OUString(aViewBox, nLen);
+}
+
+/* vi:set tabstop=4 shiftwidth=4 expandtab: */
@@ -0,0 +1,47 @@
+/*************************************************************************
+ *
+ * Caolán McNamara
+ * Copyright 2010 by Red Hat, Inc.
+ *
+ * openoffice.org-diafilter is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 3 or
+ * later, as published by the Free Software Foundation.
+ *
+ * openoffice.org-diafilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License version 3
+ * along with openoffice.org-diafilter.  If not, see
+ * <http://www.gnu.org/copyleft/gpl.html> for a copy of the GPLv3 License.
+ *
+ ************************************************************************/
+
+#ifndef NUMBERFORMAT_HXX
+#define NUMBERFORMAT_HXX
+
+#include <rtl/ustring.hxx>
+#include <rtl/ustrbuf.hxx>
+
+//Lengths, coordinates and angles are written with at most this many
+//decimals, i.e. to a micron for centimetres, which is finer than anything
+//dia itself stores
+enum { NUMBER_DECIMALS = 4 };
+
+//Writes fValue rounded to nDecimals (at most 6) with the trailing zeros
+//dropped, e.g. "1.5", "-0.25" or "12", followed by the ASCII pUnit if given.
+//The digits go straight into rBuf, so a single buffer can be reused to build
+//a whole list of points or a viewBox
+void appendNumber(rtl::OUStringBuffer &rBuf, double fValue,
+    const sal_Char *pUnit = 0, int nDecimals = NUMBER_DECIMALS);
+
+//As appendNumber, for a single attribute value
+rtl::OUString formatNumber(double fValue,
+    const sal_Char *pUnit = 0, int nDecimals = NUMBER_DECIMALS);
+
+//An svg:viewBox value, "x y width height"
+rtl::OUString formatViewBox(double fX, double fY, double fWidth, double fHeight);
+
+#endif
+
+/* vi:set tabstop=4 shiftwidth=4 expandtab: */
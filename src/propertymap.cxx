@@ -0,0 +1,332 @@
+/*************************************************************************
+ *
+ * Caolán McNamara
+ * Copyright 2010 by Red Hat, Inc.
+ *
+ * openoffice.org-diafilter is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 3 or
+ * later, as published by the Free Software Foundation.
+ *
+ * openoffice.org-diafilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License version 3
+ * along with openoffice.org-diafilter.  If not, see
+ * <http://www.gnu.org/copyleft/gpl.html> for a copy of the GPLv3 License.
+ *
+ ************************************************************************/
+
+#include <rtl/instance.hxx>
+#include <rtl/string.h>
+#include <boost/unordered_set.hpp>
+
+#include "propertymap.hxx"
+
+#include <algorithm>
+
+namespace
+{
+    //Every attribute name the filter sets from a literal. Anything not in
+    //here, e.g. svg:x3 or names copied from a .shape file, still works but
+    //gets its own string
+    const sal_Char * const aPropertyNames[] =
+    {
+        "dia:curve_distance",
+        "dia:endpoints",
+        "draw:auto-grow-width",
+        "draw:background-size",
+        "draw:corner-radius",
+        "draw:d",
+        "draw:display-name",
+        "draw:distance",
+        "draw:dots1",
+        "draw:dots1-length",
+        "draw:dots2",
+        "draw:end-angle",
+        "draw:end-glue-point",
+        "draw:end-line-spacing-horizontal",
+        "draw:end-line-spacing-vertical",
+        "draw:end-shape",
+        "draw:fill",
+        "draw:fill-color",
+        "draw:id",
+        "draw:kind",
+        "draw:line-skew",
+        "draw:marker-end",
+        "draw:marker-end-width",
+        "draw:marker-start",
+        "draw:marker-start-width",
+        "draw:master-page-name",
+        "draw:name",
+        "draw:points",
+        "draw:start-angle",
+        "draw:start-glue-point",
+        "draw:start-line-spacing-horizontal",
+        "draw:start-line-spacing-vertical",
+        "draw:start-shape",
+        "draw:stroke",
+        "draw:stroke-dash",
+        "draw:style",
+        "draw:style-name",
+        "draw:textarea-horizontal-align",
+        "draw:textarea-vertical-align",
+        "draw:transform",
+        "draw:type",
+        "fo:color",
+        "fo:country",
+        "fo:font-family",
+        "fo:font-size",
+        "fo:font-style",
+        "fo:font-weight",
+        "fo:language",
+        "fo:margin-bottom",
+        "fo:margin-left",
+        "fo:margin-right",
+        "fo:margin-top",
+        "fo:min-height",
+        "fo:padding-bottom",
+        "fo:padding-left",
+        "fo:padding-right",
+        "fo:padding-top",
+        "fo:page-height",
+        "fo:page-width",
+        "fo:text-align",
+        "office:mimetype",
+        "office:version",
+        "style:family",
+        "style:name",
+        "style:page-layout-name",
+        "style:print-orientation",
+        "svg:d",
+        "svg:height",
+        "svg:stroke-color",
+        "svg:stroke-width",
+        "svg:viewBox",
+        "svg:width",
+        "svg:x",
+        "svg:x1",
+        "svg:x2",
+        "svg:y",
+        "svg:y1",
+        "svg:y2",
+        "text:style-name",
+        "xlink:actuate",
+        "xlink:href",
+        "xlink:show",
+        "xlink:type"
+    };
+
+    struct AsciiName
+    {
+        const sal_Char *mpStr;
+        sal_Int32 mnLen;
+    };
+
+    //Hashes an ASCII name and its OUString equivalent alike, so the table
+    //can be searched without converting the literal first
+    struct PropertyNameHash
+    {
+        template< typename T > static size_t hash(const T *pStr, sal_Int32 nLen)
+        {
+            size_t nHash = nLen;
+            for (sal_Int32 i = 0; i < nLen; ++i)
+                nHash = nHash * 37 + static_cast< sal_Unicode >(pStr[i]);
+            return nHash;
+        }
+        size_t operator()(const rtl::OUString &rName) const
+        {
+            return hash(rName.getStr(), rName.getLength());
+        }
+        size_t operator()(const AsciiName &rName) const
+        {
+            return hash(rName.mpStr, rName.mnLen);
+        }
+    };
+
+    struct PropertyNameEqual
+    {
+        bool operator()(const rtl::OUString &rA, const rtl::OUString &rB) const
+        {
+            return rA == rB;
+        }
+        bool operator()(const AsciiName &rA, const rtl::OUString &rB) const
+        {
+            return rB.equalsAsciiL(rA.mpStr, rA.mnLen);
+        }
+        bool operator()(const rtl::OUString &rA, const AsciiName &rB) const
+        {
+            return rA.equalsAsciiL(rB.mpStr, rB.mnLen);
+        }
+    };
+
+    //Filled once and only read afterwards, so it's safe to share between
+    //concurrent imports without locking
+    class PropertyNames
+    {
+    private:
+        typedef boost::unordered_set< rtl::OUString, PropertyNameHash, PropertyNameEqual > names;
+        names maNames;
+    public:
+        PropertyNames()
+        {
+            const size_t nCount = sizeof(aPropertyNames) / sizeof(aPropertyNames[0]);
+            for (size_t i = 0; i < nCount; ++i)
+                maNames.insert(rtl::OUString::createFromAscii(aPropertyNames[i]));
+        }
+        rtl::OUString get(const sal_Char *pName, sal_Int32 nLen) const
+        {
+            AsciiName aName = { pName, nLen };
+            names::const_iterator aI = maNames.find(aName, PropertyNameHash(), PropertyNameEqual());
+            if (aI != maNames.end())
+                return *aI;
+            return rtl::OUString(pName, nLen, RTL_TEXTENCODING_ASCII_US);
+        }
+    };
+
+    struct thePropertyNames : public rtl::Static< PropertyNames, thePropertyNames > {};
+}
+
+rtl::OUString getPropertyName(const sal_Char *pName, sal_Int32 nLen)
+{
+    return thePropertyNames::get().get(pName, nLen);
+}
+
+PropertyMap &PropertyMap::operator=(const PropertyMap &rOther)
+{
+    if (this != &rOther)
+    {
+        clear();
+        assign(rOther);
+    }
+    return *this;
+}
+
+void PropertyMap::assign(const PropertyMap &rOther)
+{
+    if (rOther.mnSize > INLINE_PROPERTIES)
+    {
+        maOverflow.assign(rOther.begin(), rOther.end());
+        mpBegin = &maOverflow[0];
+    }
+    else
+        std::copy(rOther.begin(), rOther.end(), maInline);
+    mnSize = rOther.mnSize;
+}
+
+void PropertyMap::clear()
+{
+    if (mpBegin == maInline)
+    {
+        for (size_t i = 0; i < mnSize; ++i)
+            maInline[i] = value_type();
+    }
+    else
+    {
+        maOverflow.clear();
+        mpBegin = maInline;
+    }
+    mnSize = 0;
+}
+
+void PropertyMap::swap(PropertyMap &rOther)
+{
+    bool bInline = mpBegin == maInline;
+    bool bOtherInline = rOther.mpBegin == rOther.maInline;
+    size_t nInline = std::max(bInline ? mnSize : 0, bOtherInline ? rOther.mnSize : 0);
+    for (size_t i = 0; i < nInline; ++i)
+        std::swap(maInline[i], rOther.maInline[i]);
+    maOverflow.swap(rOther.maOverflow);
+    std::swap(mnSize, rOther.mnSize);
+    mpBegin = bOtherInline ? maInline : &maOverflow[0];
+    rOther.mpBegin = bInline ? rOther.maInline : &rOther.maOverflow[0];
+}
+
+PropertyMap::value_type &PropertyMap::append(const rtl::OUString &rName)
+{
+    if (mpBegin == maInline)
+    {
+        if (mnSize < INLINE_PROPERTIES)
+        {
+            value_type &rEntry = maInline[mnSize++];
+            rEntry.first = rName;
+            return rEntry;
+        }
+
+        maOverflow.reserve(INLINE_PROPERTIES * 2);
+        maOverflow.assign(maInline, maInline + mnSize);
+        for (size_t i = 0; i < mnSize; ++i)
+            maInline[i] = value_type();
+    }
+    maOverflow.push_back(value_type(rName, rtl::OUString()));
+    mpBegin = &maOverflow[0];
+    ++mnSize;
+    return maOverflow.back();
+}
+
+PropertyMap::iterator PropertyMap::find(const rtl::OUString &rName)
+{
+    iterator aEnd = end();
+    for (iterator aI = begin(); aI != aEnd; ++aI)
+    {
+        if (aI->first == rName)
+            return aI;
+    }
+    return aEnd;
+}
+
+PropertyMap::const_iterator PropertyMap::find(const rtl::OUString &rName) const
+{
+    return const_cast< PropertyMap* >(this)->find(rName);
+}
+
+PropertyMap::iterator PropertyMap::find(const sal_Char *pName)
+{
+    sal_Int32 nLen = rtl_str_getLength(pName);
+    iterator aEnd = end();
+    for (iterator aI = begin(); aI != aEnd; ++aI)
+    {
+        if (aI->first.equalsAsciiL(pName, nLen))
+            return aI;
+    }
+    return aEnd;
+}
+
+PropertyMap::const_iterator PropertyMap::find(const sal_Char *pName) const
+{
+    return const_cast< PropertyMap* >(this)->find(pName);
+}
+
+rtl::OUString &PropertyMap::operator[](const rtl::OUString &rName)
+{
+    iterator aI = find(rName);
+    if (aI != end())
+        return aI->second;
+    //copied first in case rName is one of our own keys, which append may move
+    rtl::OUString sName(rName);
+    return append(sName).second;
+}
+
+rtl::OUString &PropertyMap::operator[](const sal_Char *pName)
+{
+    iterator aI = find(pName);
+    if (aI != end())
+        return aI->second;
+    return append(getPropertyName(pName, rtl_str_getLength(pName))).second;
+}
+
+bool PropertyMap::operator==(const PropertyMap &rOther) const
+{
+    if (mnSize != rOther.mnSize)
+        return false;
+    const_iterator aEnd = end();
+    for (const_iterator aI = begin(); aI != aEnd; ++aI)
+    {
+        const_iterator aOther = rOther.find(aI->first);
+        if (aOther == rOther.end() || aOther->second != aI->second)
+            return false;
+    }
+    return true;
+}
+
+/* vi:set tabstop=4 shiftwidth=4 expandtab: */
@@ -0,0 +1,82 @@
+/*************************************************************************
+ *
+ * Caolán McNamara
+ * Copyright 2010 by Red Hat, Inc.
+ *
+ * openoffice.org-diafilter is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 3 or
+ * later, as published by the Free Software Foundation.
+ *
+ * openoffice.org-diafilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License version 3
+ * along with openoffice.org-diafilter.  If not, see
+ * <http://www.gnu.org/copyleft/gpl.html> for a copy of the GPLv3 License.
+ *
+ ************************************************************************/
+
+#ifndef PROPERTYMAP_HXX
+#define PROPERTYMAP_HXX
+
+#include <rtl/ustring.hxx>
+#include <vector>
+#include <utility>
+
+//The attributes of one object, style or element, in the order they were
+//first set. There are rarely more than a dozen, so they are kept flat and
+//searched linearly, in place for the first INLINE_PROPERTIES of them.
+//
+//Keys given as ASCII literals, e.g. rProps["svg:x"], are matched without
+//creating an OUString. When such a key is added it shares the interned name
+//from a fixed table of the ODF attribute names this filter uses
+class PropertyMap
+{
+public:
+    typedef std::pair< rtl::OUString, rtl::OUString > value_type;
+    typedef value_type *iterator;
+    typedef const value_type *const_iterator;
+private:
+    enum { INLINE_PROPERTIES = 16 };
+    value_type maInline[INLINE_PROPERTIES];
+    std::vector< value_type > maOverflow;
+    value_type *mpBegin;
+    size_t mnSize;
+
+    value_type &append(const rtl::OUString &rName);
+    void assign(const PropertyMap &rOther);
+public:
+    PropertyMap() : mpBegin(maInline), mnSize(0) {}
+    PropertyMap(const PropertyMap &rOther) : mpBegin(maInline), mnSize(0) { assign(rOther); }
+    PropertyMap &operator=(const PropertyMap &rOther);
+
+    iterator begin() { return mpBegin; }
+    iterator end() { return mpBegin + mnSize; }
+    const_iterator begin() const { return mpBegin; }
+    const_iterator end() const { return mpBegin + mnSize; }
+    size_t size() const { return mnSize; }
+    bool empty() const { return mnSize == 0; }
+    void clear();
+    void swap(PropertyMap &rOther);
+
+    iterator find(const rtl::OUString &rName);
+    const_iterator find(const rtl::OUString &rName) const;
+    iterator find(const sal_Char *pName);
+    const_iterator find(const sal_Char *pName) const;
+
+    rtl::OUString &operator[](const rtl::OUString &rName);
+    rtl::OUString &operator[](const sal_Char *pName);
+
+    //Independent of the order the entries were set in
+    bool operator==(const PropertyMap &rOther) const;
+    bool operator!=(const PropertyMap &rOther) const { return !(*this == rOther); }
+};
+
+//The interned copy of the ODF attribute name pName, or a new string if it
+//isn't one this filter knows
+rtl::OUString getPropertyName(const sal_Char *pName, sal_Int32 nLen);
+
+#endif
+
+/* vi:set tabstop=4 shiftwidth=4 expandtab: */
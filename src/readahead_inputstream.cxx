@@ -0,0 +1,236 @@
+/*************************************************************************
+ *
+ * Caolán McNamara
+ * Copyright 2010 by Red Hat, Inc. 
+ *
+ * openoffice.org-diafilter is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 3 or
+ * later, as published by the Free Software Foundation.
+ *
+ * openoffice.org-diafilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ *
+ * You should have received a copy of the GNU General Public License version 3
+ * along with openoffice.org-diafilter.  If not, see
+ * <http://www.gnu.org/copyleft/gpl.html> for a copy of the GPLv3 License.
+ *
+ ************************************************************************/
+
+
+#include <com/sun/star/io/IOException.hpp>
+#include <osl/thread.hxx>
+
+#include <readahead_inputstream.hxx>
+
+#include <algorithm>
+
+#include <string.h>
+
+using namespace com::sun::star;
+
+class ReadaheadThread : public osl::Thread
+{
+private:
+    readahead_InputStream &mrStream;
+public:
+    explicit ReadaheadThread(readahead_InputStream &rStream) : mrStream(rStream) {}
+protected:
+    virtual void SAL_CALL run() { mrStream.produce(); }
+};
+
+readahead_InputStream::readahead_InputStream(const uno::Reference< io::XInputStream > &rxSource,
+    size_t nBuffers, sal_Int32 nBufferSize)
+    : mxSource(rxSource)
+    , mnBufferSize(nBufferSize > 0 ? nBufferSize : READAHEAD_BUFSIZE)
+    , maRing(nBuffers > 1 ? nBuffers : 2)
+    , mnHead(0)
+    , mnCount(0)
+    , mnHeadPos(0)
+    , mbEOF(false)
+    , mbCancel(false)
+    , mbError(false)
+{
+    if (!mxSource.is())
+        throw io::NotConnectedException();
+}
+
+readahead_InputStream::~readahead_InputStream()
+{
+    stop();
+}
+
+bool readahead_InputStream::start()
+{
+    mpThread.reset(new ReadaheadThread(*this));
+    if (!mpThread->create())
+    {
+        mpThread.reset();
+        return false;
+    }
+    return true;
+}
+
+void readahead_InputStream::stop()
+{
+    if (!mpThread)
+        return;
+    {
+        osl::MutexGuard aGuard(maMutex);
+        mbCancel = true;
+        maEmptied.set();
+    }
+    mpThread->join();
+    mpThread.reset();
+}
+
+void readahead_InputStream::produce()
+{
+    try
+    {
+        while (true)
+        {
+            size_t nSlot;
+            {
+                osl::ResettableMutexGuard aGuard(maMutex);
+                while (mnCount == maRing.size() && !mbCancel)
+                {
+                    maEmptied.reset();
+                    aGuard.clear();
+                    maEmptied.wait();
+                    aGuard.reset();
+                }
+                if (mbCancel)
+                    return;
+                nSlot = (mnHead + mnCount) % maRing.size();
+            }
+
+            //The consumer leaves unfilled slots alone, so this one can be
+            //filled without holding the lock
+            sal_Int32 nRead = mxSource->readBytes(maRing[nSlot], mnBufferSize);
+
+            osl::MutexGuard aGuard(maMutex);
+            if (nRead <= 0)
+            {
+                mbEOF = true;
+                maFilled.set();
+                return;
+            }
+            ++mnCount;
+            maFilled.set();
+        }
+    }
+    catch (const uno::Exception &rException)
+    {
+        osl::MutexGuard aGuard(maMutex);
+        mbError = true;
+        msError = rException.Message;
+        maFilled.set();
+    }
+    catch (...)
+    {
+        //Nothing may leave the thread, that would take the office down
+        osl::MutexGuard aGuard(maMutex);
+        mbError = true;
+        msError = rtl::OUString(RTL_CONSTASCII_USTRINGPARAM("read ahead failed"));
+        maFilled.set();
+    }
+}
+
+bool readahead_InputStream::waitForData(osl::ResettableMutexGuard &rGuard)
+{
+    while (!mnCount && !mbEOF && !mbError)
+    {
+        maFilled.reset();
+        rGuard.clear();
+        maFilled.wait();
+        rGuard.reset();
+    }
+    if (mnCount)
+        return true;
+    if (mbError)
+        throw io::IOException(msError, uno::Reference< uno::XInterface >());
+    return false;
+}
+
+//Copy out up to nBytes, or just skip them if pData is NULL
+sal_Int32 readahead_InputStream::consume(sal_Int8 *pData, sal_Int32 nBytes)
+{
+    if (!mpThread)
+        throw io::NotConnectedException();
+
+    sal_Int32 nDone = 0;
+    osl::ResettableMutexGuard aGuard(maMutex);
+    while (nDone < nBytes && waitForData(aGuard))
+    {
+        const uno::Sequence< sal_Int8 > &rBuffer = maRing[mnHead];
+        sal_Int32 nChunk = std::min(nBytes - nDone, rBuffer.getLength() - mnHeadPos);
+        if (pData)
+            memcpy(pData + nDone, rBuffer.getConstArray() + mnHeadPos, nChunk);
+        nDone += nChunk;
+        mnHeadPos += nChunk;
+        if (mnHeadPos == rBuffer.getLength())
+        {
+            mnHead = (mnHead + 1) % maRing.size();
+            --mnCount;
+            mnHeadPos = 0;
+            maEmptied.set();
+        }
+    }
+    return nDone;
+}
+
+sal_Int32 SAL_CALL readahead_InputStream::readBytes( uno::Sequence< sal_Int8 >& aData, sal_Int32 nBytesToRead )
+{
+    if (nBytesToRead < 0)
+        throw io::BufferSizeExceededException();
+
+    if (aData.getLength() != nBytesToRead)
+    {
+        try
+        {
+            aData.realloc( nBytesToRead );
+        }
+        catch ( const uno::Exception & )
+        {
+            throw io::BufferSizeExceededException();
+        }
+    }
+
+    sal_Int32 nRead = consume(aData.getArray(), nBytesToRead);
+    if (nRead < nBytesToRead)
+        aData.realloc(nRead);
+    return nRead;
+}
+
+sal_Int32 SAL_CALL readahead_InputStream::readSomeBytes(
+    uno::Sequence< sal_Int8 >& aData, sal_Int32 nMaxBytesToRead )
+{
+    return readBytes(aData, nMaxBytesToRead);
+}
+
+void SAL_CALL readahead_InputStream::skipBytes( sal_Int32 nBytesToSkip )
+{
+    if (nBytesToSkip > 0)
+        consume(NULL, nBytesToSkip);
+}
+
+sal_Int32 SAL_CALL readahead_InputStream::available()
+{
+    if (!mpThread)
+        throw io::NotConnectedException();
+
+    osl::MutexGuard aGuard(maMutex);
+    sal_Int64 nAvailable = -mnHeadPos;
+    for (size_t i = 0; i < mnCount; ++i)
+        nAvailable += maRing[(mnHead + i) % maRing.size()].getLength();
+    return static_cast<sal_Int32>(std::min<sal_Int64>(SAL_MAX_INT32, nAvailable));
+}
+
+void SAL_CALL readahead_InputStream::closeInput()
+{
+    stop();
+    mxSource->closeInput();
+}
+
+/* vi:set tabstop=4 shiftwidth=4 expandtab: */
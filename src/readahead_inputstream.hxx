@@ -0,0 +1,93 @@
+/*************************************************************************
+ *
+ * Caolán McNamara
+ * Copyright 2010 by Red Hat, Inc. 
+ *
+ * openoffice.org-diafilter is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 3 or
+ * later, as published by the Free Software Foundation.
+ *
+ * openoffice.org-diafilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ *
+ * You should have received a copy of the GNU General Public License version 3
+ * along with openoffice.org-diafilter.  If not, see
+ * <http://www.gnu.org/copyleft/gpl.html> for a copy of the GPLv3 License.
+ *
+ ************************************************************************/
+
+
+#ifndef READAHEAD_INPUTSTREAM_HXX
+#define READAHEAD_INPUTSTREAM_HXX
+
+#include <com/sun/star/io/BufferSizeExceededException.hpp>
+#include <com/sun/star/io/NotConnectedException.hpp>
+#include <com/sun/star/io/XInputStream.hpp>
+#include <cppuhelper/implbase1.hxx>
+#include <osl/mutex.hxx>
+#include <osl/conditn.hxx>
+#include <rtl/ustring.hxx>
+#include <boost/scoped_ptr.hpp>
+#include <vector>
+
+#define READAHEAD_BUFFERS 4
+#define READAHEAD_BUFSIZE 65536
+
+class ReadaheadThread;
+
+//Reads ahead from another XInputStream on a thread of its own into a ring of
+//buffers, so that whatever that stream does to produce its data, e.g.
+//inflating, happens alongside whatever consumes it, e.g. parsing
+class readahead_InputStream :
+    public ::cppu::WeakImplHelper1< ::com::sun::star::io::XInputStream >
+{
+private:
+    ::com::sun::star::uno::Reference< ::com::sun::star::io::XInputStream > mxSource;
+    sal_Int32 mnBufferSize;
+    osl::Mutex maMutex;
+    //signalled when a buffer has been filled or the reader has stopped
+    osl::Condition maFilled;
+    //signalled when a buffer has been used up or the reader should stop
+    osl::Condition maEmptied;
+    std::vector< ::com::sun::star::uno::Sequence< sal_Int8 > > maRing;
+    size_t mnHead;
+    size_t mnCount;
+    sal_Int32 mnHeadPos;
+    bool mbEOF;
+    bool mbCancel;
+    bool mbError;
+    rtl::OUString msError;
+    boost::scoped_ptr< ReadaheadThread > mpThread;
+
+    //Wait until there's something to read, false if there never will be
+    bool waitForData(osl::ResettableMutexGuard &rGuard);
+    sal_Int32 consume(sal_Int8 *pData, sal_Int32 nBytes);
+    void stop();
+public:
+    readahead_InputStream(const ::com::sun::star::uno::Reference< ::com::sun::star::io::XInputStream > &rxSource,
+        size_t nBuffers = READAHEAD_BUFFERS, sal_Int32 nBufferSize = READAHEAD_BUFSIZE);
+    virtual ~readahead_InputStream();
+
+    //Start reading ahead, false if no thread could be had for it in which
+    //case use the original stream
+    bool start();
+    //Run by the reading thread
+    void produce();
+
+    // XInputStream
+    virtual sal_Int32 SAL_CALL readBytes( ::com::sun::star::uno::Sequence< sal_Int8 > & aData,
+        sal_Int32 nBytesToRead );
+
+    virtual sal_Int32 SAL_CALL readSomeBytes( ::com::sun::star::uno::Sequence< sal_Int8 > & aData,
+        sal_Int32 nMaxBytesToRead );
+
+    virtual void SAL_CALL skipBytes( sal_Int32 nBytesToSkip );
+
+    virtual sal_Int32 SAL_CALL available( void );
+
+    virtual void SAL_CALL closeInput( void );
+};
+
+#endif
+/* vi:set tabstop=4 shiftwidth=4 expandtab: */
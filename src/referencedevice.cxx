@@ -0,0 +1,170 @@
+/*************************************************************************
+ *
+ * Caolán McNamara
+ * Copyright 2010 by Red Hat, Inc. 
+ *
+ * openoffice.org-diafilter is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 3 or
+ * later, as published by the Free Software Foundation.
+ *
+ * openoffice.org-diafilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ *
+ * You should have received a copy of the GNU General Public License version 3
+ * along with openoffice.org-diafilter.  If not, see
+ * <http://www.gnu.org/copyleft/gpl.html> for a copy of the GPLv3 License.
+ *
+ ************************************************************************/
+
+
+#include <com/sun/star/beans/PropertyValue.hpp>
+#include <com/sun/star/frame/XDesktop.hpp>
+#include <com/sun/star/frame/XComponentLoader.hpp>
+#include <com/sun/star/frame/XModel.hpp>
+#include <com/sun/star/frame/XTerminateListener.hpp>
+#include <com/sun/star/util/XCloseable.hpp>
+#include <cppuhelper/implbase1.hxx>
+#include <rtl/instance.hxx>
+
+#include "referencedevice.hxx"
+
+#include <stdio.h>
+
+#define USTR(x) rtl::OUString( RTL_CONSTASCII_USTRINGPARAM( x ) )
+
+using namespace com::sun::star;
+
+namespace
+{
+    struct theReferenceDevice : public rtl::Static<ReferenceDevice, theReferenceDevice> {};
+
+    //Closes the hidden document when the office terminates, and notices if
+    //it goes away beforehand
+    class ReferenceDeviceListener : public cppu::WeakImplHelper1< frame::XTerminateListener >
+    {
+    public:
+        // XTerminateListener
+        virtual void SAL_CALL queryTermination(const lang::EventObject &) {}
+        virtual void SAL_CALL notifyTermination(const lang::EventObject &)
+        {
+            ReferenceDevice::get().dispose();
+        }
+        // XEventListener
+        virtual void SAL_CALL disposing(const lang::EventObject &rEvent)
+        {
+            uno::Reference< frame::XDesktop > xDesktop(rEvent.Source, uno::UNO_QUERY);
+            if (!xDesktop.is())
+                ReferenceDevice::get().release();
+        }
+    };
+
+    void closeDocument(const uno::Reference< lang::XComponent > &rxDocument)
+    {
+        if (!rxDocument.is())
+            return;
+
+        try
+        {
+            uno::Reference< util::XCloseable > xCloseable(rxDocument, uno::UNO_QUERY);
+            if (xCloseable.is())
+                xCloseable->close(sal_True);
+            else
+                rxDocument->dispose();
+        }
+        catch (const uno::Exception &)
+        {
+            fprintf(stderr, "Could not close reference device document\n");
+        }
+    }
+}
+
+ReferenceDevice& ReferenceDevice::get()
+{
+    return theReferenceDevice::get();
+}
+
+uno::Reference< awt::XDevice > ReferenceDevice::getDevice(const uno::Reference< uno::XComponentContext > &rxCtx)
+{
+    {
+        osl::MutexGuard aGuard(maMutex);
+        if (mxDevice.is())
+            return mxDevice;
+    }
+
+    //Loading takes the SolarMutex, so don't hold maMutex while doing it or a
+    //thread holding the SolarMutex and waiting on maMutex deadlocks against us
+    uno::Reference< frame::XDesktop > xDesktop(
+        rxCtx->getServiceManager()->createInstanceWithContext(USTR("com.sun.star.frame.Desktop"),
+            rxCtx), uno::UNO_QUERY_THROW);
+    uno::Reference< frame::XComponentLoader > xComponentLoader(xDesktop, uno::UNO_QUERY_THROW);
+
+    uno::Sequence < beans::PropertyValue > aArgs(1);
+    aArgs[0].Name = USTR("Hidden");
+    aArgs[0].Value <<= sal_True;
+
+    uno::Reference< lang::XComponent > xComponent(xComponentLoader->loadComponentFromURL(
+        rtl::OUString(RTL_CONSTASCII_USTRINGPARAM("private:factory/sdraw")),
+        rtl::OUString(RTL_CONSTASCII_USTRINGPARAM("_blank")), 0, aArgs));
+
+    uno::Reference< frame::XModel > xModel(xComponent, uno::UNO_QUERY_THROW);
+    uno::Reference< frame::XController> xController = xModel->getCurrentController();
+    uno::Reference< frame::XFrame > xFrame( xController->getFrame() );
+
+    uno::Reference< awt::XWindow > xWindow( xFrame->getContainerWindow() );
+    uno::Reference< awt::XDevice > xDevice(xWindow, uno::UNO_QUERY_THROW);
+
+    //Another thread may have got there first, in which case use its document
+    //and throw ours away
+    uno::Reference< awt::XDevice > xExisting;
+    bool bAddTerminateListener = false;
+    {
+        osl::MutexGuard aGuard(maMutex);
+        if (mxDevice.is())
+            xExisting = mxDevice;
+        else
+        {
+            mxDevice = xDevice;
+            mxDocument = xComponent;
+            bAddTerminateListener = !mbListening;
+            mbListening = true;
+        }
+    }
+
+    if (xExisting.is())
+    {
+        closeDocument(xComponent);
+        return xExisting;
+    }
+
+    uno::Reference< frame::XTerminateListener > xListener(new ReferenceDeviceListener());
+    if (bAddTerminateListener)
+        xDesktop->addTerminateListener(xListener);
+    xComponent->addEventListener(xListener);
+
+    return xDevice;
+}
+
+void ReferenceDevice::dispose()
+{
+    //Only hold maMutex to take the document, closing it takes the SolarMutex
+    uno::Reference< lang::XComponent > xDocument;
+    {
+        osl::MutexGuard aGuard(maMutex);
+        xDocument = mxDocument;
+        mxDocument.clear();
+        mxDevice.clear();
+        mbListening = false;
+    }
+
+    closeDocument(xDocument);
+}
+
+void ReferenceDevice::release()
+{
+    osl::MutexGuard aGuard(maMutex);
+    mxDocument.clear();
+    mxDevice.clear();
+}
+
+/* vi:set tabstop=4 shiftwidth=4 expandtab: */
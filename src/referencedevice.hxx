@@ -0,0 +1,52 @@
+/*************************************************************************
+ *
+ * Caolán McNamara
+ * Copyright 2010 by Red Hat, Inc. 
+ *
+ * openoffice.org-diafilter is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 3 or
+ * later, as published by the Free Software Foundation.
+ *
+ * openoffice.org-diafilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ *
+ * You should have received a copy of the GNU General Public License version 3
+ * along with openoffice.org-diafilter.  If not, see
+ * <http://www.gnu.org/copyleft/gpl.html> for a copy of the GPLv3 License.
+ *
+ ************************************************************************/
+
+
+#ifndef REFERENCEDEVICE_HXX
+#define REFERENCEDEVICE_HXX
+
+#include <com/sun/star/uno/XComponentContext.hpp>
+#include <com/sun/star/lang/XComponent.hpp>
+#include <com/sun/star/awt/XDevice.hpp>
+#include <osl/mutex.hxx>
+
+//The device text is measured against, taken from a hidden draw document.
+//Only created when something first needs measuring and then shared by every
+//import in the process until the office terminates
+class ReferenceDevice
+{
+private:
+    osl::Mutex maMutex;
+    ::com::sun::star::uno::Reference< ::com::sun::star::lang::XComponent > mxDocument;
+    ::com::sun::star::uno::Reference< ::com::sun::star::awt::XDevice > mxDevice;
+    bool mbListening;
+public:
+    ReferenceDevice() : mbListening(false) {}
+    static ReferenceDevice& get();
+
+    ::com::sun::star::uno::Reference< ::com::sun::star::awt::XDevice > getDevice(
+        const ::com::sun::star::uno::Reference< ::com::sun::star::uno::XComponentContext > &rxCtx);
+    //Close the hidden document
+    void dispose();
+    //Forget the hidden document, someone else has closed it
+    void release();
+};
+
+#endif
+/* vi:set tabstop=4 shiftwidth=4 expandtab: */
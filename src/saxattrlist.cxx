@@ -31,16 +31,16 @@
 
 #include "saxattrlist.hxx"
 
+#include <osl/thread.hxx>
+#include <rtl/instance.hxx>
+
 namespace pdfi
 {
 
-SaxAttrList::SaxAttrList( const boost::unordered_map< rtl::OUString, rtl::OUString, rtl::OUStringHash >& rMap )
+SaxAttrList::SaxAttrList( const PropertyMap& rMap )
 {
     m_aAttributes.reserve(rMap.size());
-    for( boost::unordered_map< rtl::OUString,
-                        rtl::OUString,
-                        rtl::OUStringHash >::const_iterator it = rMap.begin();
-         it != rMap.end(); ++it )
+    for( PropertyMap::const_iterator it = rMap.begin(); it != rMap.end(); ++it )
     {
         m_aIndexMap[ it->first ] = m_aAttributes.size();
         m_aAttributes.push_back( AttrEntry( it->first, it->second ) );
@@ -101,5 +101,160 @@ com::sun::star::uno::Reference< ::com::sun::star::util::XCloneable > SAL_CALL Sa
     return new SaxAttrList( *this );
 }
 
+void PropertyAttrList::reset( const PropertyMap& rAttrs )
+{
+    mpSingle = &rAttrs;
+    mppLayers = &mpSingle;
+    mnLayers = 1;
+}
+
+void PropertyAttrList::reset( const PropertyMap * const * ppLayers, size_t nLayers )
+{
+    mppLayers = ppLayers;
+    mnLayers = nLayers;
+    mbVisibleValid = false;
+}
+
+void PropertyAttrList::take( PropertyMap& rAttrs )
+{
+    maTaken.clear();
+    maTaken.swap( rAttrs );
+    reset( maTaken );
+}
+
+void PropertyAttrList::merge( const PropertyMap * const * ppLayers, size_t nLayers, PropertyMap& rMerged )
+{
+    for( size_t i = nLayers; i > 0; --i )
+    {
+        const PropertyMap& rLayer = *ppLayers[i-1];
+        for( PropertyMap::const_iterator it = rLayer.begin(); it != rLayer.end(); ++it )
+            rMerged[ it->first ] = it->second;
+    }
+}
+
+void PropertyAttrList::ensureVisible()
+{
+    if( mbVisibleValid )
+        return;
+    maVisible.clear();
+    for( size_t i = 0; i < mnLayers; ++i )
+    {
+        const PropertyMap& rLayer = *mppLayers[i];
+        for( PropertyMap::const_iterator it = rLayer.begin(); it != rLayer.end(); ++it )
+        {
+            bool bHidden = false;
+            for( size_t j = 0; j < i && !bHidden; ++j )
+                bHidden = mppLayers[j]->find( it->first ) != mppLayers[j]->end();
+            if( !bHidden )
+                maVisible.push_back( &*it );
+        }
+    }
+    mbVisibleValid = true;
+}
+
+const PropertyMap::value_type* PropertyAttrList::getByIndex( sal_Int16 i_nIndex )
+{
+    if( i_nIndex < 0 || i_nIndex >= getLength() )
+        return NULL;
+    if( mnLayers == 1 )
+        return mppLayers[0]->begin() + i_nIndex;
+    return maVisible[i_nIndex];
+}
+
+const PropertyMap::value_type* PropertyAttrList::getByName( const rtl::OUString& rName ) const
+{
+    //there are too few attributes for an index to pay off over a scan
+    for( size_t i = 0; i < mnLayers; ++i )
+    {
+        PropertyMap::const_iterator it = mppLayers[i]->find( rName );
+        if( it != mppLayers[i]->end() )
+            return &*it;
+    }
+    return NULL;
+}
+
+sal_Int16 SAL_CALL PropertyAttrList::getLength()
+{
+    if( mnLayers == 1 )
+        return sal_Int16(mppLayers[0]->size());
+    ensureVisible();
+    return sal_Int16(maVisible.size());
+}
+
+rtl::OUString SAL_CALL PropertyAttrList::getNameByIndex( sal_Int16 i_nIndex )
+{
+    const PropertyMap::value_type* pEntry = getByIndex( i_nIndex );
+    return pEntry ? pEntry->first : rtl::OUString();
+}
+
+rtl::OUString SAL_CALL PropertyAttrList::getTypeByIndex( sal_Int16 i_nIndex )
+{
+    return getByIndex( i_nIndex ) ? getCDATAString() : rtl::OUString();
+}
+
+rtl::OUString SAL_CALL PropertyAttrList::getTypeByName( const ::rtl::OUString& i_rName )
+{
+    return getByName( i_rName ) ? getCDATAString() : rtl::OUString();
+}
+
+rtl::OUString SAL_CALL PropertyAttrList::getValueByIndex( sal_Int16 i_nIndex )
+{
+    const PropertyMap::value_type* pEntry = getByIndex( i_nIndex );
+    return pEntry ? pEntry->second : rtl::OUString();
+}
+
+rtl::OUString SAL_CALL PropertyAttrList::getValueByName( const ::rtl::OUString& i_rName )
+{
+    const PropertyMap::value_type* pEntry = getByName( i_rName );
+    return pEntry ? pEntry->second : rtl::OUString();
+}
+
+com::sun::star::uno::Reference< ::com::sun::star::util::XCloneable > SAL_CALL PropertyAttrList::createClone()
+{
+    PropertyMap aMerged;
+    merge( mppLayers, mnLayers, aMerged );
+    return new SaxAttrList( aMerged );
+}
+
+namespace {
+    struct theCurrentPool : public rtl::Static< osl::ThreadData, theCurrentPool > {};
+}
+
+PropertyAttrList* SaxAttrListPool::get()
+{
+    //Elements are written one after another so usually the first list is
+    //already free again, only a handler that keeps hold of one costs more
+    for( size_t i = 0; i < maLists.size(); ++i )
+    {
+        if( !maLists[i]->isHeld() )
+            return maLists[i].get();
+    }
+    maLists.push_back( new PropertyAttrList );
+    return maLists.back().get();
+}
+
+PropertyAttrList* SaxAttrListPool::getEmpty()
+{
+    if( !mxEmpty.is() )
+        mxEmpty = new PropertyAttrList;
+    return mxEmpty.get();
+}
+
+SaxAttrListPool* SaxAttrListPool::current()
+{
+    return static_cast< SaxAttrListPool* >( theCurrentPool::get().getData() );
+}
+
+SaxAttrListPool::Scope::Scope( SaxAttrListPool& rPool ) :
+    mpPrevious( current() )
+{
+    theCurrentPool::get().setData( &rPool );
+}
+
+SaxAttrListPool::Scope::~Scope()
+{
+    theCurrentPool::get().setData( mpPrevious );
+}
+
 }
 
@@ -36,6 +36,9 @@
 #include <vector>
 #include <boost/unordered_map.hpp>
 #include <cppuhelper/implbase2.hxx>
+#include <rtl/ref.hxx>
+
+#include "propertymap.hxx"
 
 #include <com/sun/star/util/XCloneable.hpp>
 #include <com/sun/star/xml/sax/XAttributeList.hpp>
@@ -60,7 +63,7 @@ namespace pdfi
     
     public:
         SaxAttrList() {}
-        SaxAttrList( const boost::unordered_map< rtl::OUString, rtl::OUString, rtl::OUStringHash >& );
+        SaxAttrList( const PropertyMap& );
         SaxAttrList( const SaxAttrList& );
         virtual ~SaxAttrList();
     
@@ -75,6 +78,81 @@ namespace pdfi
         // ::com::sun::star::util::XCloneable
         virtual ::com::sun::star::uno::Reference< ::com::sun::star::util::XCloneable > SAL_CALL createClone();
     };
+
+    //An XAttributeList over a PropertyMap that stays owned by the caller, so
+    //nothing is copied or indexed to write an element. The map has to stay
+    //alive and unchanged until the matching endElement, not just for the
+    //startElement it's passed to. xmloff keeps hold of some lists, e.g.
+    //SdXMLFrameShapeContext reads the draw:frame attributes again when its
+    //draw:text-box or draw:image child starts
+    class PropertyAttrList : public ::cppu::WeakImplHelper2<
+		    com::sun::star::xml::sax::XAttributeList,
+            com::sun::star::util::XCloneable
+            >
+    {
+        //The maps to read, topmost first, where a name in an upper map hides
+        //the same name further down
+        const PropertyMap * const *mppLayers;
+        size_t mnLayers;
+        const PropertyMap *mpSingle;
+        PropertyMap maTaken;
+        //With more than one layer, the entries left visible, built on the
+        //first access by index
+        std::vector< const PropertyMap::value_type* > maVisible;
+        bool mbVisibleValid;
+
+        void ensureVisible();
+        const PropertyMap::value_type *getByIndex( sal_Int16 i_nIndex );
+        const PropertyMap::value_type *getByName( const rtl::OUString& rName ) const;
+
+    public:
+        PropertyAttrList() : mppLayers(&mpSingle), mnLayers(1), mpSingle(&maTaken), mbVisibleValid(false) {}
+        void reset(const PropertyMap &rAttrs);
+        //Reads through the nLayers maps of ppLayers, without merging them.
+        //The array is the caller's and has to last as long as the maps
+        void reset(const PropertyMap * const *ppLayers, size_t nLayers);
+        //Takes over the contents of rAttrs, leaving it empty
+        void take(PropertyMap &rAttrs);
+        //The attributes as one map, what a merge of the layers would give
+        static void merge(const PropertyMap * const *ppLayers, size_t nLayers, PropertyMap &rMerged);
+        //Whether anyone other than its pool still holds a reference
+        bool isHeld() const { return m_refCount > 1; }
+
+        // ::com::sun::star::xml::sax::XAttributeList
+        virtual sal_Int16 SAL_CALL getLength();
+        virtual rtl::OUString SAL_CALL getNameByIndex(sal_Int16 i);
+        virtual rtl::OUString SAL_CALL getTypeByIndex(sal_Int16 i);
+        virtual rtl::OUString SAL_CALL getTypeByName(const ::rtl::OUString& aName);
+        virtual rtl::OUString SAL_CALL getValueByIndex(sal_Int16 i);
+        virtual rtl::OUString SAL_CALL getValueByName(const ::rtl::OUString& aName);
+
+        // ::com::sun::star::util::XCloneable
+        virtual ::com::sun::star::uno::Reference< ::com::sun::star::util::XCloneable > SAL_CALL createClone();
+    };
+
+    //The PropertyAttrLists of one import, handed out again once the document
+    //handler has let go of them, and one empty list shared by every element
+    //without attributes. Whichever pool has a Scope alive on the current
+    //thread is the one makeXAttribute and friends draw from
+    class SaxAttrListPool
+    {
+        std::vector< rtl::Reference< PropertyAttrList > > maLists;
+        rtl::Reference< PropertyAttrList > mxEmpty;
+
+    public:
+        PropertyAttrList *get();
+        PropertyAttrList *getEmpty();
+
+        static SaxAttrListPool *current();
+
+        class Scope
+        {
+            SaxAttrListPool *mpPrevious;
+        public:
+            explicit Scope(SaxAttrListPool &rPool);
+            ~Scope();
+        };
+    };
 }
 
 #endif
@@ -21,7 +21,6 @@
 #include <com/sun/star/xml/dom/XDocumentBuilder.hpp>
 #include <com/sun/star/io/IOException.hpp>
 #include <com/sun/star/io/XSeekable.hpp>
-#include <comphelper/string.hxx>
 #include <basegfx/polygon/b2dpolypolygontools.hxx>
 #include <basegfx/polygon/b2dpolypolygon.hxx>
 #include <basegfx/polygon/b2dpolygontools.hxx>
@@ -29,6 +28,9 @@
 
 #include "filters.hxx"
 #include "shapefilter.hxx"
+#include "gz_inputstream.hxx"
+
+#include <rtl/ustrbuf.hxx>
 
 #include <vector>
 #include <algorithm>
@@ -57,7 +59,7 @@ protected:
 public:
     ShapeObject(basegfx::B2DPolyPolygon &rScene) : mrScene(rScene), msFill(USTR("none")), mnStrokeScale(1.0) {}
     void import(const uno::Reference<xml::dom::XNamedNodeMap> xAttributes);
-    void generateStyle(GraphicStyleManager &rStyleManager, const PropertyMap &rParentProps, PropertyMap &rShapeOverrides, bool bShowBackground) const;
+    void generateStyle(GraphicStyleManager &rStyleManager, const PropertyMap &rParentProps, PropertyMap &rShapeOverrides, bool bShowBackground, double fStrokeWidth) const;
     void write(uno::Reference < xml::sax::XDocumentHandler > &rxDocHandler, const PropertyMap &rParentProps, const PropertyMap &rShapeOverride, float x, float y, float hscale, float vscale) const;
     virtual ~ShapeObject() {}
 };
@@ -66,9 +68,9 @@ bool ShapeObject::importAttribute(const uno::Reference<xml::dom::XNode> &rxNode)
 {
     rtl::OUString sAttribute = rxNode->getNodeName();
     if (sAttribute == USTR("points"))
-        maAttrs[USTR("draw:points")] = rxNode->getNodeValue().trim();
+        maAttrs["draw:points"] = rxNode->getNodeValue().trim();
     else if (sAttribute == USTR("d"))
-        maAttrs[USTR("svg:d")] = rxNode->getNodeValue();
+        maAttrs["svg:d"] = rxNode->getNodeValue();
     else if (sAttribute == USTR("stroke-dasharray"))
         /*Ignore, gnome#625381*/;
     else if (sAttribute == USTR("style"))
@@ -126,7 +128,7 @@ bool ShapeObject::importAttribute(const uno::Reference<xml::dom::XNode> &rxNode)
     return true;
 }
 
-void ShapeObject::generateStyle(GraphicStyleManager &rStyleManager, const PropertyMap &rParentProps, PropertyMap &rShapeOverrides, bool bShowBackground) const
+void ShapeObject::generateStyle(GraphicStyleManager &rStyleManager, const PropertyMap &rParentProps, PropertyMap &rShapeOverrides, bool bShowBackground, double fStrokeWidth) const
 {
 #if 0
     fprintf(stderr, "ShapeObject::generateStyle, width of %f\n", mnStrokeScale);
@@ -146,33 +148,36 @@ void ShapeObject::generateStyle(GraphicStyleManager &rStyleManager, const Proper
     PropertyMap aStyleAttrs(rParentProps);
     //Show no background at all
     if (!bShowBackground)
-        aStyleAttrs[USTR("draw:fill")] = USTR("none");
+        aStyleAttrs["draw:fill"] = USTR("none");
     else if (msFill.getLength() && msFill.compareToAscii("background") != 0 && msFill.compareToAscii("bg") != 0 && msFill.compareToAscii("default") != 0)
     {
         //if the shape's background isn't a placeholder "background" or "bg",
         //then force in the exact colours needed
         if (msFill.compareToAscii("none") == 0)
-            aStyleAttrs[USTR("draw:fill")] = msFill;
+            aStyleAttrs["draw:fill"] = msFill;
         else if ((msFill.compareToAscii("foreground") == 0) || (msFill.compareToAscii("fg") == 0))
-            aStyleAttrs[USTR("draw:fill-color")] = aStyleAttrs[USTR("svg:stroke-color")];
+        {
+            //copied out first, adding one key may move the other
+            rtl::OUString sColor = aStyleAttrs["svg:stroke-color"];
+            aStyleAttrs["draw:fill-color"] = sColor;
+        }
         else
-            aStyleAttrs[USTR("draw:fill-color")] = msFill;
+            aStyleAttrs["draw:fill-color"] = msFill;
     }
     if (msStroke.getLength() && msStroke.compareToAscii("foreground") != 0 && msStroke.compareToAscii("fg") != 0 && msStroke.compareToAscii("default"))
     {
         if (msStroke.compareToAscii("none") == 0)
-            aStyleAttrs[USTR("draw:stroke")] = msStroke;
+            aStyleAttrs["draw:stroke"] = msStroke;
         else if ((msStroke.compareToAscii("background") == 0) || (msStroke.compareToAscii("bg") == 0))
-            aStyleAttrs[USTR("svg:stroke-color")] = aStyleAttrs[USTR("draw:fill-color")];
+        {
+            rtl::OUString sColor = aStyleAttrs["draw:fill-color"];
+            aStyleAttrs["svg:stroke-color"] = sColor;
+        }
         else
-            aStyleAttrs[USTR("svg:stroke-color")] = msStroke;
+            aStyleAttrs["svg:stroke-color"] = msStroke;
     }
     if (mnStrokeScale != 1.0)
-    {
-        PropertyMap::const_iterator aI = rParentProps.find(USTR("svg:stroke-width"));
-        float width = aI != rParentProps.end() ? ::comphelper::string::searchAndReplaceAllAsciiWithAscii(aI->second, "cm", "").toFloat() : 0.10;
-        aStyleAttrs[USTR("svg:stroke-width")] = rtl::OUString::number(width*mnStrokeScale) + USTR("cm");
-    }
+        aStyleAttrs["svg:stroke-width"] = formatNumber(fStrokeWidth*mnStrokeScale, "cm");
 
 #if 0
     {
@@ -227,35 +232,24 @@ namespace
     }
 }
 
-void createViewportFromPoints(const rtl::OUString &rPoints, PropertyMap &rAttrs,
-    float fAdjustX, float fAdjustY)
+basegfx::B2DRange createViewportFromPoints(const std::vector< basegfx::B2DPoint > &rPoints, PropertyMap &rAttrs,
+    double fAdjustX, double fAdjustY)
 {
-    basegfx::B2DPolygon aPoly;
-
-    bool bSuccess = basegfx::tools::importFromSvgPoints( aPoly, rPoints );
-    if (!bSuccess)
-    {
-        fprintf(stderr, "Import from %s failed\n",
-            rtl::OUStringToOString(rPoints, RTL_TEXTENCODING_UTF8).getStr());
-    }
-
-    basegfx::B2DRange aRange = aPoly.getB2DRange();
+    basegfx::B2DRange aRange;
+    std::vector< basegfx::B2DPoint >::const_iterator aEnd = rPoints.end();
+    for (std::vector< basegfx::B2DPoint >::const_iterator aI = rPoints.begin(); aI != aEnd; ++aI)
+        aRange.expand(*aI);
 
-    float x = aRange.getMinX();
-    float y = aRange.getMinY();
-    float width = aRange.getWidth();
-    float height = aRange.getHeight();
+    double x = aRange.getMinX();
+    double y = aRange.getMinY();
+    double width = aRange.getWidth();
+    double height = aRange.getHeight();
 
-    rAttrs[USTR("svg:x")] = rtl::OUString::number(x+fAdjustX) + USTR("cm");
-    rAttrs[USTR("svg:y")] = rtl::OUString::number(y+fAdjustY) + USTR("cm");
-    rAttrs[USTR("svg:width")] = rtl::OUString::number(safeDimension(width)) + USTR("cm");
-    rAttrs[USTR("svg:height")] = rtl::OUString::number(safeDimension(height)) + USTR("cm");
+    rAttrs["svg:viewBox"] = formatViewBox(x, y,
+        safeViewPortDimension(width), safeViewPortDimension(height));
 
-    rAttrs[USTR("svg:viewBox")] =
-        rtl::OUString::number(x) + USTR(" ") +
-        rtl::OUString::number(y) + USTR(" ") +
-        rtl::OUString::number(safeViewPortDimension(width)) + USTR(" ") +
-        rtl::OUString::number(safeViewPortDimension(height));
+    return basegfx::B2DRange(x+fAdjustX, y+fAdjustY,
+        x+fAdjustX+safeDimension(width), y+fAdjustY+safeDimension(height));
 }
 
 void createViewportAndPolygonFromPoints(const rtl::OUString &rPoints, PropertyMap &rAttrs, basegfx::B2DPolygon &rPoly, bool bClose)
@@ -276,11 +270,10 @@ void createViewportAndPolygonFromPoints(const rtl::OUString &rPoints, PropertyMa
     aMatrix.scale( 10, 10 );
     aPolyPoly.transform( aMatrix );
 
-    rAttrs[USTR("svg:viewBox")] = USTR("0 0 ") +
-        rtl::OUString::number(safeViewPortDimension(aRange.getWidth())) + USTR(" ") +
-        rtl::OUString::number(safeViewPortDimension(aRange.getHeight()));
+    rAttrs["svg:viewBox"] = formatViewBox(0, 0,
+        safeViewPortDimension(aRange.getWidth()), safeViewPortDimension(aRange.getHeight()));
     rtl::OUString sNewString = basegfx::tools::exportToSvgD( aPolyPoly );
-    rAttrs[USTR("svg:d")] = sNewString;
+    rAttrs["svg:d"] = sNewString;
 }
 
 void createViewportAndPolygonFromPoints(const rtl::OUString &rPoints, PropertyMap &rAttrs, bool bClose)
@@ -313,38 +306,24 @@ void ShapeObject::setPosAndSize(PropertyMap &rAttrs, float x, float y, float hsc
     float relx = aRange.getMinX() - aSceneRange.getMinX();
     float rely = aRange.getMinY() - aSceneRange.getMinY();
 
-    rAttrs[USTR("svg:x")] = rtl::OUString::number(x+relx*hscale) + USTR("cm");
-    rAttrs[USTR("svg:y")] = rtl::OUString::number(y+rely*vscale) + USTR("cm");
-    rAttrs[USTR("svg:width")] = rtl::OUString::number(safeDimension(aRange.getWidth()*hscale)) + USTR("cm");
-    rAttrs[USTR("svg:height")] = rtl::OUString::number(safeDimension(aRange.getHeight()*vscale)) + USTR("cm");
+    rAttrs["svg:x"] = formatNumber(x+relx*hscale, "cm");
+    rAttrs["svg:y"] = formatNumber(y+rely*vscale, "cm");
+    rAttrs["svg:width"] = formatNumber(safeDimension(aRange.getWidth()*hscale), "cm");
+    rAttrs["svg:height"] = formatNumber(safeDimension(aRange.getHeight()*vscale), "cm");
 }
 
 void ShapeObject::write(uno::Reference < xml::sax::XDocumentHandler > &rxDocHandler, const PropertyMap &rParentProps, const PropertyMap &rShapeOverrides, float x, float y, float hscale, float vscale) const
 {
-    PropertyMap aProps;
-
-    //Make a copy of the outside properties as defaults
-    {
-        PropertyMap::const_iterator aEnd = rParentProps.end();
-        for (PropertyMap::const_iterator aI = rParentProps.begin(); aI != aEnd; ++aI)
-            aProps[aI->first] = aI->second;
-    }
-    //Overwrite with our properties
-    {
-        PropertyMap::const_iterator aEnd = maAttrs.end();
-        for (PropertyMap::const_iterator aI = maAttrs.begin(); aI != aEnd; ++aI)
-            aProps[aI->first] = aI->second;
-    }
-    //Overwrite with custom backgrounds/foregrounds
-    {
-        PropertyMap::const_iterator aEnd = rShapeOverrides.end();
-        for (PropertyMap::const_iterator aI = rShapeOverrides.begin(); aI != aEnd; ++aI)
-            aProps[aI->first] = aI->second;
-    }
-    //Set size and position
-    setPosAndSize(aProps, x, y, hscale, vscale);
+    //Size and position, then custom backgrounds/foregrounds, then our
+    //properties, and the outside properties as defaults
+    PropertyMap aPosAndSize;
+    setPosAndSize(aPosAndSize, x, y, hscale, vscale);
+    const PropertyMap *aLayers[] = { &aPosAndSize, &rShapeOverrides, &maAttrs, &rParentProps };
+    const size_t nLayers = sizeof(aLayers) / sizeof(aLayers[0]);
 
 #ifdef DEBUG
+    PropertyMap aProps;
+    pdfi::PropertyAttrList::merge(aLayers, nLayers, aProps);
     PropertyMap::iterator aEnd = aProps.end();
     for (PropertyMap::iterator aI = aProps.begin(); aI != aEnd; ++aI)
     {
@@ -355,7 +334,7 @@ void ShapeObject::write(uno::Reference < xml::sax::XDocumentHandler > &rxDocHand
     }
 #endif
 
-    rxDocHandler->startElement(getTagName(), makeXAttribute(aProps));
+    rxDocHandler->startElement(getTagName(), makeXAttribute(aLayers, nLayers));
     rxDocHandler->endElement(getTagName());
 }
 
@@ -406,11 +385,10 @@ void createViewportAndPathFromPath(const rtl::OUString &rPath, PropertyMap &rAtt
     aMatrix.scale( 10, 10 );
     aPolyPoly.transform( aMatrix );
 
-    rAttrs[USTR("svg:viewBox")] = USTR("0 0 ") +
-        rtl::OUString::number(safeViewPortDimension(aRange.getWidth())) + USTR(" ") +
-        rtl::OUString::number(safeViewPortDimension(aRange.getHeight()));
+    rAttrs["svg:viewBox"] = formatViewBox(0, 0,
+        safeViewPortDimension(aRange.getWidth()), safeViewPortDimension(aRange.getHeight()));
     rtl::OUString sNewString = basegfx::tools::exportToSvgD( aPolyPoly );
-    rAttrs[USTR("svg:d")] = sNewString;
+    rAttrs["svg:d"] = sNewString;
 }
 
 void createViewportAndPathFromPath(const rtl::OUString &rPath, PropertyMap &rAttrs)
@@ -535,12 +513,12 @@ void ShapeLine::setPosAndSize(PropertyMap &rAttrs, float x, float y, float hscal
     float rely;
     relx = x1 - aSceneRange.getMinX();
     rely = y1 - aSceneRange.getMinY();
-    rAttrs[USTR("svg:x1")] = rtl::OUString::number(x+relx*hscale) + USTR("cm");
-    rAttrs[USTR("svg:y1")] = rtl::OUString::number(y+rely*vscale) + USTR("cm");
+    rAttrs["svg:x1"] = formatNumber(x+relx*hscale, "cm");
+    rAttrs["svg:y1"] = formatNumber(y+rely*vscale, "cm");
     relx = x2 - aSceneRange.getMinX();
     rely = y2 - aSceneRange.getMinY();
-    rAttrs[USTR("svg:x2")] = rtl::OUString::number(x+relx*hscale) + USTR("cm");
-    rAttrs[USTR("svg:y2")] = rtl::OUString::number(y+rely*vscale) + USTR("cm");
+    rAttrs["svg:x2"] = formatNumber(x+relx*hscale, "cm");
+    rAttrs["svg:y2"] = formatNumber(y+rely*vscale, "cm");
 }
 
 void ShapeObject::import(const uno::Reference<xml::dom::XNamedNodeMap> xAttributes)
@@ -626,9 +604,9 @@ void ShapeImporter::writeConnectionPoints(uno::Reference < xml::sax::XDocumentHa
             float rely = cy - aSceneRange.getMinY();
             cx = -5+relx*chscale;
             cy = -5+rely*cvscale;
-            aProps[USTR("svg:x")] = rtl::OUString::number(cx) + USTR("cm");
-            aProps[USTR("svg:y")] = rtl::OUString::number(cy) + USTR("cm");
-            aProps[USTR("draw:id")] = rtl::OUString::number(id++);
+            aProps["svg:x"] = formatNumber(cx, "cm");
+            aProps["svg:y"] = formatNumber(cy, "cm");
+            aProps["draw:id"] = rtl::OUString::number(id++);
 
             rxDocHandler->startElement(USTR("draw:glue-point"), makeXAttributeAndClear(aProps));
             rxDocHandler->endElement(USTR("draw:glue-point"));
@@ -637,29 +615,27 @@ void ShapeImporter::writeConnectionPoints(uno::Reference < xml::sax::XDocumentHa
 }
 
 void writeText(uno::Reference<xml::sax::XDocumentHandler> &rDocHandler, 
-    const PropertyMap &rTextProps, const rtl::OUString &rString)
+    const PropertyMap &rTextProps, const std::vector< rtl::OUString > &rLines)
 {
-    rDocHandler->startElement(USTR("text:p"), new SaxAttrList(rTextProps));
-    sal_Int32 nIndex=0;
-    do
+    rDocHandler->startElement(USTR("text:p"), makeXAttribute(rTextProps));
+    std::vector< rtl::OUString >::const_iterator aEnd = rLines.end();
+    for (std::vector< rtl::OUString >::const_iterator aI = rLines.begin(); aI != aEnd; ++aI)
     {
-        rDocHandler->startElement(USTR("text:span"), uno::Reference<xml::sax::XAttributeList>());
-        rtl::OUString sSpan = rString.getToken(0, '\n', nIndex);
-        rDocHandler->characters(sSpan);
-        rDocHandler->endElement(USTR("text:span"));
-        if (nIndex >= 0)
+        if (aI != rLines.begin())
         {
             rDocHandler->startElement(USTR("text:span"), uno::Reference<xml::sax::XAttributeList>());
             rDocHandler->startElement(USTR("text:line-break"), uno::Reference<xml::sax::XAttributeList>());
             rDocHandler->endElement(USTR("text:line-break"));
             rDocHandler->endElement(USTR("text:span"));
         }
+        rDocHandler->startElement(USTR("text:span"), uno::Reference<xml::sax::XAttributeList>());
+        rDocHandler->characters(*aI);
+        rDocHandler->endElement(USTR("text:span"));
     }
-    while ( nIndex >= 0 );
     rDocHandler->endElement(USTR("text:p"));
 }
 
-void ShapeImporter::writeTextBox(uno::Reference < xml::sax::XDocumentHandler >& rxDocHandler, float x, float y, float hscale, float vscale, const PropertyMap &rTextProps, const rtl::OUString &rString) const
+void ShapeImporter::writeTextBox(uno::Reference < xml::sax::XDocumentHandler >& rxDocHandler, float x, float y, float hscale, float vscale, const PropertyMap &rTextProps, const std::vector< rtl::OUString > &rLines) const
 {
     if (maTextBox.isEmpty())
         return;
@@ -670,14 +646,14 @@ void ShapeImporter::writeTextBox(uno::Reference < xml::sax::XDocumentHandler >&
     float rely = maTextBox.getMinY() - aSceneRange.getMinY();
 
     PropertyMap aTextAttrs;
-    aTextAttrs[USTR("draw:style-name")] = USTR("grtext");
-    aTextAttrs[USTR("svg:x")] = rtl::OUString::number(x+relx*hscale) + USTR("cm");
-    aTextAttrs[USTR("svg:y")] = rtl::OUString::number(y+rely*vscale) + USTR("cm");
-    aTextAttrs[USTR("svg:width")] = rtl::OUString::number(safeDimension(maTextBox.getWidth()*hscale)) + USTR("cm");
-    aTextAttrs[USTR("svg:height")] = rtl::OUString::number(safeDimension(maTextBox.getHeight()*vscale)) + USTR("cm");
-    rxDocHandler->startElement(USTR("draw:frame"), new SaxAttrList(aTextAttrs));
-    rxDocHandler->startElement(USTR("draw:text-box"), new SaxAttrList(PropertyMap()));
-    writeText(rxDocHandler, rTextProps, rString);
+    aTextAttrs["draw:style-name"] = USTR("grtext");
+    aTextAttrs["svg:x"] = formatNumber(x+relx*hscale, "cm");
+    aTextAttrs["svg:y"] = formatNumber(y+rely*vscale, "cm");
+    aTextAttrs["svg:width"] = formatNumber(safeDimension(maTextBox.getWidth()*hscale), "cm");
+    aTextAttrs["svg:height"] = formatNumber(safeDimension(maTextBox.getHeight()*vscale), "cm");
+    rxDocHandler->startElement(USTR("draw:frame"), makeXAttribute(aTextAttrs));
+    rxDocHandler->startElement(USTR("draw:text-box"), makeEmptyXAttribute());
+    writeText(rxDocHandler, rTextProps, rLines);
     rxDocHandler->endElement(USTR("draw:text-box"));
     rxDocHandler->endElement(USTR("draw:frame"));
 }
@@ -762,13 +738,29 @@ bool ShapeImporter::import(uno::Reference < xml::dom::XElement > xDocElem)
         const sal_Int32 nNumNodes( xNameNodes->getLength() );
         for( sal_Int32 i=0; i<nNumNodes; ++i )
         {
-            uno::Reference<xml::dom::XNodeList> xSubChildren( xNameNodes->item(i)->getChildNodes() );
+            uno::Reference<xml::dom::XElement> xElem(xNameNodes->item(i), uno::UNO_QUERY);
+            if (!xElem.is() || !isTitleTag(xElem->getTagName()))
+                continue;
+            uno::Reference<xml::dom::XNodeList> xSubChildren( xElem->getChildNodes() );
             const sal_Int32 nNumSubNodes( xSubChildren->getLength() );
-            if( nNumSubNodes == 1 && xSubChildren->item(0)->getNodeType() == xml::dom::NodeType_TEXT_NODE )
-                msTitle = xSubChildren->item(0)->getNodeValue();
+            rtl::OUStringBuffer aTitle;
+            bool bJustText = true;
+            for( sal_Int32 j=0; j<nNumSubNodes && bJustText; ++j )
+            {
+                uno::Reference<xml::dom::XNode> xChild( xSubChildren->item(j) );
+                const xml::dom::NodeType eType( xChild->getNodeType() );
+                if( eType == xml::dom::NodeType_TEXT_NODE || eType == xml::dom::NodeType_CDATA_SECTION_NODE )
+                    aTitle.append(xChild->getNodeValue());
+                else if( eType == xml::dom::NodeType_ELEMENT_NODE )
+                    bJustText = false;
+            }
+            if( !bJustText || !aTitle.getLength() )
+                continue;
+            msTitle = aTitle.makeStringAndClear();
 #if 0
             fprintf(stderr, "Title is %s\n", rtl::OUStringToOString(msTitle, RTL_TEXTENCODING_UTF8).getStr());
 #endif
+            break;
         }
     }
 
@@ -862,26 +854,22 @@ ShapeTemplate::ShapeTemplate(shapeimporter aImporter)
 }
 
 void ShapeTemplate::convertShapes(uno::Reference < xml::sax::XDocumentHandler >& rxDocHandler,
-    const PropertyMap &rParentProps, const PropertyMap &rTextProps, const rtl::OUString &rString) const
+    const basegfx::B2DRange &rFrame, const PropertyMap &rParentProps,
+    const PropertyMap &rTextProps, const std::vector< rtl::OUString > &rLines) const
 {
 #if 0
     fprintf(stderr, "scene has %d shapes\n", maScene.count());
 #endif
 
-    PropertyMap::const_iterator aI;
-    aI = rParentProps.find(USTR("svg:x"));
-    float x = aI != rParentProps.end() ? ::comphelper::string::searchAndReplaceAllAsciiWithAscii(aI->second, "cm", "").toFloat() : 0;
-    aI = rParentProps.find(USTR("svg:y"));
-    float y = aI != rParentProps.end() ? ::comphelper::string::searchAndReplaceAllAsciiWithAscii(aI->second, "cm", "").toFloat() : 0;
-    aI = rParentProps.find(USTR("svg:width"));
-    float width = aI != rParentProps.end() ? ::comphelper::string::searchAndReplaceAllAsciiWithAscii(aI->second, "cm", "").toFloat() : DEFAULTSIZE;
-    aI = rParentProps.find(USTR("svg:height"));
-    float height = aI != rParentProps.end() ? ::comphelper::string::searchAndReplaceAllAsciiWithAscii(aI->second, "cm", "").toFloat() : DEFAULTSIZE;
+    float x = rFrame.getMinX();
+    float y = rFrame.getMinY();
+    float width = rFrame.getWidth();
+    float height = rFrame.getHeight();
 
     PropertyMap aProps;
-    aI = rParentProps.find(USTR("draw:id"));
+    PropertyMap::const_iterator aI = rParentProps.find("draw:id");
     if (aI != rParentProps.end())
-        aProps[USTR("draw:id")] = aI->second;
+        aProps["draw:id"] = aI->second;
 
     rxDocHandler->startElement(USTR("draw:g"), makeXAttribute(aProps));
 
@@ -899,13 +887,13 @@ void ShapeTemplate::convertShapes(uno::Reference < xml::sax::XDocumentHandler >&
         (*aI)->write(rxDocHandler, rParentProps, *shapeoverride, x, y, hscale, vscale);
     }
 
-    maImporter->writeTextBox(rxDocHandler, x, y, hscale, vscale, rTextProps, rString);
+    maImporter->writeTextBox(rxDocHandler, x, y, hscale, vscale, rTextProps, rLines);
 
     rxDocHandler->endElement(USTR("draw:g"));
 }
 
 void ShapeTemplate::generateStyles(GraphicStyleManager &rStyleManager,
-    const PropertyMap &rParentProps, bool bShowBackground)
+    const PropertyMap &rParentProps, bool bShowBackground, double fStrokeWidth)
 {
     const shapevec &rShapes = maImporter->getShapes();
     shapevec::const_iterator aEnd = rShapes.end();
@@ -914,7 +902,7 @@ void ShapeTemplate::generateStyles(GraphicStyleManager &rStyleManager,
     PropertyMap aParentProps(rParentProps);
     for (shapevec::const_iterator aI = rShapes.begin(); aI != aEnd; ++aI)
     {
-        (*aI)->generateStyle(rStyleManager, aParentProps, aShapeOverrides, bShowBackground);
+        (*aI)->generateStyle(rStyleManager, aParentProps, aShapeOverrides, bShowBackground, fStrokeWidth);
         maShapeOverrideProps.push_back(aShapeOverrides);
         aShapeOverrides.clear();
     }
@@ -922,48 +910,51 @@ void ShapeTemplate::generateStyles(GraphicStyleManager &rStyleManager,
 
 bool DIAShapeFilter::convert(const ShapeTemplate &rTemplate, uno::Reference < xml::sax::XDocumentHandler > xDocHandler)
 {
+    SaxAttrListPool aAttrLists;
+    SaxAttrListPool::Scope aAttrListScope(aAttrLists);
+
     xDocHandler->startDocument();
 
     PropertyMap aAttrs;
 
-    aAttrs[USTR("xmlns:office")] = USTR(OASIS_STR "office:1.0");
-    aAttrs[USTR("xmlns:style")] = USTR(OASIS_STR "style:1.0");
-    aAttrs[USTR("xmlns:text")] = USTR(OASIS_STR "text:1.0");
-    aAttrs[USTR("xmlns:svg")] = USTR(OASIS_STR "svg-compatible:1.0");
-    aAttrs[USTR("xmlns:table")] = USTR(OASIS_STR "table:1.0");
-    aAttrs[USTR("xmlns:draw")] = USTR(OASIS_STR "drawing:1.0");
-    aAttrs[USTR("xmlns:fo")] = USTR(OASIS_STR "xsl-fo-compatible:1.0");
-    aAttrs[USTR("xmlns:xlink")] = USTR("http://www.w3.org/1999/xlink");
-    aAttrs[USTR("xmlns:dc")] = USTR("http://purl.org/dc/elements/1.1/");
-    aAttrs[USTR("xmlns:meta")] = USTR("urn:oasis:names:tc:opendocument:xmlns:meta:1.0");
-    aAttrs[USTR("xmlns:number")] = USTR(OASIS_STR "datastyle:1.0");
-    aAttrs[USTR("xmlns:presentation")] = USTR(OASIS_STR "presentation:1.0");
-    aAttrs[USTR("xmlns:math")] = USTR("http://www.w3.org/1998/Math/MathML");
-    aAttrs[USTR("xmlns:form")] = USTR(OASIS_STR "form:1.0");
-    aAttrs[USTR("xmlns:script")] = USTR(OASIS_STR "script:1.0");
-    aAttrs[USTR("xmlns:dom")] = USTR("http://www.w3.org/2001/xml-events");
-    aAttrs[USTR("xmlns:xforms")] = USTR("http://www.w3.org/2002/xforms");
-    aAttrs[USTR("xmlns:xsd")] = USTR("http://www.w3.org/2001/XMLSchema");
-    aAttrs[USTR("xmlns:xsi")] = USTR("http://www.w3.org/2001/XMLSchema-instance");
-    aAttrs[USTR("office:version")] = USTR("1.0");
-    aAttrs[USTR("office:mimetype")] = USTR("application/vnd.oasis.opendocument.graphics");
+    aAttrs["xmlns:office"] = USTR(OASIS_STR "office:1.0");
+    aAttrs["xmlns:style"] = USTR(OASIS_STR "style:1.0");
+    aAttrs["xmlns:text"] = USTR(OASIS_STR "text:1.0");
+    aAttrs["xmlns:svg"] = USTR(OASIS_STR "svg-compatible:1.0");
+    aAttrs["xmlns:table"] = USTR(OASIS_STR "table:1.0");
+    aAttrs["xmlns:draw"] = USTR(OASIS_STR "drawing:1.0");
+    aAttrs["xmlns:fo"] = USTR(OASIS_STR "xsl-fo-compatible:1.0");
+    aAttrs["xmlns:xlink"] = USTR("http://www.w3.org/1999/xlink");
+    aAttrs["xmlns:dc"] = USTR("http://purl.org/dc/elements/1.1/");
+    aAttrs["xmlns:meta"] = USTR("urn:oasis:names:tc:opendocument:xmlns:meta:1.0");
+    aAttrs["xmlns:number"] = USTR(OASIS_STR "datastyle:1.0");
+    aAttrs["xmlns:presentation"] = USTR(OASIS_STR "presentation:1.0");
+    aAttrs["xmlns:math"] = USTR("http://www.w3.org/1998/Math/MathML");
+    aAttrs["xmlns:form"] = USTR(OASIS_STR "form:1.0");
+    aAttrs["xmlns:script"] = USTR(OASIS_STR "script:1.0");
+    aAttrs["xmlns:dom"] = USTR("http://www.w3.org/2001/xml-events");
+    aAttrs["xmlns:xforms"] = USTR("http://www.w3.org/2002/xforms");
+    aAttrs["xmlns:xsd"] = USTR("http://www.w3.org/2001/XMLSchema");
+    aAttrs["xmlns:xsi"] = USTR("http://www.w3.org/2001/XMLSchema-instance");
+    aAttrs["office:version"] = USTR("1.0");
+    aAttrs["office:mimetype"] = USTR("application/vnd.oasis.opendocument.graphics");
 
     xDocHandler->startElement(USTR("office:document"), makeXAttributeAndClear(aAttrs));
 
 //    xDocHandler->startElement(USTR("office:meta"), uno::Reference<xml::sax::XAttributeList>());
-    xDocHandler->startElement(USTR("office:meta"), new SaxAttrList(PropertyMap()));
+    xDocHandler->startElement(USTR("office:meta"), makeEmptyXAttribute());
 //    xDocHandler->startElement(USTR("dc:title"), uno::Reference<xml::sax::XAttributeList>());
-    xDocHandler->startElement(USTR("dc:title"), new SaxAttrList(PropertyMap()));
+    xDocHandler->startElement(USTR("dc:title"), makeEmptyXAttribute());
     xDocHandler->characters(rTemplate.getTitle());
     xDocHandler->endElement(USTR("dc:title"));
     xDocHandler->endElement(USTR("office:meta"));
 
     xDocHandler->startElement(USTR("office:styles"), uno::Reference<xml::sax::XAttributeList>());
-    aAttrs[USTR("style:name")] = USTR("standard");
-    aAttrs[USTR("style:family")] = USTR("graphic");
+    aAttrs["style:name"] = USTR("standard");
+    aAttrs["style:family"] = USTR("graphic");
     xDocHandler->startElement(USTR("style:style"), makeXAttributeAndClear(aAttrs));
-    aAttrs[USTR("svg:stroke-width")] = USTR("0.10cm");
-    aAttrs[USTR("draw:fill-color")] = USTR("#ffffff");
+    aAttrs["svg:stroke-width"] = USTR("0.10cm");
+    aAttrs["draw:fill-color"] = USTR("#ffffff");
     xDocHandler->startElement(USTR("style:graphic-properties"), makeXAttributeAndClear(aAttrs));
     xDocHandler->endElement(USTR("style:graphic-properties"));
     xDocHandler->endElement(USTR("style:style"));
@@ -971,34 +962,34 @@ bool DIAShapeFilter::convert(const ShapeTemplate &rTemplate, uno::Reference < xm
 
     xDocHandler->startElement(USTR("office:automatic-styles"), uno::Reference<xml::sax::XAttributeList>());
 
-    aAttrs[USTR("style:name")] = USTR("pagelayout1");
+    aAttrs["style:name"] = USTR("pagelayout1");
     xDocHandler->startElement(USTR("style:page-layout"), makeXAttributeAndClear(aAttrs));
-    aAttrs[USTR("fo:margin-top")] = USTR("0mm");
-    aAttrs[USTR("fo:margin-bottom")] = USTR("0mm");
-    aAttrs[USTR("fo:margin-left")] = USTR("0mm");
-    aAttrs[USTR("fo:margin-right")] = USTR("0mm");
-    aAttrs[USTR("fo:page-width")] = USTR("210mm");
-    aAttrs[USTR("fo:page-height")] = USTR("297mm");
+    aAttrs["fo:margin-top"] = USTR("0mm");
+    aAttrs["fo:margin-bottom"] = USTR("0mm");
+    aAttrs["fo:margin-left"] = USTR("0mm");
+    aAttrs["fo:margin-right"] = USTR("0mm");
+    aAttrs["fo:page-width"] = USTR("210mm");
+    aAttrs["fo:page-height"] = USTR("297mm");
     xDocHandler->startElement(USTR("style:page-layout-properties"), makeXAttributeAndClear(aAttrs));
     xDocHandler->endElement(USTR("style:page-layout-properties"));
     xDocHandler->endElement(USTR("style:page-layout"));
 
-    aAttrs[USTR( "style:name")] = USTR("pagestyle1");
-    aAttrs[USTR( "style:family")] = USTR("drawing-page");
+    aAttrs["style:name"] = USTR("pagestyle1");
+    aAttrs["style:family"] = USTR("drawing-page");
     xDocHandler->startElement(USTR("style:style"), makeXAttributeAndClear(aAttrs));
 //    xDocHandler->startElement(USTR("style:drawing-page-properties"), uno::Reference<xml::sax::XAttributeList>());
-    xDocHandler->startElement(USTR("style:drawing-page-properties"), new SaxAttrList(PropertyMap()));
+    xDocHandler->startElement(USTR("style:drawing-page-properties"), makeEmptyXAttribute());
     xDocHandler->endElement(USTR("style:drawing-page-properties"));
     xDocHandler->endElement(USTR("style:style"));
 
-    aAttrs[USTR("style:name")] = USTR("grtext");
-    aAttrs[USTR("style:family")] = USTR("graphic");
+    aAttrs["style:name"] = USTR("grtext");
+    aAttrs["style:family"] = USTR("graphic");
     xDocHandler->startElement(USTR("style:style"), makeXAttributeAndClear(aAttrs));
-    aAttrs[USTR("draw:stroke")] = USTR("none");
-    aAttrs[USTR("draw:fill")] = USTR("none");
-    aAttrs[USTR("draw:textarea-horizontal-align")] = USTR("center");
-    aAttrs[USTR("draw:textarea-vertical-align")] = USTR("middle");
-    aAttrs[USTR("draw:auto-grow-width")] = USTR("true");
+    aAttrs["draw:stroke"] = USTR("none");
+    aAttrs["draw:fill"] = USTR("none");
+    aAttrs["draw:textarea-horizontal-align"] = USTR("center");
+    aAttrs["draw:textarea-vertical-align"] = USTR("middle");
+    aAttrs["draw:auto-grow-width"] = USTR("true");
     xDocHandler->startElement(USTR("style:graphic-properties"), makeXAttributeAndClear(aAttrs));
     xDocHandler->endElement(USTR("style:graphic-properties"));
     xDocHandler->endElement(USTR("style:style"));
@@ -1009,9 +1000,9 @@ bool DIAShapeFilter::convert(const ShapeTemplate &rTemplate, uno::Reference < xm
     xDocHandler->endElement( USTR("office:automatic-styles") );
 
     xDocHandler->startElement( USTR("office:master-styles"), uno::Reference<xml::sax::XAttributeList>());
-    aAttrs[USTR( "style:name")] = USTR("Default");
-    aAttrs[USTR( "style:page-layout-name")] = USTR("pagelayout1");
-    aAttrs[USTR( "draw:style-name")] = USTR("pagestyle1");
+    aAttrs["style:name"] = USTR("Default");
+    aAttrs["style:page-layout-name"] = USTR("pagelayout1");
+    aAttrs["draw:style-name"] = USTR("pagestyle1");
     xDocHandler->startElement(USTR("style:master-page"), makeXAttributeAndClear(aAttrs));
     xDocHandler->endElement(USTR("style:master-page"));
     xDocHandler->endElement(USTR("office:master-styles"));
@@ -1019,18 +1010,13 @@ bool DIAShapeFilter::convert(const ShapeTemplate &rTemplate, uno::Reference < xm
     xDocHandler->startElement(USTR("office:body"), uno::Reference<xml::sax::XAttributeList>());
     xDocHandler->startElement(USTR("office:drawing"), uno::Reference<xml::sax::XAttributeList>());
 
-    aAttrs[USTR("draw:master-page-name")] = USTR("Default");
-    aAttrs[USTR("style:page-layout-name")] = USTR("pagelayout1");
-    aAttrs[USTR("draw:style-name")] = USTR("pagestyle1");
+    aAttrs["draw:master-page-name"] = USTR("Default");
+    aAttrs["style:page-layout-name"] = USTR("pagelayout1");
+    aAttrs["draw:style-name"] = USTR("pagestyle1");
     xDocHandler->startElement(USTR("draw:page"), makeXAttributeAndClear(aAttrs));
 
-    PropertyMap aDefaultAttrs;
-    aDefaultAttrs[USTR("svg:x")] = USTR("0cm");
-    aDefaultAttrs[USTR("svg:y")] = USTR("0cm");
-    aDefaultAttrs[USTR("svg:width")] = rtl::OUString::number(DEFAULTSIZE * mfAspectRatio) + USTR("cm");
-    aDefaultAttrs[USTR("svg:height")] = rtl::OUString::number(DEFAULTSIZE) + USTR("cm");
-
-    rTemplate.convertShapes(xDocHandler, aDefaultAttrs, PropertyMap(), rtl::OUString());
+    basegfx::B2DRange aFrame(0, 0, DEFAULTSIZE * mfAspectRatio, DEFAULTSIZE);
+    rTemplate.convertShapes(xDocHandler, aFrame, PropertyMap(), PropertyMap(), std::vector< rtl::OUString >(1));
 
     xDocHandler->endElement(USTR("draw:page"));
     xDocHandler->endElement(USTR("office:drawing"));
@@ -1082,8 +1068,8 @@ sal_Bool SAL_CALL DIAShapeFilter::filter( const uno::Sequence< beans::PropertyVa
         mfAspectRatio = aImporter->getAspectRatio();
         ShapeTemplate aTemplate(aImporter);
         PropertyMap aDefaultStyle;
-        aDefaultStyle[USTR("svg:stroke-width")] = USTR("0.10cm");
-        aDefaultStyle[USTR("draw:fill-color")] = USTR("#ffffff");
+        aDefaultStyle["svg:stroke-width"] = USTR("0.10cm");
+        aDefaultStyle["draw:fill-color"] = USTR("#ffffff");
         aTemplate.generateStyles(maGraphicStyles, aDefaultStyle, true);
         return convert(aTemplate, xDocHandler);
     }
@@ -1110,25 +1096,13 @@ rtl::OUString SAL_CALL DIAShapeFilter::detect( uno::Sequence< beans::PropertyVal
     if (!xInputStream.is())
         return rtl::OUString();
 
-    sal_Int64 nPos = 0;
-    uno::Reference< io::XSeekable > xSeekable( xInputStream, uno::UNO_QUERY );
-
     try
     {
-        if (xSeekable.is())
-           nPos = xSeekable->getPosition();
-
         rtl::OUString sRet;
 
-        uno::Sequence<sal_Int8> aData(64);
-        sal_Int32 nLen = xInputStream->readBytes(aData, 64);
-        rtl::OString aTmp(reinterpret_cast<const sal_Char*>(aData.getArray()), nLen);
-        if (aTmp.indexOf(rtl::OString(RTL_CONSTASCII_STRINGPARAM("<shape "))) != -1)
+        if (peekContent(xInputStream).indexOf(rtl::OString(RTL_CONSTASCII_STRINGPARAM("<shape "))) != -1)
             sRet = rtl::OUString(RTL_CONSTASCII_USTRINGPARAM("shape_DIA"));
 
-        if (xSeekable.is())
-            xSeekable->seek(nPos);
-
         return sRet;
     }
     catch (io::IOException const&)
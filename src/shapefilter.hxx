@@ -61,8 +61,15 @@ public:
     float getAspectRatio() const;
     bool import(uno::Reference < xml::dom::XElement > xDocElem);
     void writeConnectionPoints(uno::Reference < xml::sax::XDocumentHandler >& rxDocHandler) const;
-    void writeTextBox(uno::Reference < xml::sax::XDocumentHandler >& rxDocHandler, float x, float y, float hscale, float vscale, const PropertyMap &rTextProps, const rtl::OUString &rString) const;
+    void writeTextBox(uno::Reference < xml::sax::XDocumentHandler >& rxDocHandler, float x, float y, float hscale, float vscale, const PropertyMap &rTextProps, const std::vector< rtl::OUString > &rLines) const;
     const rtl::OUString & getTitle() const { return msTitle; }
+    //The title of a .shape is the text of the first <name>, of any prefix,
+    //which has no child elements and some text. Comments in it are skipped.
+    //The index in ShapeLibrary and mkshapebundle must pick the same one
+    static bool isTitleTag(const rtl::OUString &rTagName)
+    {
+        return rTagName.copy(rTagName.indexOf(':') + 1).equalsAsciiL(RTL_CONSTASCII_STRINGPARAM("name"));
+    }
     const basegfx::B2DPolyPolygon & getScene() const { return maScene; }
     const shapevec & getShapes() const { return maShapes; }
     int getConnectionDirection(sal_Int32 nConnection) const;
@@ -77,10 +84,13 @@ private:
     shapeimporter maImporter;
     std::vector< PropertyMap > maShapeOverrideProps;
 public:
+    //fStrokeWidth is the parent's stroke width in cm
     void generateStyles(GraphicStyleManager &rStyleManager, const PropertyMap &rParentProps,
-        bool bShowBackground);
-    void convertShapes(uno::Reference < xml::sax::XDocumentHandler > &rxDocHandler, 
-        const PropertyMap &rParentProps, const PropertyMap &rTextProps, const rtl::OUString &rString) const;
+        bool bShowBackground, double fStrokeWidth);
+    //rFrame is where the parent object is, in cm
+    void convertShapes(uno::Reference < xml::sax::XDocumentHandler > &rxDocHandler,
+        const basegfx::B2DRange &rFrame, const PropertyMap &rParentProps,
+        const PropertyMap &rTextProps, const std::vector< rtl::OUString > &rLines) const;
     const rtl::OUString & getTitle() const { return maImporter->getTitle(); }
     int getConnectionDirection(sal_Int32 nConnection) const { return maImporter->getConnectionDirection(nConnection); }
     bool getConnectionPoint(sal_Int32 nConnection, basegfx::B2DPoint &rPoint) const {return maImporter->getConnectionPoint(nConnection, rPoint); }
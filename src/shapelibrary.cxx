@@ -0,0 +1,491 @@
+/*************************************************************************
+ *
+ * Caolán McNamara
+ * Copyright 2010 by Red Hat, Inc. 
+ *
+ * openoffice.org-diafilter is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 3 or
+ * later, as published by the Free Software Foundation.
+ *
+ * openoffice.org-diafilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ *
+ * You should have received a copy of the GNU General Public License version 3
+ * along with openoffice.org-diafilter.  If not, see
+ * <http://www.gnu.org/copyleft/gpl.html> for a copy of the GPLv3 License.
+ *
+ ************************************************************************/
+
+#include <com/sun/star/ucb/XSimpleFileAccess.hpp>
+#include <com/sun/star/xml/dom/XDocumentBuilder.hpp>
+#include <com/sun/star/xml/sax/XParser.hpp>
+#include <com/sun/star/xml/sax/InputSource.hpp>
+#include <com/sun/star/xml/sax/SAXException.hpp>
+#include <cppuhelper/implbase1.hxx>
+
+#include <osl/file.hxx>
+#include <osl/thread.hxx>
+#include <rtl/instance.hxx>
+#include <rtl/ustrbuf.hxx>
+
+#include "filters.hxx"
+#include "shapefilter.hxx"
+#include "shapelibrary.hxx"
+#include "mem_inputstream.hxx"
+
+#include <algorithm>
+
+#include <string.h>
+#include <stdio.h>
+#ifdef UNX
+#include <unistd.h>
+#endif
+
+#define MAX_INDEX_THREADS 16
+//How often, in ms, to look again at whether the shapes have changed
+#define SHAPES_RECHECK_MS 5000
+
+namespace { struct theShapeLibrary : public rtl::Static<ShapeLibrary, theShapeLibrary> {}; }
+
+ShapeLibrary::ShapeLibrary()
+    : mnChecked(0)
+    , mnGeneration(0)
+    , mbScanned(false)
+{
+    maStamp.Seconds = 0;
+    maStamp.Nanosec = 0;
+}
+
+ShapeLibrary& ShapeLibrary::get()
+{
+    return theShapeLibrary::get();
+}
+
+namespace
+{
+    bool getModifyTime(const rtl::OUString &rURL, TimeValue &rTime)
+    {
+        osl::DirectoryItem aItem;
+        if (osl::DirectoryItem::get(rURL, aItem) != osl::FileBase::E_None)
+            return false;
+        osl::FileStatus aStatus(osl_FileStatus_Mask_ModifyTime);
+        if (aItem.getFileStatus(aStatus) != osl::FileBase::E_None)
+            return false;
+        rTime = aStatus.getModifyTime();
+        return true;
+    }
+
+    void keepNewest(TimeValue &rNewest, const TimeValue &rTime)
+    {
+        if (rTime.Seconds > rNewest.Seconds ||
+            (rTime.Seconds == rNewest.Seconds && rTime.Nanosec > rNewest.Nanosec))
+        {
+            rNewest = rTime;
+        }
+    }
+
+    sal_uInt32 readUInt32(const sal_Int8 *pData)
+    {
+        const sal_uInt8 *p = reinterpret_cast<const sal_uInt8*>(pData);
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<sal_uInt32>(p[3]) << 24);
+    }
+
+    shapeimporter parseShape(const uno::Reference< uno::XComponentContext > &rxCtx,
+        const uno::Reference< io::XInputStream > &rxInputStream)
+    {
+        uno::Reference<xml::dom::XDocumentBuilder> xDomBuilder(
+            rxCtx->getServiceManager()->createInstanceWithContext(USTR("com.sun.star.xml.dom.DocumentBuilder"),
+                rxCtx), uno::UNO_QUERY_THROW);
+        uno::Reference<xml::dom::XDocument> xDom(xDomBuilder->parse(rxInputStream), uno::UNO_QUERY_THROW);
+        uno::Reference<xml::dom::XElement> xDocElem(xDom->getDocumentElement(), uno::UNO_QUERY_THROW);
+
+        shapeimporter pImporter(new ShapeImporter());
+        if (!pImporter->import(xDocElem))
+            pImporter.reset();
+        return pImporter;
+    }
+
+    //Collects the title of a .shape file by the same rule as
+    //ShapeImporter::import and then abandons the parse, nothing else is
+    //needed until the shape is actually used
+    class ShapeTitleHandler : public cppu::WeakImplHelper1< xml::sax::XDocumentHandler >
+    {
+    private:
+        rtl::OUStringBuffer maTitle;
+        bool mbInName;
+        bool mbFound;
+    public:
+        ShapeTitleHandler() : mbInName(false), mbFound(false) {}
+        bool getTitle(rtl::OUString &rTitle)
+        {
+            if (mbFound)
+                rTitle = maTitle.makeStringAndClear();
+            return mbFound;
+        }
+
+        // XDocumentHandler
+        virtual void SAL_CALL startDocument() {}
+        virtual void SAL_CALL endDocument() {}
+        virtual void SAL_CALL startElement(const rtl::OUString &rName,
+            const uno::Reference<xml::sax::XAttributeList> &)
+        {
+            //A name with an element inside it doesn't count
+            maTitle.setLength(0);
+            mbInName = ShapeImporter::isTitleTag(rName);
+        }
+        virtual void SAL_CALL endElement(const rtl::OUString &)
+        {
+            if (mbInName && maTitle.getLength())
+            {
+                mbFound = true;
+                throw xml::sax::SAXException();
+            }
+            mbInName = false;
+        }
+        virtual void SAL_CALL characters(const rtl::OUString &rChars)
+        {
+            if (mbInName)
+                maTitle.append(rChars);
+        }
+        virtual void SAL_CALL ignorableWhitespace(const rtl::OUString &) {}
+        virtual void SAL_CALL processingInstruction(const rtl::OUString &, const rtl::OUString &) {}
+        virtual void SAL_CALL setDocumentLocator(const uno::Reference<xml::sax::XLocator> &) {}
+    };
+
+    bool readShapeTitle(const rtl::OUString &rShapeFile,
+        const uno::Reference< ucb::XSimpleFileAccess > &rxFileAccess,
+        const uno::Reference< xml::sax::XParser > &rxParser, rtl::OUString &rTitle)
+    {
+        ShapeTitleHandler *pHandler = new ShapeTitleHandler();
+        uno::Reference< xml::sax::XDocumentHandler > xHandler(pHandler);
+        try
+        {
+            xml::sax::InputSource aInputSource;
+            aInputSource.aInputStream = rxFileAccess->openFileRead(rShapeFile);
+            aInputSource.sSystemId = rShapeFile;
+            rxParser->setDocumentHandler(xHandler);
+            rxParser->parseStream(aInputSource);
+        }
+        catch ( ... )
+        {
+            //Expected, the handler stops the parse as soon as it has a title
+        }
+
+        if (pHandler->getTitle(rTitle))
+            return true;
+
+        fprintf(stderr, "Could not find name of %s\n", rtl::OUStringToOString(rShapeFile, RTL_TEXTENCODING_UTF8).getStr());
+        return false;
+    }
+
+    //The titles of a list of shape files, filled in by however many
+    //ShapeIndexThreads share the work
+    class ShapeIndexJob
+    {
+    private:
+        uno::Reference< uno::XComponentContext > mxCtx;
+        const std::vector<rtl::OUString> &mrShapeFiles;
+        std::vector<rtl::OUString> maTitles;
+        osl::Mutex maMutex;
+        size_t mnNext;
+
+        bool next(size_t &rIndex)
+        {
+            osl::MutexGuard aGuard(maMutex);
+            if (mnNext == mrShapeFiles.size())
+                return false;
+            rIndex = mnNext++;
+            return true;
+        }
+    public:
+        ShapeIndexJob(const uno::Reference< uno::XComponentContext > &rxCtx,
+            const std::vector<rtl::OUString> &rShapeFiles)
+            : mxCtx(rxCtx)
+            , mrShapeFiles(rShapeFiles)
+            , maTitles(rShapeFiles.size())
+            , mnNext(0)
+        {
+        }
+
+        void work()
+        {
+            try
+            {
+                //Neither is safe to share between threads
+                uno::Reference< ucb::XSimpleFileAccess > xFileAccess(
+                    mxCtx->getServiceManager()->createInstanceWithContext(USTR("com.sun.star.ucb.SimpleFileAccess"),
+                        mxCtx), uno::UNO_QUERY_THROW);
+                uno::Reference< xml::sax::XParser > xParser(
+                    mxCtx->getServiceManager()->createInstanceWithContext(USTR("com.sun.star.xml.sax.Parser"),
+                        mxCtx), uno::UNO_QUERY_THROW);
+
+                size_t nIndex;
+                while (next(nIndex))
+                    readShapeTitle(mrShapeFiles[nIndex], xFileAccess, xParser, maTitles[nIndex]);
+            }
+            catch ( ... )
+            {
+                fprintf(stderr, "Could not index shapes\n");
+            }
+        }
+
+        const std::vector<rtl::OUString> &getTitles() const { return maTitles; }
+    };
+
+    class ShapeIndexThread : public osl::Thread
+    {
+    private:
+        ShapeIndexJob &mrJob;
+    public:
+        explicit ShapeIndexThread(ShapeIndexJob &rJob) : mrJob(rJob) {}
+    protected:
+        virtual void SAL_CALL run() { mrJob.work(); }
+    };
+
+    size_t getIndexThreadCount(size_t nShapeFiles)
+    {
+        long nCPUs = 4;
+#ifdef UNX
+        nCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+        size_t nThreads = nCPUs > 1 ? static_cast<size_t>(nCPUs) : 1;
+        return std::min<size_t>(std::min<size_t>(nThreads, MAX_INDEX_THREADS), std::max<size_t>(nShapeFiles, 1));
+    }
+}
+
+void ShapeLibrary::update(const uno::Reference< uno::XComponentContext > &rxCtx, const rtl::OUString &rInstallDir)
+{
+    const rtl::OUString sBundle(rInstallDir + USTR("shapes.bundle"));
+    const rtl::OUString sShapesDir(rInstallDir + USTR("shapes"));
+
+    //Finding the stamp of loose shapes means walking the whole tree, so
+    //imports in quick succession just use what's there
+    const sal_uInt32 nNow = osl_getGlobalTimer();
+    {
+        osl::MutexGuard aGuard(maMutex);
+        if (mbScanned && msInstallDir == rInstallDir && nNow - mnChecked < SHAPES_RECHECK_MS)
+            return;
+    }
+
+    TimeValue aStamp;
+    aStamp.Seconds = 0;
+    aStamp.Nanosec = 0;
+
+    //Without a bundle the shapes are nested in a dir per sheet, and changing
+    //one of them doesn't touch the top level dir, so the stamp is the newest
+    //of every dir and file under it
+    std::vector<rtl::OUString> aShapeFiles;
+    bool bBundle = getModifyTime(sBundle, aStamp);
+    if (!bBundle && getModifyTime(sShapesDir, aStamp))
+        recursiveScan(sShapesDir, aShapeFiles, aStamp);
+
+    osl::MutexGuard aGuard(maMutex);
+
+    mnChecked = nNow;
+    if (mbScanned && msInstallDir == rInstallDir &&
+        maStamp.Seconds == aStamp.Seconds && maStamp.Nanosec == aStamp.Nanosec)
+    {
+        return;
+    }
+
+    //Importers already handed out stay valid, they're just no longer shared
+    ++mnGeneration;
+    maTemplates.clear();
+    maBundleIndex.clear();
+    maFileIndex.clear();
+    mpBundle.reset();
+    msInstallDir = rInstallDir;
+    maStamp = aStamp;
+    mbScanned = true;
+
+    if (bBundle)
+    {
+        if (loadBundle(sBundle))
+            return;
+        TimeValue aIgnored = aStamp;
+        recursiveScan(sShapesDir, aShapeFiles, aIgnored);
+    }
+
+    indexShapes(rxCtx, aShapeFiles);
+}
+
+//See src/tools/mkshapebundle.cxx for the layout
+bool ShapeLibrary::loadBundle(const rtl::OUString &rBundle)
+{
+    boost::shared_ptr<MappedFile> pBundle(new MappedFile(rBundle));
+    if (!pBundle->is())
+        return false;
+
+    const sal_Int8 *pData = pBundle->getData();
+    const sal_uInt64 nSize = pBundle->getSize();
+
+    if (nSize < 12 || memcmp(pData, "DIASHP01", 8) != 0)
+    {
+        fprintf(stderr, "%s is not a shape bundle\n", rtl::OUStringToOString(rBundle, RTL_TEXTENCODING_UTF8).getStr());
+        return false;
+    }
+
+    bundleindex aIndex;
+    sal_uInt64 nPos = 8;
+    sal_uInt32 nCount = readUInt32(pData + nPos);
+    nPos += 4;
+    for (sal_uInt32 i = 0; i < nCount; ++i)
+    {
+        if (nPos + 12 > nSize)
+            break;
+        sal_uInt32 nOffset = readUInt32(pData + nPos);
+        sal_uInt32 nLength = readUInt32(pData + nPos + 4);
+        sal_uInt32 nTitleLength = readUInt32(pData + nPos + 8);
+        nPos += 12;
+        if (nPos + nTitleLength > nSize || static_cast<sal_uInt64>(nOffset) + nLength > nSize)
+            break;
+        rtl::OUString sTitle(reinterpret_cast<const sal_Char*>(pData + nPos), nTitleLength, RTL_TEXTENCODING_UTF8);
+        nPos += nTitleLength;
+        aIndex[sTitle] = bundleentry(nOffset, nLength);
+    }
+
+    if (aIndex.size() == 0 && nCount)
+    {
+        fprintf(stderr, "%s is damaged\n", rtl::OUStringToOString(rBundle, RTL_TEXTENCODING_UTF8).getStr());
+        return false;
+    }
+
+    mpBundle = pBundle;
+    maBundleIndex.swap(aIndex);
+    return true;
+}
+
+shapeimporter ShapeLibrary::findImporter(const uno::Reference< uno::XComponentContext > &rxCtx, const rtl::OUString &rTitle)
+{
+    rtl::OUString sShapeFile;
+    boost::shared_ptr<MappedFile> pBundle;
+    bundleentry aEntry;
+    sal_uInt32 nGeneration;
+    {
+        osl::MutexGuard aGuard(maMutex);
+
+        templates::const_iterator aI = maTemplates.find(rTitle);
+        if (aI != maTemplates.end())
+            return aI->second;
+
+        //Parse shapes from the shape dir on first use, or from the bundle
+        fileindex::const_iterator aFile = maFileIndex.find(rTitle);
+        bundleindex::const_iterator aBundleEntry = maBundleIndex.find(rTitle);
+        if (aFile != maFileIndex.end())
+            sShapeFile = aFile->second;
+        else if (aBundleEntry != maBundleIndex.end())
+        {
+            pBundle = mpBundle;
+            aEntry = aBundleEntry->second;
+        }
+        else
+            return shapeimporter();
+        nGeneration = mnGeneration;
+    }
+
+    //Without the lock, so other imports can carry on using what's cached
+    shapeimporter pImporter;
+    if (sShapeFile.getLength())
+        pImporter = importShape(rxCtx, sShapeFile);
+    else
+    {
+        try
+        {
+            uno::Reference< io::XInputStream > xInputStream(new mem_InputStream(
+                pBundle->getData() + aEntry.first, aEntry.second, pBundle));
+            pImporter = parseShape(rxCtx, xInputStream);
+        }
+        catch ( ... )
+        {
+        }
+
+        if (!pImporter.get())
+            fprintf(stderr, "Could not parse %s from shape bundle\n", rtl::OUStringToOString(rTitle, RTL_TEXTENCODING_UTF8).getStr());
+    }
+
+    osl::MutexGuard aGuard(maMutex);
+
+    //Another import may have parsed it meanwhile, and if the shapes were
+    //reloaded this one isn't to be shared
+    if (nGeneration != mnGeneration)
+        return pImporter;
+    templates::const_iterator aI = maTemplates.find(rTitle);
+    if (aI != maTemplates.end())
+        return aI->second;
+
+    maFileIndex.erase(rTitle);
+    maBundleIndex.erase(rTitle);
+    maTemplates[rTitle] = pImporter;
+    return pImporter;
+}
+
+void ShapeLibrary::recursiveScan(const rtl::OUString &rDir, std::vector<rtl::OUString> &rShapeFiles, TimeValue &rNewest)
+{
+    osl::Directory aShapeDir(rDir);
+    if (aShapeDir.open() != osl::FileBase::E_None)
+        return;
+    osl::DirectoryItem aItem;
+    while (aShapeDir.getNextItem(aItem) == osl::FileBase::E_None)
+    {
+        osl::FileStatus aStatus(osl_FileStatus_Mask_Type | osl_FileStatus_Mask_FileURL | osl_FileStatus_Mask_ModifyTime);
+        if (aItem.getFileStatus(aStatus) != osl::FileBase::E_None)
+            continue;
+        keepNewest(rNewest, aStatus.getModifyTime());
+        if (aStatus.getFileType() == osl::FileStatus::Directory)
+            recursiveScan(aStatus.getFileURL(), rShapeFiles, rNewest);
+        else
+            rShapeFiles.push_back(aStatus.getFileURL());
+    }
+}
+
+//Read the titles on a pool of threads, but merge them in the order the files
+//were found so that the last of any duplicate titles still wins
+void ShapeLibrary::indexShapes(const uno::Reference< uno::XComponentContext > &rxCtx, const std::vector<rtl::OUString> &rShapeFiles)
+{
+    ShapeIndexJob aJob(rxCtx, rShapeFiles);
+
+    std::vector< boost::shared_ptr<ShapeIndexThread> > aThreads;
+    for (size_t i = 1; i < getIndexThreadCount(rShapeFiles.size()); ++i)
+    {
+        boost::shared_ptr<ShapeIndexThread> pThread(new ShapeIndexThread(aJob));
+        if (!pThread->create())
+            break;
+        aThreads.push_back(pThread);
+    }
+
+    aJob.work();
+
+    for (size_t i = 0; i < aThreads.size(); ++i)
+        aThreads[i]->join();
+
+    const std::vector<rtl::OUString> &rTitles = aJob.getTitles();
+    for (size_t i = 0; i < rTitles.size(); ++i)
+    {
+        if (rTitles[i].getLength())
+            maFileIndex[rTitles[i]] = rShapeFiles[i];
+    }
+}
+
+shapeimporter ShapeLibrary::importShape(const uno::Reference< uno::XComponentContext > &rxCtx, const rtl::OUString &rShapeFile)
+{
+    shapeimporter pImporter;
+    try
+    {
+        uno::Reference< ucb::XSimpleFileAccess > xSimpleFileAccess(
+            rxCtx->getServiceManager()->createInstanceWithContext(USTR("com.sun.star.ucb.SimpleFileAccess"),
+                rxCtx), uno::UNO_QUERY_THROW);
+        uno::Reference< io::XInputStream > xInputStream(xSimpleFileAccess->openFileRead(rShapeFile));
+
+        pImporter = parseShape(rxCtx, xInputStream);
+    }
+    catch ( ... )
+    {
+    }
+
+    if (!pImporter.get())
+        fprintf(stderr, "Could not parse %s\n", rtl::OUStringToOString(rShapeFile, RTL_TEXTENCODING_UTF8).getStr());
+    return pImporter;
+}
+
+/* vi:set tabstop=4 shiftwidth=4 expandtab: */
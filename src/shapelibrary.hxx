@@ -0,0 +1,75 @@
+/*************************************************************************
+ *
+ * Caolán McNamara
+ * Copyright 2010 by Red Hat, Inc. 
+ *
+ * openoffice.org-diafilter is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 3 or
+ * later, as published by the Free Software Foundation.
+ *
+ * openoffice.org-diafilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ *
+ * You should have received a copy of the GNU General Public License version 3
+ * along with openoffice.org-diafilter.  If not, see
+ * <http://www.gnu.org/copyleft/gpl.html> for a copy of the GPLv3 License.
+ *
+ ************************************************************************/
+
+#ifndef SHAPELIBRARY_HXX
+#define SHAPELIBRARY_HXX
+
+#include <osl/mutex.hxx>
+#include <osl/time.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <vector>
+
+class MappedFile;
+
+//The shapes shipped with the extension, parsed once and shared by every
+//import in the process. Preferably read from the shapes.bundle generated at
+//build time, which is mapped, otherwise indexed by reading just the title of
+//each .shape file under the shapes dir. Either way a shape is only fully
+//parsed the first time it's used. Expects filters.hxx and shapefilter.hxx to
+//have been included first
+class ShapeLibrary
+{
+private:
+    typedef boost::unordered_map<rtl::OUString, shapeimporter, rtl::OUStringHash> templates;
+    typedef std::pair<sal_uInt32, sal_uInt32> bundleentry;
+    typedef boost::unordered_map<rtl::OUString, bundleentry, rtl::OUStringHash> bundleindex;
+    typedef boost::unordered_map<rtl::OUString, rtl::OUString, rtl::OUStringHash> fileindex;
+
+    osl::Mutex maMutex;
+    rtl::OUString msInstallDir;
+    TimeValue maStamp;
+    //When the stamp was last looked at, from osl_getGlobalTimer
+    sal_uInt32 mnChecked;
+    //Bumped whenever the shapes are reloaded
+    sal_uInt32 mnGeneration;
+    bool mbScanned;
+    boost::shared_ptr<MappedFile> mpBundle;
+    bundleindex maBundleIndex;
+    fileindex maFileIndex;
+    templates maTemplates;
+
+    bool loadBundle(const rtl::OUString &rBundle);
+    //Also raises rNewest to the modification time of anything found
+    static void recursiveScan(const rtl::OUString &rDir, std::vector<rtl::OUString> &rShapeFiles, TimeValue &rNewest);
+    void indexShapes(const uno::Reference< uno::XComponentContext > &rxCtx, const std::vector<rtl::OUString> &rShapeFiles);
+    shapeimporter importShape(const uno::Reference< uno::XComponentContext > &rxCtx, const rtl::OUString &rShapeFile);
+public:
+    ShapeLibrary();
+    static ShapeLibrary& get();
+
+    //(Re)load the shapes of rInstallDir if it isn't what was loaded last time
+    //or if the bundle, or any file or dir under the shapes dir, has been
+    //modified since. Changes are looked for at most every few seconds
+    void update(const uno::Reference< uno::XComponentContext > &rxCtx, const rtl::OUString &rInstallDir);
+    shapeimporter findImporter(const uno::Reference< uno::XComponentContext > &rxCtx, const rtl::OUString &rTitle);
+};
+
+#endif
+/* vi:set tabstop=4 shiftwidth=4 expandtab: */
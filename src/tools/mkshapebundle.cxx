@@ -0,0 +1,246 @@
+/*************************************************************************
+ *
+ * Caolán McNamara
+ * Copyright 2010 by Red Hat, Inc. 
+ *
+ * openoffice.org-diafilter is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 3 or
+ * later, as published by the Free Software Foundation.
+ *
+ * openoffice.org-diafilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ *
+ * You should have received a copy of the GNU General Public License version 3
+ * along with openoffice.org-diafilter.  If not, see
+ * <http://www.gnu.org/copyleft/gpl.html> for a copy of the GPLv3 License.
+ *
+ ************************************************************************/
+
+//Build time helper, packs dia .shape files into the single shapes.bundle
+//that ShapeLibrary maps at runtime, i.e.
+//
+//  "DIASHP01"
+//  count                                   (32bit little endian)
+//  count * { offset, length, titlelength,  (32bit little endian)
+//            title }                       (utf-8, entities decoded)
+//  the .shape files themselves, unchanged
+//
+//so a shape can be found by title without touching the others. Deliberately
+//doesn't need anything from the office sdk
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+    struct ShapeEntry
+    {
+        std::string maTitle;
+        std::string maData;
+    };
+
+    void appendUTF8(std::string &rOut, unsigned long nChar)
+    {
+        if (nChar < 0x80)
+            rOut += static_cast<char>(nChar);
+        else if (nChar < 0x800)
+        {
+            rOut += static_cast<char>(0xC0 | (nChar >> 6));
+            rOut += static_cast<char>(0x80 | (nChar & 0x3F));
+        }
+        else if (nChar < 0x10000)
+        {
+            rOut += static_cast<char>(0xE0 | (nChar >> 12));
+            rOut += static_cast<char>(0x80 | ((nChar >> 6) & 0x3F));
+            rOut += static_cast<char>(0x80 | (nChar & 0x3F));
+        }
+        else
+        {
+            rOut += static_cast<char>(0xF0 | (nChar >> 18));
+            rOut += static_cast<char>(0x80 | ((nChar >> 12) & 0x3F));
+            rOut += static_cast<char>(0x80 | ((nChar >> 6) & 0x3F));
+            rOut += static_cast<char>(0x80 | (nChar & 0x3F));
+        }
+    }
+
+    std::string decodeEntities(const std::string &rText)
+    {
+        std::string sRet;
+        std::string::size_type nPos = 0;
+        while (nPos < rText.size())
+        {
+            std::string::size_type nEnd;
+            if (rText[nPos] != '&' || (nEnd = rText.find(';', nPos)) == std::string::npos)
+            {
+                sRet += rText[nPos++];
+                continue;
+            }
+
+            std::string sEntity(rText, nPos + 1, nEnd - nPos - 1);
+            if (sEntity == "amp")
+                sRet += '&';
+            else if (sEntity == "lt")
+                sRet += '<';
+            else if (sEntity == "gt")
+                sRet += '>';
+            else if (sEntity == "quot")
+                sRet += '"';
+            else if (sEntity == "apos")
+                sRet += '\'';
+            else if (sEntity.size() > 2 && sEntity[0] == '#' && sEntity[1] == 'x')
+                appendUTF8(sRet, strtoul(sEntity.c_str() + 2, NULL, 16));
+            else if (sEntity.size() > 1 && sEntity[0] == '#')
+                appendUTF8(sRet, strtoul(sEntity.c_str() + 1, NULL, 10));
+            else
+                sRet.append(rText, nPos, nEnd - nPos + 1);
+            nPos = nEnd + 1;
+        }
+        return sRet;
+    }
+
+    //Same rule as ShapeImporter::isTitleTag and ShapeImporter::import, the
+    //first <name>, of any prefix, with no child elements and some text, where
+    //comments are skipped
+    bool findTitle(const std::string &rData, std::string &rTitle)
+    {
+        std::string::size_type nPos = 0;
+        while ((nPos = rData.find('<', nPos)) != std::string::npos)
+        {
+            ++nPos;
+            std::string::size_type nNameEnd = rData.find_first_of(" \t\r\n/>", nPos);
+            if (nNameEnd == std::string::npos)
+                break;
+            std::string sTag(rData, nPos, nNameEnd - nPos);
+            std::string::size_type nColon = sTag.find(':');
+            if (sTag.empty() || sTag[0] == '/' || sTag[0] == '!' || sTag[0] == '?' ||
+                sTag.compare(nColon == std::string::npos ? 0 : nColon + 1, std::string::npos, "name") != 0)
+            {
+                continue;
+            }
+
+            std::string::size_type nStart = rData.find('>', nNameEnd);
+            if (nStart == std::string::npos)
+                break;
+            if (rData[nStart - 1] == '/')
+                continue;
+            ++nStart;
+
+            const std::string sClose("</" + sTag);
+            std::string sTitle;
+            bool bJustText = false;
+            while (true)
+            {
+                std::string::size_type nEnd = rData.find('<', nStart);
+                if (nEnd == std::string::npos)
+                    return false;
+                sTitle += decodeEntities(std::string(rData, nStart, nEnd - nStart));
+                if (rData.compare(nEnd, 4, "<!--") == 0)
+                {
+                    nStart = rData.find("-->", nEnd + 4);
+                    if (nStart == std::string::npos)
+                        return false;
+                    nStart += 3;
+                }
+                else if (rData.compare(nEnd, 9, "<![CDATA[") == 0)
+                {
+                    nStart = rData.find("]]>", nEnd + 9);
+                    if (nStart == std::string::npos)
+                        return false;
+                    sTitle.append(rData, nEnd + 9, nStart - nEnd - 9);
+                    nStart += 3;
+                }
+                else
+                {
+                    //Anything else is either the end of this name or a child
+                    bJustText = rData.compare(nEnd, sClose.size(), sClose) == 0;
+                    break;
+                }
+            }
+
+            if (bJustText && !sTitle.empty())
+            {
+                rTitle = sTitle;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void appendUInt32(std::string &rOut, size_t nValue)
+    {
+        rOut += static_cast<char>(nValue & 0xFF);
+        rOut += static_cast<char>((nValue >> 8) & 0xFF);
+        rOut += static_cast<char>((nValue >> 16) & 0xFF);
+        rOut += static_cast<char>((nValue >> 24) & 0xFF);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s output.bundle [file.shape...]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<ShapeEntry> aEntries;
+    for (int i = 2; i < argc; ++i)
+    {
+        std::ifstream aIn(argv[i], std::ios::in | std::ios::binary);
+        if (!aIn)
+        {
+            fprintf(stderr, "Could not open %s\n", argv[i]);
+            return 1;
+        }
+        std::ostringstream aContents;
+        aContents << aIn.rdbuf();
+
+        ShapeEntry aEntry;
+        aEntry.maData = aContents.str();
+        if (!findTitle(aEntry.maData, aEntry.maTitle))
+        {
+            fprintf(stderr, "warning: no name in %s, skipping\n", argv[i]);
+            continue;
+        }
+        aEntries.push_back(aEntry);
+    }
+
+    std::string sIndex("DIASHP01");
+    appendUInt32(sIndex, aEntries.size());
+
+    size_t nOffset = sIndex.size();
+    for (std::vector<ShapeEntry>::const_iterator aI = aEntries.begin(); aI != aEntries.end(); ++aI)
+        nOffset += 12 + aI->maTitle.size();
+
+    for (std::vector<ShapeEntry>::const_iterator aI = aEntries.begin(); aI != aEntries.end(); ++aI)
+    {
+        appendUInt32(sIndex, nOffset);
+        appendUInt32(sIndex, aI->maData.size());
+        appendUInt32(sIndex, aI->maTitle.size());
+        sIndex += aI->maTitle;
+        nOffset += aI->maData.size();
+    }
+
+    std::ofstream aOut(argv[1], std::ios::out | std::ios::binary | std::ios::trunc);
+    aOut << sIndex;
+    for (std::vector<ShapeEntry>::const_iterator aI = aEntries.begin(); aI != aEntries.end(); ++aI)
+        aOut << aI->maData;
+    aOut.close();
+    if (!aOut)
+    {
+        fprintf(stderr, "Could not write %s\n", argv[1]);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* vi:set tabstop=4 shiftwidth=4 expandtab: */
@@ -0,0 +1,218 @@
+/*************************************************************************
+ *
+ * Caolán McNamara
+ * Copyright 2010 by Red Hat, Inc. 
+ *
+ * openoffice.org-diafilter is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 3 or
+ * later, as published by the Free Software Foundation.
+ *
+ * openoffice.org-diafilter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ *
+ * You should have received a copy of the GNU General Public License version 3
+ * along with openoffice.org-diafilter.  If not, see
+ * <http://www.gnu.org/copyleft/gpl.html> for a copy of the GPLv3 License.
+ *
+ ************************************************************************/
+
+//Developer tool, times basegfx::tools::importFromSvgD and importFromSvgPoints,
+//which is where the number parsing of the .shape files goes, i.e.
+//
+//  make svgbench
+//  build/tools/svgbench [iterations] [file.shape...]
+//
+//Without any .shape files it runs over some built in path data in the style
+//of the dia shapes, plus a long generated point list and path, otherwise over
+//every d="..." and points="..." found in the given files. Not part of the
+//extension
+
+#include <basegfx/polygon/b2dpolygon.hxx>
+#include <basegfx/polygon/b2dpolypolygon.hxx>
+#include <basegfx/polygon/b2dpolypolygontools.hxx>
+#include <rtl/ustring.hxx>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+namespace
+{
+    struct Sample
+    {
+        const char *mpName;
+        bool mbPath;
+        std::vector< rtl::OUString > maData;
+        Sample(const char *pName, bool bPath) : mpName(pName), mbPath(bPath) {}
+    };
+
+    rtl::OUString fromUTF8(const std::string &rStr)
+    {
+        return rtl::OUString(rStr.data(), rStr.size(), RTL_TEXTENCODING_UTF8);
+    }
+
+    //The values of every rAttr="..." in rData
+    void findAttributes(const std::string &rData, const char *pAttr, std::vector< rtl::OUString > &rValues)
+    {
+        const std::string sAttr(std::string(" ") + pAttr + "=\"");
+        std::string::size_type nPos = 0;
+        while ((nPos = rData.find(sAttr, nPos)) != std::string::npos)
+        {
+            nPos += sAttr.size();
+            std::string::size_type nEnd = rData.find('"', nPos);
+            if (nEnd == std::string::npos)
+                break;
+            rValues.push_back(fromUTF8(std::string(rData, nPos, nEnd - nPos)));
+            nPos = nEnd + 1;
+        }
+    }
+
+    void addBuiltinSamples(std::vector< Sample > &rSamples)
+    {
+        Sample aLines("lines", true);
+        aLines.maData.push_back(rtl::OUString::createFromAscii("M 0,0 L 4,0 L 4,3 L 0,3 z"));
+        aLines.maData.push_back(rtl::OUString::createFromAscii("M 1.5 0.25 L 3.75 0.25 L 3.75 2.125 L 1.5 2.125 Z"));
+        aLines.maData.push_back(rtl::OUString::createFromAscii("m 0.5,0.5 h 3 v 2.25 h -3 z m 0.75,0.75 h 1.5"));
+        rSamples.push_back(aLines);
+
+        Sample aCurves("curves", true);
+        aCurves.maData.push_back(rtl::OUString::createFromAscii(
+            "M 1.5,0.25 C 2.75,0.25 3.5,1.125 3.5,2 S 2.75,3.75 1.5,3.75 S -0.5,2.875 -0.5,2 S 0.25,0.25 1.5,0.25 z"));
+        aCurves.maData.push_back(rtl::OUString::createFromAscii(
+            "M 10.0266,4.0113 Q 12.5132,1.5 15.0,4.0113 T 19.9734,4.0113 L 19.9734,8.0226"));
+        rSamples.push_back(aCurves);
+
+        Sample aArcs("arcs and exponents", true);
+        aArcs.maData.push_back(rtl::OUString::createFromAscii(
+            "m 0.5e1,-2.5E-1 a 1.25,1.25 0 0 1 2.5,0 l -1.2e-2,3 q 1,1 2,0 t 2,0 h 3 v -1.5 z"));
+        aArcs.maData.push_back(rtl::OUString::createFromAscii(
+            "M 3,1 A 2,1 0 1 0 3,3 A 2,1 0 0 0 3,1 M -1.0e-1,+2.0 a 0.5 0.5 0 1 1 1 0"));
+        rSamples.push_back(aArcs);
+
+        Sample aPoints("points", false);
+        aPoints.maData.push_back(rtl::OUString::createFromAscii("0,0 1.5,0.5 3.25,2 4,3.875 2.5,4.5 0.125,3"));
+        aPoints.maData.push_back(rtl::OUString::createFromAscii("1 1 2 1 2 2 1 2"));
+        rSamples.push_back(aPoints);
+
+        //Big enough that the per call overhead doesn't count
+        std::ostringstream aLongPoints, aLongPath;
+        aLongPath << "M 0,0";
+        srand(1);
+        for (int i = 0; i < 10000; ++i)
+        {
+            double x = (rand() % 100000) / 1000.0;
+            double y = (rand() % 100000) / 1000.0;
+            aLongPoints << x << ',' << y << ' ';
+            aLongPath << (i % 2 ? " L " : " l ") << x << ',' << -y;
+        }
+
+        Sample aGeneratedPoints("10000 points", false);
+        aGeneratedPoints.maData.push_back(fromUTF8(aLongPoints.str()));
+        rSamples.push_back(aGeneratedPoints);
+
+        Sample aGeneratedPath("10000 segment path", true);
+        aGeneratedPath.maData.push_back(fromUTF8(aLongPath.str()));
+        rSamples.push_back(aGeneratedPath);
+    }
+
+    bool addFileSamples(int argc, char **argv, int nFirst, std::vector< Sample > &rSamples)
+    {
+        Sample aPaths("shape paths", true);
+        Sample aPoints("shape points", false);
+        for (int i = nFirst; i < argc; ++i)
+        {
+            std::ifstream aIn(argv[i], std::ios::in | std::ios::binary);
+            if (!aIn)
+            {
+                fprintf(stderr, "Could not open %s\n", argv[i]);
+                return false;
+            }
+            std::ostringstream aData;
+            aData << aIn.rdbuf();
+            findAttributes(aData.str(), "d", aPaths.maData);
+            findAttributes(aData.str(), "points", aPoints.maData);
+        }
+        rSamples.push_back(aPaths);
+        rSamples.push_back(aPoints);
+        return true;
+    }
+
+    //Returns false if anything fails to import, so a broken parser can't
+    //look fast
+    bool importAll(const Sample &rSample)
+    {
+        std::vector< rtl::OUString >::const_iterator aEnd = rSample.maData.end();
+        for (std::vector< rtl::OUString >::const_iterator aI = rSample.maData.begin(); aI != aEnd; ++aI)
+        {
+            if (rSample.mbPath)
+            {
+                basegfx::B2DPolyPolygon aPolyPoly;
+                if (!basegfx::tools::importFromSvgD(aPolyPoly, *aI))
+                    return false;
+            }
+            else
+            {
+                basegfx::B2DPolygon aPoly;
+                if (!basegfx::tools::importFromSvgPoints(aPoly, *aI))
+                    return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int nIterations = 1000;
+    int nFirst = 1;
+    if (argc > 1 && atoi(argv[1]) > 0)
+    {
+        nIterations = atoi(argv[1]);
+        nFirst = 2;
+    }
+
+    std::vector< Sample > aSamples;
+    if (nFirst < argc)
+    {
+        if (!addFileSamples(argc, argv, nFirst, aSamples))
+            return 1;
+    }
+    else
+        addBuiltinSamples(aSamples);
+
+    int nRet = 0;
+    std::vector< Sample >::const_iterator aEnd = aSamples.end();
+    for (std::vector< Sample >::const_iterator aI = aSamples.begin(); aI != aEnd; ++aI)
+    {
+        size_t nChars = 0;
+        for (size_t i = 0; i < aI->maData.size(); ++i)
+            nChars += aI->maData[i].getLength();
+
+        if (!importAll(*aI))
+        {
+            fprintf(stderr, "%s: import failed\n", aI->mpName);
+            nRet = 1;
+            continue;
+        }
+
+        clock_t nStart = clock();
+        for (int i = 0; i < nIterations; ++i)
+            importAll(*aI);
+        double fSeconds = static_cast<double>(clock() - nStart) / CLOCKS_PER_SEC;
+
+        printf("%-20s %6u strings %9u chars %10.3f ms %8.2f MB/s\n", aI->mpName,
+            static_cast<unsigned>(aI->maData.size()), static_cast<unsigned>(nChars),
+            fSeconds * 1000.0,
+            fSeconds > 0 ? nChars * static_cast<double>(nIterations) / fSeconds / (1024 * 1024) : 0.0);
+    }
+
+    return nRet;
+}
+
+/* vi:set tabstop=4 shiftwidth=4 expandtab: */